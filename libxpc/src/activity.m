@@ -114,7 +114,7 @@ static const struct xpc_string_s _xpc_activity_check_in = {
 	.base = {
 		XPC_GLOBAL_OBJECT_HEADER(string),
 	},
-	.byteLength = NSUIntegerMax,
+	.byteLength = sizeof("<CHECK-IN>") - 1,
 	.string = "<CHECK-IN>",
 	.freeWhenDone = false,
 };
@@ -25,6 +25,10 @@
 #import <xpc/objects/dictionary.h>
 #import <xpc/serialization.h>
 #import <xpc/objects/null.h>
+#import <xpc/objects/bool.h>
+#import <xpc/objects/int64.h>
+#import <xpc/objects/uint64.h>
+#import <xpc/objects/double.h>
 
 XPC_CLASS_SYMBOL_DECL(array);
 
@@ -35,6 +39,479 @@ XPC_CLASS_SYMBOL_DECL(array);
 // 3. xpc_arrays can never shrink or have items deleted
 // 4. slightly less memory per object
 
+// copies share the original's buffer (and the objects in it), so copying is constant time no matter how large the array is.
+// whoever modifies a shared buffer first gets its own copy of it (see `array_unshare`).
+//
+// that includes mutable objects (see `xpc_object_is_mutable`), but whoever those are handed out to mustn't be able to modify them for both of us.
+// so once we've been copied (or are a copy), we hand out our own copy of each of them instead, made the first time it's asked for (see `array_borrow`).
+// those are copy-on-write as well, so making one only copies a single level. once we're modified, they replace the shared objects for good.
+// note that this means that mutable objects that were handed out before we were copied aren't part of us anymore afterwards.
+
+static void array_release_storage(XPC_CLASS(object)** array, NSUInteger size, NSUInteger capacity) {
+	if (!xpc_shared_release(array)) {
+		// other copies are still using it
+		return;
+	}
+	for (NSUInteger i = 0; i < size; ++i) {
+		xpc_release_for_collection(array[i]);
+	}
+	xpc_shared_free(array, capacity * sizeof(XPC_CLASS(object)*));
+};
+
+// packed arrays store their values unboxed (see `xpc_array_packed_type_t`), so that e.g. an array of a million integers
+// doesn't need a million objects. objects are only created for values someone actually asks for (see `array_packed_object_at`).
+// whoever we hand them out to can modify them (e.g. with `xpc_double_set_value`), so once an object exists, its value is the one that counts.
+
+static void array_release_packed_storage(xpc_array_packed_value_t* packed, NSUInteger capacity) {
+	if (xpc_shared_release(packed)) {
+		xpc_shared_free(packed, capacity * sizeof(xpc_array_packed_value_t));
+	}
+};
+
+// releases our packed values along with any objects that were created for them
+static void array_release_packed(struct xpc_array_s* this) {
+	if (this->array != NULL) {
+		for (NSUInteger i = 0; i < this->size; ++i) {
+			[this->array[i] release];
+		}
+		free(this->array);
+	}
+	array_release_packed_storage(this->packed, this->capacity);
+};
+
+// makes the given number of (uninitialized) packed values our content. the array must be empty.
+static bool array_make_packed(struct xpc_array_s* this, xpc_array_packed_type_t type, NSUInteger count) {
+	if (count > NSUIntegerMax / sizeof(xpc_array_packed_value_t)) {
+		return false;
+	}
+	this->packed = xpc_shared_alloc(count * sizeof(xpc_array_packed_value_t));
+	if (this->packed == NULL) {
+		return false;
+	}
+	this->packed_type = type;
+	this->capacity = count;
+	this->size = count;
+	return true;
+};
+
+static xpc_array_packed_type_t array_packed_type_of(XPC_CLASS(object)* object) {
+	Class class = object_getClass(object);
+	if (class == [XPC_CLASS(bool) class]) {
+		return XPC_ARRAY_PACKED_BOOL;
+	} else if (class == [XPC_CLASS(int64) class]) {
+		return XPC_ARRAY_PACKED_INT64;
+	} else if (class == [XPC_CLASS(uint64) class]) {
+		return XPC_ARRAY_PACKED_UINT64;
+	} else if (class == [XPC_CLASS(double) class]) {
+		return XPC_ARRAY_PACKED_DOUBLE;
+	}
+	return XPC_ARRAY_PACKED_NONE;
+};
+
+// the given object must be of the given type
+static xpc_array_packed_value_t array_packed_value_of(xpc_array_packed_type_t type, XPC_CLASS(object)* object) {
+	xpc_array_packed_value_t value = { .uint64 = 0 };
+	switch (type) {
+		case XPC_ARRAY_PACKED_BOOL:
+			value.uint64 = XPC_CAST(bool, object).value ? 1 : 0;
+			break;
+		case XPC_ARRAY_PACKED_INT64:
+			value.int64 = XPC_CAST(int64, object).value;
+			break;
+		case XPC_ARRAY_PACKED_UINT64:
+			value.uint64 = XPC_CAST(uint64, object).value;
+			break;
+		case XPC_ARRAY_PACKED_DOUBLE:
+			value.double_value = XPC_CAST(double, object).value;
+			break;
+		default:
+			break;
+	}
+	return value;
+};
+
+// returns a new (retained) object for the given value
+static XPC_CLASS(object)* array_packed_box(xpc_array_packed_type_t type, xpc_array_packed_value_t value) {
+	switch (type) {
+		case XPC_ARRAY_PACKED_BOOL:
+			return XPC_CAST(object, xpc_bool_create(value.uint64 != 0));
+		case XPC_ARRAY_PACKED_INT64:
+			return XPC_CAST(object, xpc_int64_create(value.int64));
+		case XPC_ARRAY_PACKED_UINT64:
+			return XPC_CAST(object, xpc_uint64_create(value.uint64));
+		case XPC_ARRAY_PACKED_DOUBLE:
+			return XPC_CAST(object, xpc_double_create(value.double_value));
+		default:
+			return nil;
+	}
+};
+
+// must produce the same hash as the object for the value would
+static NSUInteger array_packed_hash(xpc_array_packed_type_t type, xpc_array_packed_value_t value) {
+	if (type == XPC_ARRAY_PACKED_BOOL) {
+		return [[XPC_CLASS(bool) boolForValue: value.uint64 != 0] hash];
+	}
+	// the other wrapper classes hash their 64-bit value, which is exactly what we store
+	return xpc_raw_data_hash(&value, sizeof(value));
+};
+
+// returns the object cache of a packed array, or `NULL` if no objects have been created yet.
+// the cache (and its slots) are filled in by `array_packed_object_at`, which other readers may be running at the same time.
+XPC_INLINE
+XPC_CLASS(object)** array_packed_cache(struct xpc_array_s* this) {
+	return atomic_load_explicit((_Atomic(XPC_CLASS(object)**)*)&this->array, memory_order_acquire);
+};
+
+// returns the object for the value at the given index, creating it if this is the first time someone asked for it.
+// the array keeps the object alive.
+static XPC_CLASS(object)* array_packed_object_at(struct xpc_array_s* this, NSUInteger index) {
+	XPC_CLASS(object)** cache = NULL;
+	XPC_CLASS(object)* result = nil;
+
+	// readers can be on different threads, so the cache has to be filled in under a lock
+	os_unfair_lock_lock(&this->box_lock);
+
+	cache = this->array;
+	if (cache == NULL) {
+		cache = calloc(this->capacity, sizeof(XPC_CLASS(object)*));
+		atomic_store_explicit((_Atomic(XPC_CLASS(object)**)*)&this->array, cache, memory_order_release);
+	}
+
+	if (cache != NULL) {
+		if (cache[index] == nil) {
+			xpc_object_slot_publish(&cache[index], array_packed_box(this->packed_type, this->packed[index]));
+		}
+		result = cache[index];
+	}
+
+	os_unfair_lock_unlock(&this->box_lock);
+
+	return result;
+};
+
+// makes the given object the one for the value at the given index (which must already be set), since whoever gave it to us can still modify it.
+// if we can't allocate the cache, we just keep the value.
+static void array_packed_keep(struct xpc_array_s* this, NSUInteger index, XPC_CLASS(object)* object) {
+	XPC_CLASS(object)** cache = NULL;
+	XPC_CLASS(object)* old = nil;
+
+	os_unfair_lock_lock(&this->box_lock);
+
+	cache = this->array;
+	if (cache == NULL) {
+		cache = calloc(this->capacity, sizeof(XPC_CLASS(object)*));
+		atomic_store_explicit((_Atomic(XPC_CLASS(object)**)*)&this->array, cache, memory_order_release);
+	}
+
+	if (cache != NULL) {
+		old = cache[index];
+		xpc_object_slot_publish(&cache[index], [object retain]);
+	}
+
+	os_unfair_lock_unlock(&this->box_lock);
+
+	[old release];
+};
+
+// returns the current value at the given index, without creating an object for it
+static xpc_array_packed_value_t array_packed_value_at(struct xpc_array_s* this, NSUInteger index) {
+	XPC_CLASS(object)** cache = array_packed_cache(this);
+	XPC_CLASS(object)* object = (cache != NULL) ? xpc_object_slot_load(&cache[index]) : nil;
+	return (object != nil) ? array_packed_value_of(this->packed_type, object) : this->packed[index];
+};
+
+// turns a packed array into a normal one, e.g. because an object of another type is being added to it
+static bool array_unpack(struct xpc_array_s* this) {
+	XPC_CLASS(object)** array = NULL;
+
+	if (this->packed_type == XPC_ARRAY_PACKED_NONE) {
+		return true;
+	}
+
+	array = xpc_shared_alloc(this->capacity * sizeof(XPC_CLASS(object)*));
+	if (array == NULL) {
+		return false;
+	}
+
+	// objects that were already handed out have to stay the same, so only the missing ones are created
+	for (NSUInteger i = 0; i < this->size; ++i) {
+		XPC_CLASS(object)* object = (this->array != NULL) ? this->array[i] : nil;
+		array[i] = (object != nil) ? object : array_packed_box(this->packed_type, this->packed[i]);
+	}
+
+	free(this->array);
+	array_release_packed_storage(this->packed, this->capacity);
+	this->packed = NULL;
+	this->packed_type = XPC_ARRAY_PACKED_NONE;
+	this->array = array;
+	return true;
+};
+
+// packed arrays are serialized exactly like normal arrays of the corresponding objects would be (see `XPC_WRAPPER_CLASS_SERIAL_IMPL`)
+
+static xpc_serial_type_t array_packed_serial_type(xpc_array_packed_type_t type) {
+	switch (type) {
+		case XPC_ARRAY_PACKED_BOOL:   return XPC_SERIAL_TYPE_BOOL;
+		case XPC_ARRAY_PACKED_INT64:  return XPC_SERIAL_TYPE_INT64;
+		case XPC_ARRAY_PACKED_UINT64: return XPC_SERIAL_TYPE_UINT64;
+		case XPC_ARRAY_PACKED_DOUBLE: return XPC_SERIAL_TYPE_DOUBLE;
+		default:                      return XPC_SERIAL_TYPE_INVALID;
+	}
+};
+
+static xpc_array_packed_type_t array_packed_type_for_serial_type(xpc_serial_type_t type) {
+	switch (type) {
+		case XPC_SERIAL_TYPE_BOOL:   return XPC_ARRAY_PACKED_BOOL;
+		case XPC_SERIAL_TYPE_INT64:  return XPC_ARRAY_PACKED_INT64;
+		case XPC_SERIAL_TYPE_UINT64: return XPC_ARRAY_PACKED_UINT64;
+		case XPC_SERIAL_TYPE_DOUBLE: return XPC_ARRAY_PACKED_DOUBLE;
+		default:                     return XPC_ARRAY_PACKED_NONE;
+	}
+};
+
+// length of a single serialized value (i.e. its type followed by the value itself); bools are sent as 32-bit values
+static NSUInteger array_packed_serial_length(xpc_array_packed_type_t type) {
+	return xpc_serial_padded_length(sizeof(xpc_serial_type_t)) + xpc_serial_padded_length((type == XPC_ARRAY_PACKED_BOOL) ? sizeof(uint32_t) : sizeof(uint64_t));
+};
+
+// these loops only use byte swaps (which are no-ops on little-endian hosts) and fixed-size copies (rather than `OSWriteLittleInt64` and friends,
+// which go through `volatile` pointers), so the compiler is free to vectorize them.
+
+static void array_packed_encode(xpc_array_packed_type_t type, const xpc_array_packed_value_t* values, NSUInteger count, char* output) {
+	uint32_t serialType = OSSwapHostToLittleInt32(array_packed_serial_type(type));
+	NSUInteger stride = array_packed_serial_length(type);
+
+	for (NSUInteger i = 0; i < count; ++i, output += stride) {
+		memcpy(output, &serialType, sizeof(serialType));
+		if (type == XPC_ARRAY_PACKED_BOOL) {
+			uint32_t value = OSSwapHostToLittleInt32((uint32_t)values[i].uint64);
+			memcpy(output + sizeof(serialType), &value, sizeof(value));
+		} else if (type == XPC_ARRAY_PACKED_DOUBLE) {
+			// doubles are sent in host byte order (see `double.m`)
+			memcpy(output + sizeof(serialType), &values[i].double_value, sizeof(double));
+		} else {
+			uint64_t value = OSSwapHostToLittleInt64(values[i].uint64);
+			memcpy(output + sizeof(serialType), &value, sizeof(value));
+		}
+	}
+};
+
+// returns `false` if any of the values isn't of the given type
+static bool array_packed_decode(xpc_array_packed_type_t type, const char* input, NSUInteger count, xpc_array_packed_value_t* values) {
+	uint32_t serialType = OSSwapHostToLittleInt32(array_packed_serial_type(type));
+	NSUInteger stride = array_packed_serial_length(type);
+
+	for (NSUInteger i = 0; i < count; ++i, input += stride) {
+		if (memcmp(input, &serialType, sizeof(serialType)) != 0) {
+			return false;
+		}
+		if (type == XPC_ARRAY_PACKED_BOOL) {
+			uint32_t value = 0;
+			memcpy(&value, input + sizeof(serialType), sizeof(value));
+			values[i].uint64 = (value != 0) ? 1 : 0;
+		} else if (type == XPC_ARRAY_PACKED_DOUBLE) {
+			memcpy(&values[i].double_value, input + sizeof(serialType), sizeof(double));
+		} else {
+			uint64_t value = 0;
+			memcpy(&value, input + sizeof(serialType), sizeof(value));
+			values[i].uint64 = OSSwapLittleToHostInt64(value);
+		}
+	}
+
+	return true;
+};
+
+XPC_INLINE
+XPC_CLASS(object)** array_borrowed_copies(struct xpc_array_s* this) {
+	return atomic_load_explicit((_Atomic(XPC_CLASS(object)**)*)&this->borrowed_copies, memory_order_acquire);
+};
+
+// returns the object a normal array currently holds at the given index (which may be our own copy of a shared object), without handing it out.
+// `index` must be valid.
+XPC_INLINE
+XPC_CLASS(object)* array_current_object_at(struct xpc_array_s* this, NSUInteger index) {
+	XPC_CLASS(object)** copies = array_borrowed_copies(this);
+	XPC_CLASS(object)* object = (copies != NULL) ? xpc_object_slot_load(&copies[index]) : nil;
+	return (object != nil) ? object : this->array[index];
+};
+
+// returns our own copy of the given (shared, mutable) object at the given index, making it if this is the first time someone asked for it.
+// the array keeps the copy alive. returns `nil` if we run out of memory.
+static XPC_CLASS(object)* array_borrow(struct xpc_array_s* this, NSUInteger index, XPC_CLASS(object)* object) {
+	XPC_CLASS(object)** copies = NULL;
+	XPC_CLASS(object)* result = nil;
+
+	// readers can be on different threads, so the copies have to be made under a lock
+	os_unfair_lock_lock(&this->box_lock);
+
+	copies = this->borrowed_copies;
+	if (copies == NULL) {
+		// objects can only be added by modifying us, which gets rid of the copies
+		copies = calloc(this->size, sizeof(XPC_CLASS(object)*));
+		if (copies != NULL) {
+			this->borrowed_copies_capacity = this->size;
+			atomic_store_explicit((_Atomic(XPC_CLASS(object)**)*)&this->borrowed_copies, copies, memory_order_release);
+		}
+	}
+
+	if (copies != NULL) {
+		if (copies[index] == nil) {
+			xpc_object_slot_publish(&copies[index], [object copy]);
+		}
+		result = copies[index];
+	}
+
+	os_unfair_lock_unlock(&this->box_lock);
+
+	return result;
+};
+
+// releases our own copies of shared objects
+static void array_release_borrowed(struct xpc_array_s* this) {
+	if (this->borrowed_copies == NULL) {
+		return;
+	}
+	for (NSUInteger i = 0; i < this->borrowed_copies_capacity; ++i) {
+		[this->borrowed_copies[i] release];
+	}
+	free(this->borrowed_copies);
+	this->borrowed_copies = NULL;
+	this->borrowed_copies_capacity = 0;
+};
+
+// replaces the shared mutable objects in our (already unshared) buffer with our own copies of them, copying the ones we don't have a copy of yet.
+// we're being modified, so nobody else can be reading the buffer or the copies right now.
+static bool array_take_borrowed(struct xpc_array_s* this) {
+	if (!atomic_load_explicit(&this->borrows_children, memory_order_relaxed)) {
+		return true;
+	}
+
+	// make all the missing copies first, so that running out of memory leaves us as we were
+	for (NSUInteger i = 0; i < this->size; ++i) {
+		if (xpc_object_is_mutable(this->array[i]) && array_borrow(this, i, this->array[i]) == nil) {
+			return false;
+		}
+	}
+
+	if (this->borrowed_copies != NULL) {
+		for (NSUInteger i = 0; i < this->borrowed_copies_capacity; ++i) {
+			if (this->borrowed_copies[i] != nil) {
+				// the buffer takes over our reference to the copy
+				xpc_release_for_collection(this->array[i]);
+				this->array[i] = this->borrowed_copies[i];
+				this->borrowed_copies[i] = nil;
+			}
+		}
+		array_release_borrowed(this);
+	}
+
+	atomic_store_explicit(&this->borrows_children, false, memory_order_relaxed);
+	return true;
+};
+
+// returns the object to hand out for the given index, regardless of how the array is stored. `index` must be valid.
+XPC_INLINE
+XPC_CLASS(object)* array_object_at(struct xpc_array_s* this, NSUInteger index) {
+	XPC_CLASS(object)* object = nil;
+
+	if (this->packed_type != XPC_ARRAY_PACKED_NONE) {
+		return array_packed_object_at(this, index);
+	}
+
+	object = array_current_object_at(this, index);
+	if (object == this->array[index] && atomic_load_explicit(&this->borrows_children, memory_order_acquire) && xpc_object_is_mutable(object)) {
+		return array_borrow(this, index, object);
+	}
+	return object;
+};
+
+XPC_INLINE
+void array_invalidate_hash(struct xpc_array_s* this) {
+	atomic_store_explicit(&this->leaf_hash_state, XPC_CONTAINER_HASH_INVALID, memory_order_relaxed);
+};
+
+// makes sure the array can be modified without affecting any of its copies (or whatever it was copied from).
+static bool array_unshare(struct xpc_array_s* this) {
+	if (this->packed_type != XPC_ARRAY_PACKED_NONE) {
+		// our objects are never shared, only our values
+		if (!xpc_shared_is_unique(this->packed)) {
+			xpc_array_packed_value_t* packed = xpc_shared_alloc(this->capacity * sizeof(xpc_array_packed_value_t));
+			if (packed == NULL) {
+				return false;
+			}
+			memcpy(packed, this->packed, this->size * sizeof(xpc_array_packed_value_t));
+			array_release_packed_storage(this->packed, this->capacity);
+			this->packed = packed;
+		}
+		return true;
+	}
+
+	if (!xpc_shared_is_unique(this->array)) {
+		XPC_CLASS(object)** array = xpc_shared_alloc(this->capacity * sizeof(XPC_CLASS(object)*));
+		if (array == NULL) {
+			return false;
+		}
+		for (NSUInteger i = 0; i < this->size; ++i) {
+			array[i] = xpc_retain_for_collection(this->array[i]);
+		}
+		array_release_storage(this->array, this->size, this->capacity);
+		this->array = array;
+	}
+
+	return array_take_borrowed(this);
+};
+
+// makes room for at least `capacity` objects. the array must already be unshared.
+// the buffer grows geometrically, so appending one object at a time only reallocates a logarithmic number of times.
+static bool array_reserve(struct xpc_array_s* this, NSUInteger capacity) {
+	NSUInteger newCapacity = (this->capacity > 0) ? this->capacity : 4;
+	XPC_CLASS(object)** array = NULL;
+
+	if (capacity <= this->capacity) {
+		return true;
+	}
+
+	if (capacity > NSUIntegerMax / sizeof(XPC_CLASS(object)*) / 2) {
+		return false;
+	}
+
+	while (newCapacity < capacity) {
+		newCapacity *= 2;
+	}
+
+	if (this->packed_type != XPC_ARRAY_PACKED_NONE) {
+		xpc_array_packed_value_t* packed = NULL;
+
+		// the object cache is private, so it can simply be resized; it's fine for it to be bigger than `capacity` if growing `packed` fails
+		if (this->array != NULL) {
+			array = realloc(this->array, newCapacity * sizeof(XPC_CLASS(object)*));
+			if (array == NULL) {
+				return false;
+			}
+			memset(&array[this->capacity], 0, (newCapacity - this->capacity) * sizeof(XPC_CLASS(object)*));
+			this->array = array;
+		}
+
+		packed = xpc_shared_realloc(this->packed, this->capacity * sizeof(xpc_array_packed_value_t), newCapacity * sizeof(xpc_array_packed_value_t));
+		if (packed == NULL) {
+			return false;
+		}
+
+		this->packed = packed;
+		this->capacity = newCapacity;
+		return true;
+	}
+
+	array = xpc_shared_realloc(this->array, this->capacity * sizeof(XPC_CLASS(object)*), newCapacity * sizeof(XPC_CLASS(object)*));
+	if (array == NULL) {
+		return false;
+	}
+
+	this->array = array;
+	this->capacity = newCapacity;
+	return true;
+};
+
 OS_OBJECT_NONLAZY_CLASS
 @implementation XPC_CLASS(array)
 
@@ -43,49 +520,51 @@ XPC_CLASS_HEADER(array);
 - (void)dealloc
 {
 	XPC_THIS_DECL(array);
-	for (NSUInteger i = 0; i < this->size; ++i) {
-		xpc_release_for_collection(this->array[i]);
+	if (this->packed_type != XPC_ARRAY_PACKED_NONE) {
+		array_release_packed(this);
+	} else {
+		array_release_borrowed(this);
+		array_release_storage(this->array, this->size, this->capacity);
 	}
-	free(this->array);
 	[super dealloc];
 }
 
 - (char*)xpcDescription
 {
-	char* output = NULL;
+	return xpc_description_copy(self, NULL);
+}
+
+- (void)describeTo: (xpc_description_writer_t*)writer
+{
+	XPC_THIS_DECL(array);
 	size_t count = self.count;
+	size_t shown = 0;
+
+	xpc_description_printf(writer, "<%s: %p> [", xpc_class_name(self), self);
 
 	if (count == 0) {
-		asprintf(&output, "<%s: %p> []", xpc_class_name(self), self);
-		return output;
+		xpc_description_write(writer, "]", 1);
+		return;
 	}
 
-	char** descriptions = malloc(sizeof(char*) * count);
-
-	size_t outputLength = 0;
-	outputLength += snprintf(NULL, 0, "<%s: %p> [\n", xpc_class_name(self), self);
-	for (size_t i = 0; i < count; ++i) {
-		char* description = self[i].xpcDescription;
-		descriptions[i] = xpc_description_indent(description, true);
-		free(description);
-		outputLength += snprintf(NULL, 0, "%s\n", descriptions[i]);
+	if (!xpc_description_writer_enter(writer)) {
+		xpc_description_printf(writer, " %zu item%s ]", count, count == 1 ? "" : "s");
+		return;
 	}
-	outputLength += snprintf(NULL, 0, "]");
-
-	output = malloc(outputLength + 1);
-
-	size_t offset = 0;
-	offset += snprintf(output + offset, outputLength + 1 - offset, "<%s: %p> [\n", xpc_class_name(self), self);
 
-	for (size_t i = 0; i < count; ++i) {
-		offset += snprintf(output + offset, outputLength + 1 - offset, "%s\n", descriptions[i]);
-		free(descriptions[i]);
+	xpc_description_write(writer, "\n", 1);
+	shown = xpc_description_writer_element_limit(writer, count);
+	for (size_t i = 0; i < shown && !xpc_description_writer_is_done(writer); ++i) {
+		// this only looks at the objects, so packed values are the only ones that need an object created for them
+		xpc_description_write_object(writer, (this->packed_type != XPC_ARRAY_PACKED_NONE) ? array_packed_object_at(this, i) : array_current_object_at(this, i));
+		xpc_description_write(writer, "\n", 1);
+	}
+	if (shown < count) {
+		xpc_description_printf(writer, "... %zu more\n", count - shown);
 	}
-	free(descriptions);
-
-	offset += snprintf(output + offset, outputLength + 1 - offset, "]");
 
-	return output;
+	xpc_description_writer_leave(writer);
+	xpc_description_write(writer, "]", 1);
 }
 
 - (NSUInteger)count
@@ -99,13 +578,14 @@ XPC_CLASS_HEADER(array);
 	if (self = [super init]) {
 		XPC_THIS_DECL(array);
 
-		this->array = malloc(count * sizeof(XPC_CLASS(object)*));
+		this->array = xpc_shared_alloc(count * sizeof(XPC_CLASS(object)*));
 
 		if (!this->array) {
 			[self release];
 			return nil;
 		}
 
+		this->capacity = count;
 		this->size = count;
 		for (NSUInteger i = 0; i < count; ++i) {
 			this->array[i] = xpc_retain_for_collection(XPC_CAST(object, objects[i]));
@@ -114,6 +594,74 @@ XPC_CLASS_HEADER(array);
 	return self;
 }
 
+- (instancetype)initWithCapacity: (NSUInteger)capacity
+{
+	if (self = [super init]) {
+		XPC_THIS_DECL(array);
+
+		// this is only a hint, so failing to reserve space isn't fatal
+		array_reserve(this, capacity);
+	}
+	return self;
+}
+
+- (instancetype)initWithPackedType: (xpc_array_packed_type_t)type values: (const void*)values count: (NSUInteger)count
+{
+	if (self = [super init]) {
+		XPC_THIS_DECL(array);
+
+		if (type == XPC_ARRAY_PACKED_NONE || !array_make_packed(this, type, count)) {
+			[self release];
+			return nil;
+		}
+
+		if (type == XPC_ARRAY_PACKED_BOOL) {
+			const bool* bools = values;
+			for (NSUInteger i = 0; i < count; ++i) {
+				this->packed[i].uint64 = bools[i] ? 1 : 0;
+			}
+		} else if (count > 0) {
+			// the other types are all 64 bits wide, so they're stored exactly as they're given to us
+			memcpy(this->packed, values, count * sizeof(xpc_array_packed_value_t));
+		}
+	}
+	return self;
+}
+
++ (instancetype)newPackedWithSerializedContent: (const void*)content length: (NSUInteger)length count: (NSUInteger)count
+{
+	XPC_CLASS(array)* result = nil;
+	struct xpc_array_s* array = NULL;
+	uint32_t serialType = 0;
+	xpc_array_packed_type_t type = XPC_ARRAY_PACKED_NONE;
+
+	if (count == 0 || length < sizeof(serialType)) {
+		return nil;
+	}
+
+	// the first entry decides what the rest have to be
+	serialType = OSReadLittleInt32(content, 0);
+	type = array_packed_type_for_serial_type(serialType);
+	if (type == XPC_ARRAY_PACKED_NONE) {
+		return nil;
+	}
+
+	// if all the entries are values of that type, they take up exactly this much space
+	if (length % array_packed_serial_length(type) != 0 || length / array_packed_serial_length(type) != count) {
+		return nil;
+	}
+
+	result = [XPC_CLASS(array) new];
+	array = (struct xpc_array_s*)result;
+
+	if (!array_make_packed(array, type, count) || !array_packed_decode(type, content, count, array->packed)) {
+		[result release];
+		return nil;
+	}
+
+	return result;
+}
+
 - (XPC_CLASS(object)*)objectAtIndex: (NSUInteger)index
 {
 	XPC_THIS_DECL(array);
@@ -122,7 +670,7 @@ XPC_CLASS_HEADER(array);
 		return nil;
 	}
 
-	return this->array[index];
+	return array_object_at(this, index);
 }
 
 - (void)addObject: (XPC_CLASS(object)*)object
@@ -134,14 +682,60 @@ XPC_CLASS_HEADER(array);
 		return;
 	}
 
-	XPC_CLASS(object)** expandedArray = realloc(this->array, (this->size + 1) * sizeof(XPC_CLASS(object)*));
-	if (expandedArray == NULL) {
+	if (this->packed_type != XPC_ARRAY_PACKED_NONE && array_packed_type_of(object) != this->packed_type && !array_unpack(this)) {
+		return;
+	}
+
+	if (!array_unshare(this) || !array_reserve(this, this->size + 1)) {
 		// we have no way to report errors, so just silently leave everything in its previous state
 		return;
 	}
-	this->array = expandedArray;
 
-	this->array[this->size++] = xpc_retain_for_collection(object);
+	if (this->packed_type != XPC_ARRAY_PACKED_NONE) {
+		this->packed[this->size++] = array_packed_value_of(this->packed_type, object);
+		array_packed_keep(this, this->size - 1, object);
+	} else {
+		this->array[this->size++] = xpc_retain_for_collection(object);
+	}
+	array_invalidate_hash(this);
+}
+
+- (void)addObjects: (XPC_CLASS(object)* const*)objects count: (NSUInteger)count
+{
+	XPC_THIS_DECL(array);
+
+	if (count == 0) {
+		return;
+	}
+
+	if (this->packed_type != XPC_ARRAY_PACKED_NONE) {
+		for (NSUInteger i = 0; i < count; ++i) {
+			if (objects[i] != nil && array_packed_type_of(objects[i]) != this->packed_type) {
+				if (!array_unpack(this)) {
+					return;
+				}
+				break;
+			}
+		}
+	}
+
+	if (count > NSUIntegerMax - this->size || !array_unshare(this) || !array_reserve(this, this->size + count)) {
+		// same as `addObject:`; nothing is appended
+		return;
+	}
+
+	for (NSUInteger i = 0; i < count; ++i) {
+		if (objects[i] == nil) {
+			continue;
+		}
+		if (this->packed_type != XPC_ARRAY_PACKED_NONE) {
+			this->packed[this->size++] = array_packed_value_of(this->packed_type, objects[i]);
+			array_packed_keep(this, this->size - 1, objects[i]);
+		} else {
+			this->array[this->size++] = xpc_retain_for_collection(objects[i]);
+		}
+	}
+	array_invalidate_hash(this);
 }
 
 - (void)replaceObjectAtIndex: (NSUInteger)index withObject: (XPC_CLASS(object)*)object
@@ -153,9 +747,26 @@ XPC_CLASS_HEADER(array);
 		return;
 	}
 
+	if (this->packed_type != XPC_ARRAY_PACKED_NONE && array_packed_type_of(object) != this->packed_type && !array_unpack(this)) {
+		return;
+	}
+
+	if (!array_unshare(this)) {
+		return;
+	}
+
+	if (this->packed_type != XPC_ARRAY_PACKED_NONE) {
+		this->packed[index] = array_packed_value_of(this->packed_type, object);
+		// this replaces the object for the old value (if we had one)
+		array_packed_keep(this, index, object);
+		array_invalidate_hash(this);
+		return;
+	}
+
 	XPC_CLASS(object)* old = this->array[index];
 	this->array[index] = xpc_retain_for_collection(object);
-	[old release];
+	xpc_release_for_collection(old);
+	array_invalidate_hash(this);
 }
 
 - (void)enumerateObjectsUsingBlock: (void (^)(XPC_CLASS(object)* object, NSUInteger index, BOOL* stop))block
@@ -164,7 +775,7 @@ XPC_CLASS_HEADER(array);
 
 	for (NSUInteger i = 0; i < this->size; ++i) {
 		BOOL stop = NO;
-		block(this->array[i], i, &stop);
+		block(array_object_at(this, i), i, &stop);
 		if (stop) {
 			break;
 		}
@@ -183,41 +794,191 @@ XPC_CLASS_HEADER(array);
 
 - (NSUInteger)countByEnumeratingWithState: (NSFastEnumerationState*)state objects: (id __unsafe_unretained [])objects count: (NSUInteger)count
 {
+	XPC_THIS_DECL(array);
+	NSUInteger produced = 0;
+
 	if (state->state == 0) {
-		XPC_THIS_DECL(array);
+		// fast enumeration needs an object for every value up front
+		if (this->packed_type != XPC_ARRAY_PACKED_NONE) {
+			for (NSUInteger i = 0; i < this->size; ++i) {
+				if (array_packed_object_at(this, i) == nil) {
+					return 0;
+				}
+			}
+		}
 
 		// note that this will only detect mutations of adding new objects, not reassigning existing ones
 		state->mutationsPtr = &this->size;
-		state->itemsPtr = this->array;
 		state->state = 1;
-		return this->size;
-	} else {
+
+		if (this->packed_type != XPC_ARRAY_PACKED_NONE || !atomic_load_explicit(&this->borrows_children, memory_order_acquire)) {
+			state->itemsPtr = this->array;
+			return this->size;
+		}
+
+		// shared mutable objects have to be handed out as our own copies, which aren't in `array`,
+		// so we go through the caller's buffer instead. `extra[0]` is the next index and `extra[1]` marks that we're doing this.
+		state->extra[0] = 0;
+		state->extra[1] = 1;
+	}
+
+	if (state->extra[1] == 0) {
 		return 0;
 	}
+
+	state->itemsPtr = objects;
+	while (produced < count && state->extra[0] < this->size) {
+		objects[produced++] = array_object_at(this, state->extra[0]++);
+	}
+	return produced;
 }
 
 - (NSUInteger)hash
 {
 	XPC_THIS_DECL(array);
+	unsigned char state = atomic_load_explicit(&this->leaf_hash_state, memory_order_acquire);
+	// read before anything is hashed, so that modifications made while we're hashing also invalidate what we cache
+	size_t generation = xpc_leaf_generation();
 	NSUInteger result = 0;
 
-	for (NSUInteger i = 0; i < this->size; ++i) {
-		result += [this->array[i] hash];
+	if (state != XPC_CONTAINER_HASH_INVALID && this->leaf_hash_generation != generation) {
+		state = XPC_CONTAINER_HASH_INVALID;
+	}
+
+	if (this->packed_type != XPC_ARRAY_PACKED_NONE && array_packed_cache(this) != NULL) {
+		// objects we've handed out can be modified without us knowing, so this can't be cached
+		for (NSUInteger i = 0; i < this->size; ++i) {
+			result += xpc_hash_combine(i, array_packed_hash(this->packed_type, array_packed_value_at(this, i)));
+		}
+		return result;
+	}
+
+	if (state == XPC_CONTAINER_HASH_INVALID) {
+		state = XPC_CONTAINER_HASH_COMPLETE;
+		for (NSUInteger i = 0; i < this->size; ++i) {
+			if (this->packed_type != XPC_ARRAY_PACKED_NONE) {
+				// this doesn't need to create any objects
+				result += xpc_hash_combine(i, array_packed_hash(this->packed_type, this->packed[i]));
+				continue;
+			}
+			XPC_CLASS(object)* object = array_current_object_at(this, i);
+			if (xpc_object_is_mutable(object)) {
+				state = XPC_CONTAINER_HASH_PARTIAL;
+				continue;
+			}
+			// each object is mixed with its index, so that the sum depends on the order
+			result += xpc_hash_combine(i, [object hash]);
+		}
+		// global objects (like the `XPC_ERROR_*` dictionaries) may be in read-only memory, so they just recompute it every time
+		if (!XPC_OBJECT_IS_GLOBAL(this)) {
+			this->leaf_hash = result;
+			this->leaf_hash_generation = generation;
+			atomic_store_explicit(&this->leaf_hash_state, state, memory_order_release);
+		}
+	} else {
+		result = this->leaf_hash;
+	}
+
+	if (state == XPC_CONTAINER_HASH_PARTIAL) {
+		// nested containers cache their own hashes, so this only has to visit each of them rather than everything they contain
+		for (NSUInteger i = 0; i < this->size; ++i) {
+			XPC_CLASS(object)* object = array_current_object_at(this, i);
+			if (xpc_object_is_mutable(object)) {
+				result += xpc_hash_combine(i, [object hash]);
+			}
+		}
 	}
 
 	return result;
 }
 
-- (instancetype)copy
+- (BOOL)isEqualToObject: (XPC_CLASS(object)*)object
 {
 	XPC_THIS_DECL(array);
+	struct xpc_array_s* other = (struct xpc_array_s*)object;
 
-	XPC_CLASS(array)* result = [XPC_CLASS(array) new];
+	if (this->size != other->size) {
+		return NO;
+	}
+
+	// the wrapper classes compare their raw values, so packed values can be compared the same way
+	if (this->packed_type != XPC_ARRAY_PACKED_NONE && this->packed_type == other->packed_type) {
+		if (array_packed_cache(this) == NULL && array_packed_cache(other) == NULL) {
+			return this->size == 0 || memcmp(this->packed, other->packed, this->size * sizeof(xpc_array_packed_value_t)) == 0;
+		}
+		for (NSUInteger i = 0; i < this->size; ++i) {
+			xpc_array_packed_value_t ours = array_packed_value_at(this, i);
+			xpc_array_packed_value_t theirs = array_packed_value_at(other, i);
+			if (memcmp(&ours, &theirs, sizeof(xpc_array_packed_value_t)) != 0) {
+				return NO;
+			}
+		}
+		return YES;
+	}
 
 	for (NSUInteger i = 0; i < this->size; ++i) {
-		XPC_CLASS(object)* copied = [this->array[i] copy];
-		[result addObject: copied];
-		[copied release];
+		// this only looks at the objects, so shared ones don't need to be copied
+		XPC_CLASS(object)* ours = (this->packed_type != XPC_ARRAY_PACKED_NONE) ? array_packed_object_at(this, i) : array_current_object_at(this, i);
+		XPC_CLASS(object)* theirs = (other->packed_type != XPC_ARRAY_PACKED_NONE) ? array_packed_object_at(other, i) : array_current_object_at(other, i);
+		if (![ours isEqual: theirs]) {
+			return NO;
+		}
+	}
+
+	return YES;
+}
+
+- (instancetype)copy
+{
+	XPC_THIS_DECL(array);
+
+	XPC_CLASS(array)* result = [XPC_CLASS(array) new];
+	struct xpc_array_s* copy = (struct xpc_array_s*)result;
+	bool sharesMutableObjects = false;
+
+	// nothing is actually copied until one of us is modified
+	if (this->packed_type != XPC_ARRAY_PACKED_NONE && array_packed_cache(this) == NULL) {
+		// the copy creates its own objects when it needs them
+		copy->packed_type = this->packed_type;
+		copy->packed = xpc_shared_retain(this->packed);
+	} else if (this->packed_type != XPC_ARRAY_PACKED_NONE) {
+		// the objects we've handed out may have been modified, so the copy gets their current values instead
+		if (!array_make_packed(copy, this->packed_type, this->capacity)) {
+			[result release];
+			return nil;
+		}
+		for (NSUInteger i = 0; i < this->size; ++i) {
+			copy->packed[i] = array_packed_value_at(this, i);
+		}
+	} else if (array_borrowed_copies(this) == NULL) {
+		// that includes our mutable objects (see `array_borrow`)
+		copy->array = xpc_shared_retain(this->array);
+		sharesMutableObjects = true;
+	} else {
+		// we've already made our own copies of some shared objects, so the copy needs a buffer with those in it (the objects themselves are still shared)
+		XPC_CLASS(object)** array = xpc_shared_alloc(this->capacity * sizeof(XPC_CLASS(object)*));
+		if (array == NULL) {
+			[result release];
+			return nil;
+		}
+		for (NSUInteger i = 0; i < this->size; ++i) {
+			array[i] = xpc_retain_for_collection(array_current_object_at(this, i));
+		}
+		copy->array = array;
+		sharesMutableObjects = true;
+	}
+	copy->size = this->size;
+	copy->capacity = this->capacity;
+	atomic_store_explicit(&copy->leaf_hash_state, atomic_load_explicit(&this->leaf_hash_state, memory_order_acquire), memory_order_relaxed);
+	copy->leaf_hash = this->leaf_hash;
+	copy->leaf_hash_generation = this->leaf_hash_generation;
+
+	if (sharesMutableObjects) {
+		atomic_store_explicit(&copy->borrows_children, true, memory_order_relaxed);
+		// global objects may be in read-only memory, but they never have mutable objects anyway
+		if (!XPC_OBJECT_IS_GLOBAL(this)) {
+			atomic_store_explicit(&this->borrows_children, true, memory_order_release);
+		}
 	}
 
 	return result;
@@ -233,6 +994,11 @@ XPC_CLASS_HEADER(array);
 }
 
 - (NSUInteger)serializationLength
+{
+	return [self serializationLengthWithSerializer: nil];
+}
+
+- (NSUInteger)serializationLengthWithSerializer: (XPC_CLASS(serializer)*)serializer
 {
 	XPC_THIS_DECL(array);
 	NSUInteger total = 0;
@@ -241,65 +1007,41 @@ XPC_CLASS_HEADER(array);
 	total += xpc_serial_padded_length(sizeof(uint32_t));
 	total += xpc_serial_padded_length(sizeof(uint32_t));
 
-	for (NSUInteger i = 0; i < this->size; ++i) {
-		XPC_CLASS(object)* object = this->array[i];
-		if (!object.serializable) {
-			object = [XPC_CLASS(null) null];
+	if (this->packed_type != XPC_ARRAY_PACKED_NONE) {
+		total += this->size * array_packed_serial_length(this->packed_type);
+	} else {
+		for (NSUInteger i = 0; i < this->size; ++i) {
+			XPC_CLASS(object)* object = array_current_object_at(this, i);
+			if (!xpc_serial_object_is_serializable(object)) {
+				object = [XPC_CLASS(null) null];
+			}
+			total += serializer ? [serializer lengthOfObject: object] : object.serializationLength;
 		}
-		total += object.serializationLength;
 	}
 
+	[serializer cacheLength: total forObject: self];
+
 	return total;
 }
 
 + (instancetype)deserialize: (XPC_CLASS(deserializer)*)deserializer
 {
-	XPC_CLASS(array)* result = nil;
+	XPC_CLASS(object)* result = nil;
 	xpc_serial_type_t type = XPC_SERIAL_TYPE_INVALID;
-	uint32_t contentLength = 0;
-	uint32_t entryCount = 0;
-	NSUInteger contentStartOffset = 0;
 
-	if (![deserializer readU32: &type]) {
-		goto error_out;
+	if (![deserializer peekU32: &type]) {
+		return nil;
 	}
 	if (type != XPC_SERIAL_TYPE_ARRAY) {
-		goto error_out;
-	}
-
-	if (![deserializer readU32: &contentLength]) {
-		goto error_out;
-	}
-
-	// the element/entry count is included in the content length
-	contentStartOffset = deserializer.offset;
-
-	if (![deserializer readU32: &entryCount]) {
-		goto error_out;
-	}
-
-	result = [[[self class] alloc] initWithObjects: NULL count: 0];
-
-	for (uint32_t i = 0; i < entryCount; ++i) {
-		XPC_CLASS(object)* object = nil;
-		if (![deserializer readObject: &object]) {
-			goto error_out;
-		}
-		[result addObject: object];
-		[object release];
+		return nil;
 	}
 
-	if (deserializer.offset - contentStartOffset != contentLength) {
-		goto error_out;
+	// containers are decoded iteratively by the deserializer itself, so that nesting doesn't recurse
+	if (![deserializer readObject: &result]) {
+		return nil;
 	}
 
-	return result;
-
-error_out:
-	if (result != nil) {
-		[result release];
-	}
-	return nil;
+	return (XPC_CLASS(array)*)result;
 }
 
 - (BOOL)serialize: (XPC_CLASS(serializer)*)serializer
@@ -323,14 +1065,30 @@ error_out:
 		goto error_out;
 	}
 
-	for (NSUInteger i = 0; i < this->size; ++i) {
-		XPC_CLASS(object)* object = this->array[i];
-		if (!object.serializable) {
-			object = [XPC_CLASS(null) null];
-		}
-		if (![serializer writeObject: object]) {
+	if (this->packed_type != XPC_ARRAY_PACKED_NONE) {
+		void* region = NULL;
+		if (![serializer reserve: this->size * array_packed_serial_length(this->packed_type) region: &region]) {
 			goto error_out;
 		}
+		array_packed_encode(this->packed_type, this->packed, this->size, region);
+		if (array_packed_cache(this) != NULL) {
+			// the objects we've handed out may have been modified since
+			NSUInteger stride = array_packed_serial_length(this->packed_type);
+			for (NSUInteger i = 0; i < this->size; ++i) {
+				xpc_array_packed_value_t value = array_packed_value_at(this, i);
+				array_packed_encode(this->packed_type, &value, 1, (char*)region + i * stride);
+			}
+		}
+	} else {
+		for (NSUInteger i = 0; i < this->size; ++i) {
+			XPC_CLASS(object)* object = array_current_object_at(this, i);
+			if (!xpc_serial_object_is_serializable(object)) {
+				object = [XPC_CLASS(null) null];
+			}
+			if (![serializer writeObject: object]) {
+				goto error_out;
+			}
+		}
 	}
 
 	OSWriteLittleInt32(reservedForContentLength, 0, serializer.offset - contentStartOffset);
@@ -349,7 +1107,7 @@ error_out:
 
 XPC_EXPORT
 xpc_object_t xpc_array_create(const xpc_object_t* objects, size_t count) {
-	return [[XPC_CLASS(array) alloc] initWithObjects: (XPC_CLASS(object)* const*)objects count: count];
+	return [XPC_OBJECT_ALLOC(array) initWithObjects: (XPC_CLASS(object)* const*)objects count: count];
 };
 
 XPC_EXPORT
@@ -372,7 +1130,7 @@ void xpc_array_append_value(xpc_object_t xarray, xpc_object_t value) {
 XPC_EXPORT
 size_t xpc_array_get_count(xpc_object_t xarray) {
 	TO_OBJC_CHECKED(array, xarray, array) {
-		return array.count;
+		return ((struct xpc_array_s*)array)->size;
 	}
 	return 0;
 };
@@ -410,10 +1168,66 @@ void xpc_array_apply_f(xpc_object_t xarray, void* context, xpc_array_applier_f a
 	});
 };
 
+XPC_EXPORT
+xpc_object_t xpc_array_create_with_capacity(size_t capacity) {
+	return [[XPC_CLASS(array) alloc] initWithCapacity: capacity];
+};
+
+XPC_EXPORT
+void xpc_array_append_values(xpc_object_t xarray, const xpc_object_t* values, size_t count) {
+	TO_OBJC_CHECKED(array, xarray, array) {
+		[array addObjects: (XPC_CLASS(object)* const*)values count: count];
+	}
+};
+
+XPC_EXPORT
+xpc_object_t xpc_array_create_bools(const bool* values, size_t count) {
+	return [[XPC_CLASS(array) alloc] initWithPackedType: XPC_ARRAY_PACKED_BOOL values: values count: count];
+};
+
+XPC_EXPORT
+xpc_object_t xpc_array_create_int64s(const int64_t* values, size_t count) {
+	return [[XPC_CLASS(array) alloc] initWithPackedType: XPC_ARRAY_PACKED_INT64 values: values count: count];
+};
+
+XPC_EXPORT
+xpc_object_t xpc_array_create_uint64s(const uint64_t* values, size_t count) {
+	return [[XPC_CLASS(array) alloc] initWithPackedType: XPC_ARRAY_PACKED_UINT64 values: values count: count];
+};
+
+XPC_EXPORT
+xpc_object_t xpc_array_create_doubles(const double* values, size_t count) {
+	return [[XPC_CLASS(array) alloc] initWithPackedType: XPC_ARRAY_PACKED_DOUBLE values: values count: count];
+};
+
 //
 // setters
 //
 
+// sets (or appends, for `XPC_ARRAY_APPEND`) a value of a packed array's own type, without an object for it
+static void array_packed_set_value(struct xpc_array_s* this, size_t index, xpc_array_packed_value_t value) {
+	if (index == XPC_ARRAY_APPEND) {
+		index = this->size;
+		if (!array_unshare(this) || !array_reserve(this, this->size + 1)) {
+			// no way to report errors
+			return;
+		}
+		++this->size;
+	} else if (index >= this->size || !array_unshare(this)) {
+		return;
+	}
+
+	this->packed[index] = value;
+
+	// drop the object for the old value (if we had one); a new one will be created when needed
+	if (this->array != NULL && this->array[index] != nil) {
+		[this->array[index] release];
+		this->array[index] = nil;
+	}
+
+	array_invalidate_hash(this);
+};
+
 #define SIMPLE_SETTER(name, type) \
 	XPC_EXPORT \
 	void xpc_array_set_ ## name(xpc_object_t xarray, size_t index, type value) { \
@@ -424,10 +1238,28 @@ void xpc_array_apply_f(xpc_object_t xarray, void* context, xpc_array_applier_f a
 		} \
 	};
 
-SIMPLE_SETTER(bool, bool);
-SIMPLE_SETTER(int64, int64_t);
-SIMPLE_SETTER(uint64, uint64_t);
-SIMPLE_SETTER(double, double);
+// packed arrays can store the value directly; nobody else has the object we'd create for it, so there's no need to keep one around
+#define PACKED_SETTER(name, type, packedType, member, create) \
+	XPC_EXPORT \
+	void xpc_array_set_ ## name(xpc_object_t xarray, size_t index, type value) { \
+		TO_OBJC_CHECKED(array, xarray, array) { \
+			struct xpc_array_s* this = (struct xpc_array_s*)array; \
+			if (this->packed_type == packedType) { \
+				xpc_array_packed_value_t packedValue = { .member = value }; \
+				array_packed_set_value(this, index, packedValue); \
+				return; \
+			} \
+			xpc_object_t object = create(value); \
+			xpc_array_set_value(xarray, index, object); \
+			xpc_release(object); \
+		} \
+	};
+
+// for the same reason, small integers can use the global objects
+PACKED_SETTER(bool, bool, XPC_ARRAY_PACKED_BOOL, uint64, xpc_bool_create);
+PACKED_SETTER(int64, int64_t, XPC_ARRAY_PACKED_INT64, int64, xpc_int64_create_shared);
+PACKED_SETTER(uint64, uint64_t, XPC_ARRAY_PACKED_UINT64, uint64, xpc_uint64_create_shared);
+PACKED_SETTER(double, double, XPC_ARRAY_PACKED_DOUBLE, double_value, xpc_double_create);
 SIMPLE_SETTER(date, int64_t);
 SIMPLE_SETTER(string, const char*);
 SIMPLE_SETTER(uuid, const uuid_t);
@@ -460,10 +1292,24 @@ void xpc_array_set_connection(xpc_object_t xarray, size_t index, xpc_connection_
 		return xpc_ ## name ## _get_value(object); \
 	};
 
-SIMPLE_GETTER(bool, bool);
-SIMPLE_GETTER(int64, int64_t);
-SIMPLE_GETTER(uint64, uint64_t);
-SIMPLE_GETTER(double, double);
+// packed arrays can return their values directly, without creating an object for them
+#define PACKED_GETTER(name, type, packedType, member) \
+	XPC_EXPORT \
+	type xpc_array_get_ ## name(xpc_object_t xarray, size_t index) { \
+		TO_OBJC_CHECKED(array, xarray, array) { \
+			struct xpc_array_s* this = (struct xpc_array_s*)array; \
+			if (this->packed_type == packedType && index < this->size) { \
+				return array_packed_value_at(this, index).member; \
+			} \
+		} \
+		xpc_object_t object = xpc_array_get_value(xarray, index); \
+		return xpc_ ## name ## _get_value(object); \
+	};
+
+PACKED_GETTER(bool, bool, XPC_ARRAY_PACKED_BOOL, uint64 != 0);
+PACKED_GETTER(int64, int64_t, XPC_ARRAY_PACKED_INT64, int64);
+PACKED_GETTER(uint64, uint64_t, XPC_ARRAY_PACKED_UINT64, uint64);
+PACKED_GETTER(double, double, XPC_ARRAY_PACKED_DOUBLE, double_value);
 SIMPLE_GETTER(date, int64_t);
 SIMPLE_GETTER(pointer, void*);
 
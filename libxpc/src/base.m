@@ -23,6 +23,7 @@
 #import <objc/objc.h>
 #import <xpc/xpc.h>
 #import <xpc/serialization.h>
+#import <xpc/util.h>
 // the symbol alias for the base xpc_object class is named differently
 XPC_EXPORT struct objc_class _xpc_type_base;
 _CREATE_ALIAS(OS_OBJC_CLASS_RAW_SYMBOL_NAME(XPC_CLASS(object)), "__xpc_type_base");
@@ -54,6 +55,15 @@ _Pragma("GCC diagnostic pop");
 	return string;
 }
 
+- (void)describeTo: (xpc_description_writer_t*)writer
+{
+	char* description = self.xpcDescription;
+	if (description) {
+		xpc_description_write(writer, description, strlen(description));
+		free(description);
+	}
+}
+
 - (NSString*)description
 {
 	Class nsstring = objc_lookUpClass("NSString");
@@ -67,10 +77,22 @@ _Pragma("GCC diagnostic pop");
 
 - (BOOL)isEqual: (id)object
 {
-	if (![object isKindOfClass: [self class]]) {
+	if (object == self) {
+		return YES;
+	}
+	if (object == nil || [object class] != [self class]) {
+		return NO;
+	}
+	// containers cache their hashes, so this is usually cheap; and if the hashes differ, the contents definitely do
+	if ([self hash] != [object hash]) {
 		return NO;
 	}
-	return [self hash] == [object hash];
+	return [self isEqualToObject: object];
+}
+
+- (BOOL)isEqualToObject: (XPC_CLASS(object)*)object
+{
+	return NO;
 }
 
 - (instancetype)copy
@@ -92,6 +114,11 @@ _Pragma("GCC diagnostic pop");
 	return 0;
 }
 
+- (NSUInteger)serializationLengthWithSerializer: (XPC_CLASS(serializer)*)serializer
+{
+	return self.serializationLength;
+}
+
 + (instancetype)deserialize: (XPC_CLASS(deserializer)*)deserializer
 {
 	return nil;
@@ -135,7 +162,7 @@ size_t xpc_hash(xpc_object_t object) {
 
 XPC_EXPORT
 char* xpc_copy_description(xpc_object_t object) {
-	return [XPC_CAST(object, object) xpcDescription];
+	return xpc_description_copy(XPC_CAST(object, object), NULL);
 };
 
 //
@@ -150,8 +177,36 @@ char* xpc_copy_debug_description(xpc_object_t object) {
 
 XPC_EXPORT
 char* xpc_copy_short_description(xpc_object_t object) {
-	// for now
-	return xpc_copy_description(object);
+	// enough to tell what an object is at a glance (e.g. in a log message), no matter how big it is
+	static const xpc_description_limits_t limits = {
+		.max_bytes = 512,
+		.max_depth = 1,
+		.max_elements = 8,
+	};
+	return xpc_description_copy(XPC_CAST(object, object), &limits);
+};
+
+XPC_EXPORT
+char* xpc_copy_description_with_limits(xpc_object_t object, const xpc_description_limits_t* limits) {
+	return xpc_description_copy(XPC_CAST(object, object), limits);
+};
+
+XPC_EXPORT
+bool xpc_description_write_to_file(xpc_object_t object, FILE* file, const xpc_description_limits_t* limits) {
+	xpc_description_writer_t writer;
+	xpc_description_writer_init_file(&writer, file, limits);
+	xpc_description_write_object(&writer, XPC_CAST(object, object));
+	xpc_description_writer_finish(&writer);
+	return !writer.failed;
+};
+
+XPC_EXPORT
+bool xpc_description_write_to_fd(xpc_object_t object, int fd, const xpc_description_limits_t* limits) {
+	xpc_description_writer_t writer;
+	xpc_description_writer_init_fd(&writer, fd, limits);
+	xpc_description_write_object(&writer, XPC_CAST(object, object));
+	xpc_description_writer_finish(&writer);
+	return !writer.failed;
 };
 
 XPC_EXPORT
@@ -72,7 +72,12 @@ XPC_CLASS_HEADER(bool);
 - (void)setValue: (BOOL)value
 {
 	XPC_THIS_DECL(bool);
+	// `true` and `false` can't change what they are
+	if (XPC_OBJECT_IS_GLOBAL(this)) {
+		return;
+	}
 	this->value = value;
+	xpc_leaf_generation_advance();
 }
 
 - (instancetype)initWithValue: (BOOL)value
@@ -105,6 +110,11 @@ XPC_CLASS_HEADER(bool);
 	}
 }
 
+- (BOOL)isEqualToObject: (XPC_CLASS(object)*)object
+{
+	return self.value == XPC_CAST(bool, object).value;
+}
+
 @end
 
 @implementation XPC_CLASS(bool) (XPCSerialization)
@@ -147,6 +157,20 @@ error_out:
 	return nil;
 }
 
++ (BOOL)skip: (XPC_CLASS(deserializer)*)deserializer
+{
+	xpc_serial_type_t type = XPC_SERIAL_TYPE_INVALID;
+
+	if (![deserializer readU32: &type]) {
+		return NO;
+	}
+	if (type != XPC_SERIAL_TYPE_BOOL) {
+		return NO;
+	}
+
+	return [deserializer readU32: NULL];
+}
+
 - (BOOL)serialize: (XPC_CLASS(serializer)*)serializer
 {
 	XPC_THIS_DECL(bool);
@@ -175,7 +199,7 @@ error_out:
 
 XPC_EXPORT
 xpc_object_t xpc_bool_create(bool value) {
-	return [XPC_CLASS(bool) boolForValue: value];
+	return value ? XPC_BOOL_TRUE : XPC_BOOL_FALSE;
 };
 
 XPC_EXPORT
@@ -183,7 +207,7 @@ bool xpc_bool_get_value(xpc_object_t xbool) {
 #undef bool
 	TO_OBJC_CHECKED(bool, xbool, boolObj) {
 #define bool _Bool
-		return boolObj.value;
+		return ((struct xpc_bool_s*)boolObj)->value;
 	}
 	return false;
 };
@@ -193,6 +217,10 @@ bool xpc_bool_set_value(xpc_object_t xbool, bool value) {
 #undef bool
     TO_OBJC_CHECKED(bool, xbool, boolObj) {
 #define bool _Bool
+        // `XPC_BOOL_TRUE` and `XPC_BOOL_FALSE` can't change what they are; only distinct bools can be modified
+        if (XPC_OBJECT_IS_GLOBAL((struct xpc_bool_s*)boolObj)) {
+            return false;
+        }
         boolObj.value = value;
         return true;
     }
@@ -223,7 +223,12 @@ static void dispatch_mach_handler(void* context, dispatch_mach_reason_t reason,
 				}
 
 				[message retain]; // because the deserializer consumes a reference on the message
-				dict = [XPC_CLASS(deserializer) process: message];
+				dict = [XPC_CLASS(deserializer) process: message validate: this->validates_messages limits: &this->message_limits];
+				if (!dict) {
+					// the deserializer already released the sender's reply right (if any), so a sender waiting for a reply gets an error
+					xpc_log_error(connection, "connection %p: dropping malformed or oversized message", self);
+					return;
+				}
 				dict.associatedConnection = self;
 				if (token) {
 					[dict setAssociatedAuditToken: token];
@@ -526,6 +531,30 @@ OS_OBJECT_USES_XREF_DISPOSE();
 	objc_storeWeak(&this->parent_server, parentServer);
 }
 
+- (xpc_deserial_limits_t)messageLimits
+{
+	XPC_THIS_DECL(connection);
+	return this->message_limits;
+}
+
+- (void)setMessageLimits: (xpc_deserial_limits_t)messageLimits
+{
+	XPC_THIS_DECL(connection);
+	this->message_limits = messageLimits;
+}
+
+- (BOOL)validatesMessages
+{
+	XPC_THIS_DECL(connection);
+	return this->validates_messages;
+}
+
+- (void)setValidatesMessages: (BOOL)validatesMessages
+{
+	XPC_THIS_DECL(connection);
+	this->validates_messages = validatesMessages;
+}
+
 // _xref_dispose is called when all user references to the object have been released,
 // but we're not actually dead yet
 - (void)_xref_dispose
@@ -691,6 +720,8 @@ OS_OBJECT_USES_XREF_DISPOSE();
 		self.parentServer = server;
 
 		this->is_server_peer = true;
+		this->message_limits = server.messageLimits;
+		this->validates_messages = server.validatesMessages;
 		this->mach_ctx = dispatch_mach_create_4libxpc("org.darlinghq.libxpc.server-peer", NULL, self, dispatch_mach_handler);
 
 		this->send_port = sendPort;
@@ -1249,6 +1280,40 @@ xpc_object_t xpc_connection_copy_entitlement_value(xpc_connection_t xconn, const
 // private C API
 //
 
+XPC_EXPORT
+void xpc_connection_set_max_message_depth(xpc_connection_t xconn, size_t depth) {
+	TO_OBJC_CHECKED(connection, xconn, conn) {
+		xpc_deserial_limits_t limits = conn.messageLimits;
+		limits.max_depth = depth;
+		conn.messageLimits = limits;
+	}
+};
+
+XPC_EXPORT
+void xpc_connection_set_max_message_objects(xpc_connection_t xconn, size_t count) {
+	TO_OBJC_CHECKED(connection, xconn, conn) {
+		xpc_deserial_limits_t limits = conn.messageLimits;
+		limits.max_objects = count;
+		conn.messageLimits = limits;
+	}
+};
+
+XPC_EXPORT
+void xpc_connection_set_max_message_size(xpc_connection_t xconn, size_t size) {
+	TO_OBJC_CHECKED(connection, xconn, conn) {
+		xpc_deserial_limits_t limits = conn.messageLimits;
+		limits.max_bytes = size;
+		conn.messageLimits = limits;
+	}
+};
+
+XPC_EXPORT
+void xpc_connection_set_validate_messages(xpc_connection_t xconn, bool validate) {
+	TO_OBJC_CHECKED(connection, xconn, conn) {
+		conn.validatesMessages = validate;
+	}
+};
+
 XPC_EXPORT
 void _xpc_connection_set_event_handler_f(xpc_connection_t xconn, void (*handler)(xpc_object_t event, void* context)) {
 	// unsure about the parameters to the handler
@@ -26,6 +26,24 @@
 
 XPC_CLASS_SYMBOL_DECL(data);
 
+// checks whether the bytes at the given offset into the data match the given bytes, looking at each region of the data directly
+static bool data_region_matches(dispatch_data_t data, size_t offset, const void* bytes, size_t length) {
+	__block bool matches = true;
+	size_t end = offset + length;
+
+	dispatch_data_apply(data, ^bool (dispatch_data_t subrange, size_t regionOffset, const void* region, size_t regionSize) {
+		size_t start = MAX(offset, regionOffset);
+		size_t stop = MIN(end, regionOffset + regionSize);
+		if (start < stop && memcmp((const char*)bytes + (start - offset), (const char*)region + (start - regionOffset), stop - start) != 0) {
+			matches = false;
+		}
+		// same as `getBytes:offset:length:`: regions are visited in order, so we can stop once we're past the end of the range
+		return matches && regionOffset + regionSize < end;
+	});
+
+	return matches;
+};
+
 OS_OBJECT_NONLAZY_CLASS
 @implementation XPC_CLASS(data)
 
@@ -76,11 +94,52 @@ XPC_CLASS_HEADER(data);
 	return self;
 }
 
+- (instancetype)initWithBorrowedDispatchData: (dispatch_data_t)data
+{
+	if (self = [self initWithDispatchData: data]) {
+		XPC_THIS_DECL(data);
+		this->borrowed = YES;
+	}
+	return self;
+}
+
+- (instancetype)copy
+{
+	XPC_THIS_DECL(data);
+	if (this->borrowed) {
+		// a long-lived copy shouldn't keep the entire message it came from alive
+		return [[[self class] alloc] initWithBytes: self.bytes length: self.length];
+	}
+	return [super copy];
+}
+
 - (NSUInteger)getBytes: (void*)buffer length: (NSUInteger)length
+{
+	return [self getBytes: buffer offset: 0 length: length];
+}
+
+- (NSUInteger)getBytes: (void*)buffer offset: (NSUInteger)offset length: (NSUInteger)length
 {
 	XPC_THIS_DECL(data);
-	length = MIN(length, self.length);
-	memcpy(buffer, self.bytes, length);
+	NSUInteger totalLength = self.length;
+	NSUInteger end = 0;
+
+	if (offset >= totalLength) {
+		return 0;
+	}
+	length = MIN(length, totalLength - offset);
+	end = offset + length;
+
+	dispatch_data_apply(this->data, ^bool (dispatch_data_t subrange, size_t regionOffset, const void* region, size_t regionSize) {
+		size_t start = MAX(offset, regionOffset);
+		size_t stop = MIN(end, regionOffset + regionSize);
+		if (start < stop) {
+			memcpy((char*)buffer + (start - offset), (const char*)region + (start - regionOffset), stop - start);
+		}
+		// regions are visited in order, so we can stop as soon as we've reached the end of the requested range
+		return regionOffset + regionSize < end;
+	});
+
 	return length;
 }
 
@@ -89,19 +148,57 @@ XPC_CLASS_HEADER(data);
 	XPC_THIS_DECL(data);
 	dispatch_release(this->data);
 	this->data = dispatch_data_create(bytes, length, NULL, DISPATCH_DATA_DESTRUCTOR_DEFAULT);
+	this->borrowed = NO;
+	// same as for strings: if nobody has hashed us yet, no container can have cached our hash either
+	if (atomic_exchange_explicit(&this->cached_hash, 0, memory_order_relaxed) != 0) {
+		xpc_leaf_generation_advance();
+	}
 }
 
 - (NSUInteger)hash
 {
 	XPC_THIS_DECL(data);
-	__block NSUInteger result = 0;
-	dispatch_data_apply(this->data, ^bool (dispatch_data_t region, size_t offset, const void* buffer, size_t size) {
-		result += xpc_raw_data_hash(buffer, size);
-		return true;
-	});
+	size_t result = atomic_load_explicit(&this->cached_hash, memory_order_relaxed);
+	if (result == 0) {
+		// hash region by region (rather than flattening us), but as one stream, so the hash doesn't depend on how we're split up
+		xpc_data_hasher_t hasher;
+		xpc_data_hasher_t* hasherPointer = &hasher;
+		xpc_data_hasher_init(&hasher);
+		dispatch_data_apply(this->data, ^bool (dispatch_data_t subrange, size_t regionOffset, const void* region, size_t regionSize) {
+			xpc_data_hasher_append(hasherPointer, region, regionSize);
+			return true;
+		});
+		result = xpc_data_hasher_finish(&hasher);
+		// global objects may be in read-only memory, so they just recompute it every time
+		if (!XPC_OBJECT_IS_GLOBAL(this)) {
+			atomic_store_explicit(&this->cached_hash, result, memory_order_relaxed);
+		}
+	}
 	return result;
 }
 
+- (BOOL)isEqualToObject: (XPC_CLASS(object)*)object
+{
+	XPC_THIS_DECL(data);
+	struct xpc_data_s* other = (struct xpc_data_s*)XPC_CAST(data, object);
+	__block BOOL equal = YES;
+
+	if (dispatch_data_get_size(this->data) != dispatch_data_get_size(other->data)) {
+		return NO;
+	}
+	if (this->data == other->data) {
+		return YES;
+	}
+
+	// neither of us is flattened: each of our regions is compared against the matching part of the other's regions
+	dispatch_data_apply(this->data, ^bool (dispatch_data_t subrange, size_t regionOffset, const void* region, size_t regionSize) {
+		equal = data_region_matches(other->data, regionOffset, region, regionSize);
+		return equal;
+	});
+
+	return equal;
+}
+
 @end
 
 @implementation XPC_CLASS(data) (XPCSerialization)
@@ -116,17 +213,27 @@ XPC_CLASS_HEADER(data);
 	return xpc_serial_padded_length(sizeof(xpc_serial_type_t)) + xpc_serial_padded_length(sizeof(uint32_t)) + xpc_serial_padded_length(self.length);
 }
 
+- (NSUInteger)serializationLengthWithSerializer: (XPC_CLASS(serializer)*)serializer
+{
+	if (serializer && [serializer shouldWriteOOL: self.length]) {
+		// only the length and descriptor index are written inline
+		return xpc_serial_padded_length(sizeof(xpc_serial_type_t)) + xpc_serial_padded_length(sizeof(uint32_t)) + xpc_serial_padded_length(sizeof(uint32_t));
+	}
+	return self.serializationLength;
+}
+
 + (instancetype)deserialize: (XPC_CLASS(deserializer)*)deserializer
 {
 	XPC_CLASS(data)* result = nil;
 	xpc_serial_type_t type = XPC_SERIAL_TYPE_INVALID;
 	uint32_t length = 0;
 	const void* region = NULL;
+	dispatch_data_t ddata = NULL;
 
 	if (![deserializer readU32: &type]) {
 		goto error_out;
 	}
-	if (type != XPC_SERIAL_TYPE_DATA) {
+	if ((type & ~XPC_SERIAL_TYPE_FLAG_OOL) != XPC_SERIAL_TYPE_DATA) {
 		goto error_out;
 	}
 
@@ -134,12 +241,28 @@ XPC_CLASS_HEADER(data);
 		goto error_out;
 	}
 
-	if (![deserializer consume: length region: &region]) {
-		goto error_out;
+	if (type & XPC_SERIAL_TYPE_FLAG_OOL) {
+		// the content is already mapped into our address space; just wrap it up
+		if (![deserializer readOOL: length data: &ddata region: NULL]) {
+			goto error_out;
+		}
+
+		result = [[[self class] alloc] initWithDispatchData: ddata];
+		dispatch_release(ddata);
+	} else {
+		if (![deserializer consume: length region: &region]) {
+			goto error_out;
+		}
+
+		ddata = [deserializer borrowRegion: region length: length];
+		if (ddata != NULL) {
+			result = [[[self class] alloc] initWithBorrowedDispatchData: ddata];
+			dispatch_release(ddata);
+		} else {
+			result = [[[self class] alloc] initWithBytes: region length: length];
+		}
 	}
 
-	result = [[[self class] alloc] initWithBytes: region length: length];
-
 	return result;
 
 error_out:
@@ -149,12 +272,49 @@ error_out:
 	return nil;
 }
 
++ (BOOL)skip: (XPC_CLASS(deserializer)*)deserializer
+{
+	xpc_serial_type_t type = XPC_SERIAL_TYPE_INVALID;
+	uint32_t length = 0;
+
+	if (![deserializer readU32: &type]) {
+		return NO;
+	}
+	if (type != XPC_SERIAL_TYPE_DATA) {
+		return NO;
+	}
+
+	// OOL data is never skipped (see the note in `XPCSerializationSkipping`), so this only needs to handle inline data
+	if (![deserializer readU32: &length]) {
+		return NO;
+	}
+
+	return [deserializer consume: length region: NULL];
+}
+
 - (BOOL)serialize: (XPC_CLASS(serializer)*)serializer
 {
 	XPC_THIS_DECL(data);
 	uint32_t length = self.length;
 	void* region = NULL;
 
+	if ([serializer shouldWriteOOL: length]) {
+		if (![serializer writeU32: XPC_SERIAL_TYPE_DATA | XPC_SERIAL_TYPE_FLAG_OOL]) {
+			goto error_out;
+		}
+
+		if (![serializer writeU32: length]) {
+			goto error_out;
+		}
+
+		// regions are copied in one by one, so data made up of several regions isn't flattened first
+		if (![serializer writeOOLDispatchData: this->data]) {
+			goto error_out;
+		}
+
+		return YES;
+	}
+
 	if (![serializer writeU32: XPC_SERIAL_TYPE_DATA]) {
 		goto error_out;
 	}
@@ -183,18 +343,18 @@ error_out:
 
 XPC_EXPORT
 xpc_object_t xpc_data_create(const void* bytes, size_t length) {
-	return [[XPC_CLASS(data) alloc] initWithBytes: bytes length: length];
+	return [XPC_OBJECT_ALLOC(data) initWithBytes: bytes length: length];
 };
 
 XPC_EXPORT
 xpc_object_t xpc_data_create_with_dispatch_data(dispatch_data_t ddata) {
-	return [[XPC_CLASS(data) alloc] initWithDispatchData: ddata];
+	return [XPC_OBJECT_ALLOC(data) initWithDispatchData: ddata];
 };
 
 XPC_EXPORT
 size_t xpc_data_get_length(xpc_object_t xdata) {
 	TO_OBJC_CHECKED(data, xdata, data) {
-		return data.length;
+		return dispatch_data_get_size(((struct xpc_data_s*)data)->data);
 	}
 	return 0;
 };
@@ -210,7 +370,7 @@ const void* xpc_data_get_bytes_ptr(xpc_object_t xdata) {
 XPC_EXPORT
 size_t xpc_data_get_bytes(xpc_object_t xdata, void* buffer, size_t offset, size_t length) {
 	TO_OBJC_CHECKED(data, xdata, data) {
-		return [data getBytes: ((char*)buffer + offset) length: length];
+		return [data getBytes: buffer offset: offset length: length];
 	}
 	return 0;
 };
@@ -54,6 +54,7 @@ XPC_CLASS_HEADER(date);
 	XPC_THIS_DECL(date);
 	this->value = value;
 	this->is_absolute = false;
+	xpc_leaf_generation_advance();
 }
 
 - (double)absoluteValue
@@ -71,6 +72,7 @@ XPC_CLASS_HEADER(date);
 	XPC_THIS_DECL(date);
 	this->absolute_value = absoluteValue;
 	this->is_absolute = true;
+	xpc_leaf_generation_advance();
 }
 
 - (instancetype)initWithValue: (int64_t)value
@@ -94,13 +96,19 @@ XPC_CLASS_HEADER(date);
 
 - (NSUInteger)hash
 {
-	XPC_THIS_DECL(date);
-	return xpc_raw_data_hash(&this->value, sizeof(this->value));
+	// absolute dates don't have `value` filled in
+	int64_t value = self.value;
+	return xpc_raw_data_hash(&value, sizeof(value));
+}
+
+- (BOOL)isEqualToObject: (XPC_CLASS(object)*)object
+{
+	return self.value == XPC_CAST(date, object).value;
 }
 
 @end
 
-XPC_WRAPPER_CLASS_SERIAL_IMPL(date, int64_t, DATE, U64, uint64_t);
+XPC_WRAPPER_CLASS_SERIAL_IMPL(date, int64_t, DATE, U64, uint64_t, xpc_date_create);
 
 //
 // C API
@@ -108,7 +116,11 @@ XPC_WRAPPER_CLASS_SERIAL_IMPL(date, int64_t, DATE, U64, uint64_t);
 
 XPC_EXPORT
 xpc_object_t xpc_date_create(int64_t value) {
-	return [[XPC_CLASS(date) alloc] initWithValue: value];
+	XPC_CLASS(date)* date = XPC_OBJECT_ALLOC(date);
+	if (date != nil) {
+		((struct xpc_date_s*)date)->value = value;
+	}
+	return date;
 };
 
 XPC_EXPORT
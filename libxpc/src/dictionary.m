@@ -26,12 +26,464 @@
 #import <xpc/objects/mach_recv.h>
 #import <xpc/objects/array.h>
 #import <xpc/objects/null.h>
+#import <xpc/objects/int64.h>
+#import <xpc/objects/uint64.h>
 #import <xpc/objects/connection.h>
 #import <xpc/serialization.h>
 #import <objc/runtime.h>
 
 XPC_CLASS_SYMBOL_DECL(dictionary);
 
+// SIMD vector of all the inline fingerprints
+typedef uint32_t dictionary_fingerprints_t __attribute__((vector_size(sizeof(uint32_t) * XPC_DICTIONARY_INLINE_CAPACITY)));
+
+// packs a key's length (up to 127) and its first three bytes into 32 bits.
+// the top bit is always set so that no key's fingerprint is 0 (which marks removed entries).
+static uint32_t dictionary_fingerprint(const char* key) {
+	size_t length = strnlen(key, 0x7f);
+	uint32_t fingerprint = 0x80000000 | ((uint32_t)length << 24);
+	for (size_t i = 0; i < 3 && i < length; ++i) {
+		fingerprint |= (uint32_t)(uint8_t)key[i] << (16 - 8 * i);
+	}
+	return fingerprint;
+};
+
+static void dictionary_init_storage(struct xpc_dictionary_s* this) {
+	if (this->omits_inline_storage) {
+		// the first entry we add allocates our entries
+		this->entries = NULL;
+		this->entries_capacity = 0;
+		return;
+	}
+	this->entries = this->inline_entries;
+	this->entries_capacity = XPC_DICTIONARY_INLINE_CAPACITY;
+};
+
+// a key's hash only picks a slot in the index; the low bits are good enough for that with FNV-1a
+XPC_INLINE
+NSUInteger dictionary_index_slot(size_t hash, NSUInteger capacity) {
+	return hash & (capacity - 1);
+};
+
+static void dictionary_index_insert(struct xpc_dictionary_s* this, NSUInteger entryIndex) {
+	NSUInteger slot = dictionary_index_slot(this->entries[entryIndex].hash, this->index_capacity);
+	while (this->index[slot] != 0) {
+		slot = (slot + 1) & (this->index_capacity - 1);
+	}
+	this->index[slot] = (uint32_t)(entryIndex + 1);
+};
+
+// rebuilds the index from scratch (or drops it for small dictionaries).
+// if we can't allocate a new index, we just go without one; lookups fall back to a linear scan, which is slow but still correct.
+static void dictionary_rebuild_index(struct xpc_dictionary_s* this) {
+	NSUInteger capacity = XPC_DICTIONARY_INDEX_THRESHOLD * 2;
+
+	xpc_slab_free(this->index, this->index_capacity * sizeof(*this->index));
+	this->index = NULL;
+	this->index_capacity = 0;
+
+	if (this->entries_used <= XPC_DICTIONARY_INDEX_THRESHOLD || this->entries_capacity >= UINT32_MAX / 2) {
+		return;
+	}
+
+	// keep the index at most half full (counting removed entries that still have slots)
+	while (capacity < this->entries_capacity * 2) {
+		capacity *= 2;
+	}
+
+	this->index = xpc_slab_alloc(capacity * sizeof(*this->index));
+	if (this->index == NULL) {
+		return;
+	}
+	memset(this->index, 0, capacity * sizeof(*this->index));
+	this->index_capacity = capacity;
+
+	for (NSUInteger i = 0; i < this->entries_used; ++i) {
+		if (this->entries[i].name != NULL) {
+			dictionary_index_insert(this, i);
+		}
+	}
+};
+
+static bool dictionary_grow(struct xpc_dictionary_s* this, NSUInteger minimumCapacity) {
+	NSUInteger capacity = (this->entries_capacity > 0) ? this->entries_capacity : 4;
+	struct xpc_dictionary_entry_s* entries = NULL;
+
+	while (capacity < minimumCapacity) {
+		capacity *= 2;
+	}
+
+	if (capacity <= this->entries_capacity) {
+		return true;
+	}
+
+	if (this->entries == this->inline_entries || (this->entries_capacity == 0 && this->entries != NULL)) {
+		// the entries are either inline or statically allocated; either way, they have to move into their own allocation
+		entries = xpc_shared_alloc(capacity * sizeof(*entries));
+		if (entries == NULL) {
+			return false;
+		}
+		memcpy(entries, this->entries, this->entries_used * sizeof(*entries));
+		if (this->entries != this->inline_entries) {
+			// statically allocated entries don't have their hashes filled in
+			for (NSUInteger i = 0; i < this->entries_used; ++i) {
+				if (entries[i].name != NULL) {
+					entries[i].hash = xpc_key_hash(entries[i].name);
+				}
+			}
+		}
+	} else {
+		entries = xpc_shared_realloc(this->entries, this->entries_capacity * sizeof(*entries), capacity * sizeof(*entries));
+		if (entries == NULL) {
+			return false;
+		}
+	}
+
+	this->entries = entries;
+	this->entries_capacity = capacity;
+	return true;
+};
+
+// squeezes out removed entries (preserving the order of the remaining ones)
+static void dictionary_compact(struct xpc_dictionary_s* this) {
+	NSUInteger used = 0;
+
+	for (NSUInteger i = 0; i < this->entries_used; ++i) {
+		if (this->entries[i].name != NULL) {
+			if (used != i) {
+				this->entries[used] = this->entries[i];
+			}
+			++used;
+		}
+	}
+
+	this->entries_used = used;
+	dictionary_rebuild_index(this);
+};
+
+// out-of-line entries (along with the index) are shared by copies of the dictionary (see `copy`),
+// and whoever modifies them first gets its own copy of them (see `dictionary_unshare`).
+// inline entries can't be shared, but there are few enough of them that copying them right away is still cheap.
+//
+// either way, the objects in the entries are shared, including mutable ones (see `xpc_object_is_mutable`).
+// whoever those are handed out to mustn't be able to modify them for both of us, so once we've been copied (or are a copy),
+// we hand out our own copy of each of them instead, made the first time it's asked for (see `dictionary_borrow`).
+// those are copy-on-write as well, so making one only copies a single level. once we're modified, they replace the shared objects for good.
+// note that this means that mutable objects that were handed out before we were copied aren't part of us anymore afterwards.
+
+XPC_INLINE
+bool dictionary_has_shareable_storage(struct xpc_dictionary_s* this) {
+	return this->entries != this->inline_entries && this->entries_capacity > 0;
+};
+
+static void dictionary_release_entries(struct xpc_dictionary_entry_s* entries, NSUInteger count) {
+	for (NSUInteger i = 0; i < count; ++i) {
+		if (entries[i].name == NULL) {
+			continue;
+		}
+		xpc_release_for_collection(entries[i].object);
+		if (entries[i].owns_name) {
+			free((char*)entries[i].name);
+		}
+	}
+};
+
+// drops our reference to our entries and index, destroying them if nobody else is using them
+static void dictionary_release_storage(struct xpc_dictionary_s* this) {
+	if (dictionary_has_shareable_storage(this)) {
+		if (!xpc_shared_release(this->entries)) {
+			// other copies are still using them
+			return;
+		}
+		dictionary_release_entries(this->entries, this->entries_used);
+		xpc_shared_free(this->entries, this->entries_capacity * sizeof(*this->entries));
+	} else if (this->entries == this->inline_entries) {
+		dictionary_release_entries(this->entries, this->entries_used);
+	}
+	xpc_slab_free(this->index, this->index_capacity * sizeof(*this->index));
+};
+
+XPC_INLINE
+XPC_CLASS(object)** dictionary_borrowed_copies(struct xpc_dictionary_s* this) {
+	return atomic_load_explicit((_Atomic(XPC_CLASS(object)**)*)&this->borrowed_copies, memory_order_acquire);
+};
+
+// returns our own copy of the shared object in an entry, or `nil` if we haven't made one
+XPC_INLINE
+XPC_CLASS(object)* dictionary_borrowed_object(struct xpc_dictionary_s* this, xpc_dictionary_entry_t entry) {
+	XPC_CLASS(object)** copies = dictionary_borrowed_copies(this);
+	return (copies != NULL) ? xpc_object_slot_load(&copies[entry - this->entries]) : nil;
+};
+
+// returns our own copy of the given (shared, mutable) object in an entry, making it if this is the first time someone asked for it.
+// the dictionary keeps the copy alive. returns `nil` if we run out of memory.
+static XPC_CLASS(object)* dictionary_borrow(struct xpc_dictionary_s* this, xpc_dictionary_entry_t entry, XPC_CLASS(object)* object) {
+	NSUInteger index = entry - this->entries;
+	XPC_CLASS(object)** copies = NULL;
+	XPC_CLASS(object)* result = nil;
+
+	// readers can be on different threads, so the copies have to be made under a lock
+	os_unfair_lock_lock(&this->lazy_lock);
+
+	copies = this->borrowed_copies;
+	if (copies == NULL) {
+		// entries can only be added by modifying us, which gets rid of the copies
+		copies = calloc(this->entries_used, sizeof(XPC_CLASS(object)*));
+		if (copies != NULL) {
+			this->borrowed_copies_capacity = this->entries_used;
+			atomic_store_explicit((_Atomic(XPC_CLASS(object)**)*)&this->borrowed_copies, copies, memory_order_release);
+		}
+	}
+
+	if (copies != NULL) {
+		if (copies[index] == nil) {
+			xpc_object_slot_publish(&copies[index], [object copy]);
+		}
+		result = copies[index];
+	}
+
+	os_unfair_lock_unlock(&this->lazy_lock);
+
+	return result;
+};
+
+// releases our own copies of shared objects
+static void dictionary_release_borrowed(struct xpc_dictionary_s* this) {
+	if (this->borrowed_copies == NULL) {
+		return;
+	}
+	for (NSUInteger i = 0; i < this->borrowed_copies_capacity; ++i) {
+		[this->borrowed_copies[i] release];
+	}
+	free(this->borrowed_copies);
+	this->borrowed_copies = NULL;
+	this->borrowed_copies_capacity = 0;
+};
+
+// replaces the shared mutable objects in our (already unshared) entries with our own copies of them, copying the ones we don't have a copy of yet.
+// we're being modified, so nobody else can be reading the entries or the copies right now.
+static bool dictionary_take_borrowed(struct xpc_dictionary_s* this) {
+	if (!atomic_load_explicit(&this->borrows_children, memory_order_relaxed)) {
+		return true;
+	}
+
+	// make all the missing copies first, so that running out of memory leaves us as we were
+	for (NSUInteger i = 0; i < this->entries_used; ++i) {
+		xpc_dictionary_entry_t entry = &this->entries[i];
+		if (entry->name == NULL || entry->object == nil || !xpc_object_is_mutable(entry->object)) {
+			// objects that haven't been created yet will be created just for us
+			continue;
+		}
+		if (dictionary_borrow(this, entry, entry->object) == nil) {
+			return false;
+		}
+	}
+
+	if (this->borrowed_copies != NULL) {
+		for (NSUInteger i = 0; i < this->borrowed_copies_capacity; ++i) {
+			if (this->borrowed_copies[i] != nil) {
+				// the entry takes over our reference to the copy
+				xpc_release_for_collection(this->entries[i].object);
+				this->entries[i].object = this->borrowed_copies[i];
+				this->borrowed_copies[i] = nil;
+			}
+		}
+		dictionary_release_borrowed(this);
+	}
+
+	atomic_store_explicit(&this->borrows_children, false, memory_order_relaxed);
+	return true;
+};
+
+// counts one of our entries as created, dropping our deserializer if that was the last one.
+// returns the deserializer to release; the caller must hold `lazy_lock` (or be modifying us).
+static XPC_CLASS(deserializer)* dictionary_lazy_entry_created(struct xpc_dictionary_s* this) {
+	XPC_CLASS(deserializer)* deserializer = nil;
+	if (this->deserializer != nil && this->lazy_entries > 0 && --this->lazy_entries == 0) {
+		deserializer = this->deserializer;
+		this->deserializer = nil;
+	}
+	return deserializer;
+};
+
+// recounts our entries that haven't been created yet, dropping our deserializer if there aren't any. we must be being modified.
+static void dictionary_recount_lazy_entries(struct xpc_dictionary_s* this) {
+	if (this->deserializer == nil) {
+		return;
+	}
+	this->lazy_entries = 0;
+	for (NSUInteger i = 0; i < this->entries_used; ++i) {
+		if (this->entries[i].name != NULL && this->entries[i].object == nil) {
+			++this->lazy_entries;
+		}
+	}
+	if (this->lazy_entries == 0) {
+		[this->deserializer release];
+		this->deserializer = nil;
+	}
+};
+
+// called when an entry's object is replaced or removed while we're being modified.
+// if the entry was never created, it no longer needs our deserializer.
+static void dictionary_lazy_entry_replaced(struct xpc_dictionary_s* this, XPC_CLASS(object)* old) {
+	if (old == nil) {
+		[dictionary_lazy_entry_created(this) release];
+	}
+};
+
+// creates the object for an entry that hasn't been created yet (if someone else hasn't done so in the meantime)
+static XPC_CLASS(object)* dictionary_create_lazy_entry(struct xpc_dictionary_s* this, xpc_dictionary_entry_t entry) {
+	XPC_CLASS(object)* object = nil;
+	XPC_CLASS(deserializer)* dropped = nil;
+
+	os_unfair_lock_lock(&this->lazy_lock);
+
+	object = xpc_object_slot_load(&entry->object);
+	if (object == nil && this->deserializer != nil) {
+		// the object was already validated when we were deserialized, so this can only fail if we run out of memory
+		[this->deserializer readObjectAtOffset: entry->serial_offset into: &entry->object];
+		object = xpc_object_slot_load(&entry->object);
+		if (object != nil) {
+			dropped = dictionary_lazy_entry_created(this);
+		}
+	}
+
+	os_unfair_lock_unlock(&this->lazy_lock);
+
+	// this may free the whole message, so it's done outside the lock
+	[dropped release];
+
+	return object;
+};
+
+// the object an entry currently holds, creating it if it hasn't been created yet.
+// unlike `objectForEntry:`, this never copies a shared object, so it's for looking at the object rather than handing it out.
+static XPC_CLASS(object)* dictionary_entry_object(struct xpc_dictionary_s* this, xpc_dictionary_entry_t entry) {
+	XPC_CLASS(object)* object = dictionary_borrowed_object(this, entry);
+	if (object == nil) {
+		object = xpc_object_slot_load(&entry->object);
+	}
+	if (object == nil) {
+		object = dictionary_create_lazy_entry(this, entry);
+	}
+	return object;
+};
+
+// returns our deserializer (retained), for readers that need the serialized form of entries that haven't been created yet.
+// if we don't have one anymore, all of our entries have been created.
+static XPC_CLASS(deserializer)* dictionary_copy_deserializer(struct xpc_dictionary_s* this) {
+	XPC_CLASS(deserializer)* deserializer = nil;
+	os_unfair_lock_lock(&this->lazy_lock);
+	deserializer = [this->deserializer retain];
+	os_unfair_lock_unlock(&this->lazy_lock);
+	return deserializer;
+};
+
+// makes sure the dictionary can be modified without affecting any of its copies (or whatever it was copied from).
+static bool dictionary_unshare(struct xpc_dictionary_s* this) {
+	if (dictionary_has_shareable_storage(this) && !xpc_shared_is_unique(this->entries)) {
+		struct xpc_dictionary_entry_s* entries = xpc_shared_alloc(this->entries_capacity * sizeof(*entries));
+		uint32_t* index = NULL;
+
+		if (entries == NULL) {
+			return false;
+		}
+
+		if (this->index != NULL) {
+			index = xpc_slab_alloc(this->index_capacity * sizeof(*index));
+			if (index == NULL) {
+				xpc_shared_free(entries, this->entries_capacity * sizeof(*entries));
+				return false;
+			}
+			memcpy(index, this->index, this->index_capacity * sizeof(*index));
+		}
+
+		// entries keep their positions, so the index stays valid
+		memcpy(entries, this->entries, this->entries_used * sizeof(*entries));
+		for (NSUInteger i = 0; i < this->entries_used; ++i) {
+			if (entries[i].name == NULL) {
+				continue;
+			}
+			if (entries[i].owns_name && (entries[i].name = strdup(entries[i].name)) == NULL) {
+				dictionary_release_entries(entries, i);
+				xpc_shared_free(entries, this->entries_capacity * sizeof(*entries));
+				xpc_slab_free(index, this->index_capacity * sizeof(*index));
+				return false;
+			}
+			xpc_retain_for_collection(entries[i].object);
+		}
+
+		dictionary_release_storage(this);
+		this->entries = entries;
+		this->index = index;
+
+		// whoever we shared our entries with may have created some of them for us in the meantime
+		dictionary_recount_lazy_entries(this);
+	}
+
+	return dictionary_take_borrowed(this);
+};
+
+XPC_INLINE
+void dictionary_invalidate_hash(struct xpc_dictionary_s* this) {
+	atomic_store_explicit(&this->leaf_hash_state, XPC_CONTAINER_HASH_INVALID, memory_order_relaxed);
+};
+
+// an entry's contribution to the dictionary's hash
+static NSUInteger dictionary_entry_hash(struct xpc_dictionary_s* this, xpc_dictionary_entry_t entry, XPC_CLASS(object)* object) {
+	// statically allocated entries don't have their hashes filled in
+	size_t keyHash = (this->entries_capacity == 0 && this->entries != this->inline_entries) ? xpc_key_hash(entry->name) : entry->hash;
+	return xpc_hash_combine(keyHash, [object hash]);
+};
+
+// stored keys are usually interned, so lookups with an interned key (or with the very key that was stored) match by pointer
+// and we only fall back to comparing strings when the pointers differ
+
+static xpc_dictionary_entry_t dictionary_find_inline(struct xpc_dictionary_s* this, const char* key, uint32_t fingerprint) {
+	// compare all the fingerprints at once; only entries with a matching fingerprint need their keys compared
+	dictionary_fingerprints_t fingerprints;
+	memcpy(&fingerprints, this->fingerprints, sizeof(fingerprints));
+	dictionary_fingerprints_t matches = (dictionary_fingerprints_t)(fingerprints == fingerprint);
+	for (NSUInteger i = 0; i < this->entries_used; ++i) {
+		xpc_dictionary_entry_t entry = &this->entries[i];
+		if (matches[i] != 0 && (entry->name == key || strcmp(entry->name, key) == 0)) {
+			return entry;
+		}
+	}
+	return NULL;
+};
+
+static xpc_dictionary_entry_t dictionary_find_linear(struct xpc_dictionary_s* this, const char* key) {
+	for (NSUInteger i = 0; i < this->entries_used; ++i) {
+		xpc_dictionary_entry_t entry = &this->entries[i];
+		if (entry->name != NULL && (entry->name == key || strcmp(entry->name, key) == 0)) {
+			return entry;
+		}
+	}
+	return NULL;
+};
+
+static xpc_dictionary_entry_t dictionary_find_indexed(struct xpc_dictionary_s* this, const char* key, size_t hash) {
+	for (NSUInteger slot = dictionary_index_slot(hash, this->index_capacity); this->index[slot] != 0; slot = (slot + 1) & (this->index_capacity - 1)) {
+		xpc_dictionary_entry_t entry = &this->entries[this->index[slot] - 1];
+		if (entry->name != NULL && entry->hash == hash && (entry->name == key || strcmp(entry->name, key) == 0)) {
+			return entry;
+		}
+	}
+	return NULL;
+};
+
+static xpc_dictionary_entry_t dictionary_find(struct xpc_dictionary_s* this, const char* key) {
+	// only compute what the current layout actually needs
+	if (this->entries == this->inline_entries) {
+		return dictionary_find_inline(this, key, dictionary_fingerprint(key));
+	}
+	if (this->index == NULL) {
+		return dictionary_find_linear(this, key);
+	}
+	return dictionary_find_indexed(this, key, xpc_key_hash(key));
+};
+
 OS_OBJECT_NONLAZY_CLASS
 @implementation XPC_CLASS(dictionary)
 
@@ -41,58 +493,54 @@ XPC_CLASS_HEADER(dictionary);
 {
 	XPC_THIS_DECL(dictionary);
 	self.associatedConnection = nil;
-	while (!LIST_EMPTY(&this->head)) {
-		xpc_dictionary_entry_t entry = LIST_FIRST(&this->head);
-		[self removeEntry: entry];
-		xpc_release_for_collection(entry->object);
-		free(entry);
-	}
+	dictionary_release_borrowed(this);
+	dictionary_release_storage(this);
+	[this->deserializer release];
 	[super dealloc];
 }
 
 - (char*)xpcDescription
 {
-	char* output = NULL;
+	return xpc_description_copy(self, NULL);
+}
+
+- (void)describeTo: (xpc_description_writer_t*)writer
+{
+	XPC_THIS_DECL(dictionary);
 	size_t count = self.count;
+	size_t shown = 0;
+	size_t described = 0;
+
+	xpc_description_printf(writer, "<%s: %p> {", xpc_class_name(self), self);
 
 	if (count == 0) {
-		asprintf(&output, "<%s: %p> {}", xpc_class_name(self), self);
-		return output;
+		xpc_description_write(writer, "}", 1);
+		return;
 	}
 
-	char** descriptions = malloc(sizeof(char*) * count);
-
-	size_t outputLength = 0;
-	outputLength += snprintf(NULL, 0, "<%s: %p> {\n", xpc_class_name(self), self);
-
-	XPC_THIS_DECL(dictionary);
-	xpc_dictionary_entry_t current = LIST_FIRST(&this->head);
-	for (size_t i = 0; i < count; ++i) {
-		char* description = current->object.xpcDescription;
-		descriptions[i] = xpc_description_indent(description, false);
-		free(description);
-		outputLength += snprintf(NULL, 0, "\t%s: %s\n", current->name, descriptions[i]);
-		current = LIST_NEXT(current, link);
+	if (!xpc_description_writer_enter(writer)) {
+		xpc_description_printf(writer, " %zu entr%s }", count, count == 1 ? "y" : "ies");
+		return;
 	}
 
-	outputLength += snprintf(NULL, 0, "}");
-
-	output = malloc(outputLength + 1);
-
-	size_t offset = 0;
-	offset += snprintf(output + offset, outputLength + 1 - offset, "<%s: %p> {\n", xpc_class_name(self), self);
-
-	current = LIST_FIRST(&this->head);
-	for (size_t i = 0; i < count; ++i) {
-		offset += snprintf(output + offset, outputLength + 1 - offset, "\t%s: %s\n", current->name, descriptions[i]);
-		free(descriptions[i]);
-		current = LIST_NEXT(current, link);
+	xpc_description_write(writer, "\n", 1);
+	shown = xpc_description_writer_element_limit(writer, count);
+	for (NSUInteger i = 0; i < this->entries_used && described < shown && !xpc_description_writer_is_done(writer); ++i) {
+		xpc_dictionary_entry_t current = &this->entries[i];
+		if (current->name == NULL) {
+			continue;
+		}
+		xpc_description_printf(writer, "%s: ", current->name);
+		xpc_description_write_object(writer, dictionary_entry_object(this, current));
+		xpc_description_write(writer, "\n", 1);
+		++described;
+	}
+	if (shown < count) {
+		xpc_description_printf(writer, "... %zu more\n", count - shown);
 	}
-	free(descriptions);
-
-	offset += snprintf(output + offset, outputLength + 1 - offset, "}");
 
-	return output;
+	xpc_description_writer_leave(writer);
+	xpc_description_write(writer, "}", 1);
 }
 
 - (mach_port_t)incomingPort
@@ -133,7 +581,7 @@ XPC_CLASS_HEADER(dictionary);
 {
 	if (self = [super init]) {
 		XPC_THIS_DECL(dictionary);
-		LIST_INIT(&this->head);
+		dictionary_init_storage(this);
 		memset(&this->associated_audit_token, 0xff, sizeof(audit_token_t));
 	}
 	return self;
@@ -143,7 +591,11 @@ XPC_CLASS_HEADER(dictionary);
 {
 	if (self = [super init]) {
 		XPC_THIS_DECL(dictionary);
-		LIST_INIT(&this->head);
+
+		dictionary_init_storage(this);
+		if (count > 0) {
+			dictionary_grow(this, count);
+		}
 
 		for (NSUInteger i = 0; i < count; ++i) {
 			[self setObject: objects[i] forKey: keys[i]];
@@ -152,32 +604,171 @@ XPC_CLASS_HEADER(dictionary);
 	return self;
 }
 
+- (instancetype)initWithCapacity: (NSUInteger)capacity
+{
+	if (self = [self init]) {
+		XPC_THIS_DECL(dictionary);
+
+		if (capacity > 0) {
+			// this is only a hint, so failing to reserve space isn't fatal
+			dictionary_grow(this, capacity);
+		}
+	}
+	return self;
+}
+
 - (xpc_dictionary_entry_t)entryForKey: (const char*)key
+{
+	return dictionary_find(XPC_THIS(dictionary), key);
+}
+
+- (xpc_dictionary_entry_t)entryForKeyHandle: (xpc_key_t)key
 {
 	XPC_THIS_DECL(dictionary);
+
+	if (this->entries == this->inline_entries) {
+		return dictionary_find_inline(this, key->name, key->fingerprint);
+	}
+	if (this->index == NULL) {
+		return dictionary_find_linear(this, key->name);
+	}
+	return dictionary_find_indexed(this, key->name, key->hash);
+}
+
+- (xpc_dictionary_entry_t)addEntryForKey: (const char*)key
+{
+	struct xpc_key_s handle;
 	xpc_dictionary_entry_t entry = NULL;
+	char* copy = NULL;
 
-	LIST_FOREACH(entry, &this->head, link) {
-		if (strcmp(entry->name, key) == 0) {
-			return entry;
+	handle.hash = xpc_key_hash(key);
+	handle.name = xpc_key_intern(key, handle.hash);
+	handle.fingerprint = dictionary_fingerprint(key);
+
+	if (handle.name == NULL) {
+		handle.name = copy = strdup(key);
+		if (copy == NULL) {
+			return NULL;
 		}
 	}
 
-	return NULL;
+	entry = [self addEntryForKeyHandle: &handle];
+	if (entry == NULL) {
+		free(copy);
+		return NULL;
+	}
+
+	// the entry takes ownership of our copy
+	entry->owns_name = copy != NULL;
+
+	return entry;
 }
 
-- (void)addEntry: (xpc_dictionary_entry_t)entry
+- (xpc_dictionary_entry_t)addEntryForKeyHandle: (xpc_key_t)key
 {
 	XPC_THIS_DECL(dictionary);
-	LIST_INSERT_HEAD(&this->head, entry, link);
+	xpc_dictionary_entry_t entry = NULL;
+
+	if (this->entries_used == this->entries_capacity && !dictionary_grow(this, this->entries_used + 1)) {
+		return NULL;
+	}
+
+	entry = &this->entries[this->entries_used];
+	entry->object = nil;
+	entry->serial_offset = 0;
+	entry->serial_length = 0;
+	entry->name = key->name;
+	entry->hash = key->hash;
+	entry->owns_name = false;
+
+	if (this->entries == this->inline_entries) {
+		this->fingerprints[this->entries_used] = key->fingerprint;
+	}
+
+	++this->entries_used;
+	dictionary_invalidate_hash(this);
 	++this->size;
+
+	if (this->index != NULL && this->index_capacity >= this->entries_used * 2) {
+		dictionary_index_insert(this, this->entries_used - 1);
+	} else if (this->entries_used > XPC_DICTIONARY_INDEX_THRESHOLD) {
+		dictionary_rebuild_index(this);
+	}
+
+	return entry;
 }
 
 - (void)removeEntry: (xpc_dictionary_entry_t)entry
 {
 	XPC_THIS_DECL(dictionary);
-	LIST_REMOVE(entry, link);
+
+	dictionary_lazy_entry_replaced(this, entry->object);
+	xpc_release_for_collection(entry->object);
+	entry->object = nil;
+	if (entry->owns_name) {
+		free((char*)entry->name);
+	}
+	// the entry stays where it is (and stays in the index) until we compact; lookups just skip it
+	entry->name = NULL;
+	dictionary_invalidate_hash(this);
+	entry->owns_name = false;
+	if (this->entries == this->inline_entries) {
+		this->fingerprints[entry - this->entries] = 0;
+	}
 	--this->size;
+
+	if (this->size == 0) {
+		this->entries_used = 0;
+		dictionary_rebuild_index(this);
+	} else if (this->entries_used - this->size > this->size && this->entries_used > XPC_DICTIONARY_INDEX_THRESHOLD) {
+		dictionary_compact(this);
+	}
+}
+
+- (XPC_CLASS(object)*)objectForEntry: (xpc_dictionary_entry_t)entry
+{
+	XPC_THIS_DECL(dictionary);
+	XPC_CLASS(object)* object = dictionary_borrowed_object(this, entry);
+	if (object != nil) {
+		// already ours
+		return object;
+	}
+	object = dictionary_entry_object(this, entry);
+	if (atomic_load_explicit(&this->borrows_children, memory_order_acquire) && xpc_object_is_mutable(object)) {
+		return dictionary_borrow(this, entry, object);
+	}
+	return object;
+}
+
+- (void)setSkippedObjectAtOffset: (NSUInteger)offset length: (NSUInteger)length forKey: (const char*)key deserializer: (XPC_CLASS(deserializer)*)deserializer
+{
+	XPC_THIS_DECL(dictionary);
+	xpc_dictionary_entry_t entry = [self entryForKey: key];
+
+	if (entry != NULL) {
+		if (entry->object != nil) {
+			xpc_release_for_collection(entry->object);
+			entry->object = nil;
+			++this->lazy_entries;
+		}
+		dictionary_invalidate_hash(this);
+	} else {
+		entry = [self addEntryForKey: key];
+
+		if (entry == NULL) {
+			// no way to report errors
+			return;
+		}
+
+		++this->lazy_entries;
+	}
+
+	entry->serial_offset = offset;
+	entry->serial_length = length;
+
+	if (this->deserializer == nil) {
+		this->deserializer = [deserializer retain];
+	}
 }
 
 - (NSUInteger)count
@@ -204,7 +795,7 @@ XPC_CLASS_HEADER(dictionary);
 	if (entry == NULL) {
 		return nil;
 	}
-	return entry->object;
+	return [self objectForEntry: entry];
 }
 
 - (void)setObject: (XPC_CLASS(object)*)object forKey: (const char*)key
@@ -213,17 +804,23 @@ XPC_CLASS_HEADER(dictionary);
 		return [self removeObjectForKey: key];
 	}
 
+	if (!dictionary_unshare(XPC_THIS(dictionary))) {
+		// no way to report errors
+		return;
+	}
+
 	xpc_dictionary_entry_t entry = [self entryForKey: key];
 
 	if (entry != NULL) {
 		XPC_CLASS(object)* old = entry->object;
 		entry->object = xpc_retain_for_collection(object);
-		[old release];
+		dictionary_lazy_entry_replaced(XPC_THIS(dictionary), old);
+		xpc_release_for_collection(old);
+		dictionary_invalidate_hash(XPC_THIS(dictionary));
 		return;
 	}
 
-	size_t keyLength = strlen(key);
-	entry = malloc(sizeof(struct xpc_dictionary_entry_s) + keyLength + 1);
+	entry = [self addEntryForKey: key];
 
 	if (entry == NULL) {
 		// no way to report errors
@@ -231,31 +828,83 @@ XPC_CLASS_HEADER(dictionary);
 	}
 
 	entry->object = xpc_retain_for_collection(object);
-	strlcpy(entry->name, key, keyLength + 1);
-	[self addEntry: entry];
 }
 
 - (void)removeObjectForKey: (const char*)key
 {
-	xpc_dictionary_entry_t entry = [self entryForKey: key];
+	xpc_dictionary_entry_t entry = NULL;
+
+	if (!dictionary_unshare(XPC_THIS(dictionary))) {
+		return;
+	}
+
+	entry = [self entryForKey: key];
 
 	if (entry == NULL) {
 		return;
 	}
 
 	[self removeEntry: entry];
+}
+
+- (XPC_CLASS(object)*)objectForKeyHandle: (xpc_key_t)key
+{
+	xpc_dictionary_entry_t entry = [self entryForKeyHandle: key];
+	if (entry == NULL) {
+		return nil;
+	}
+	return [self objectForEntry: entry];
+}
+
+- (void)setObject: (XPC_CLASS(object)*)object forKeyHandle: (xpc_key_t)key
+{
+	xpc_dictionary_entry_t entry = NULL;
+
+	if (!dictionary_unshare(XPC_THIS(dictionary))) {
+		// no way to report errors
+		return;
+	}
+
+	entry = [self entryForKeyHandle: key];
 
-	free(entry);
+	if (object == nil) {
+		if (entry != NULL) {
+			[self removeEntry: entry];
+		}
+		return;
+	}
+
+	if (entry != NULL) {
+		XPC_CLASS(object)* old = entry->object;
+		entry->object = xpc_retain_for_collection(object);
+		dictionary_lazy_entry_replaced(XPC_THIS(dictionary), old);
+		xpc_release_for_collection(old);
+		dictionary_invalidate_hash(XPC_THIS(dictionary));
+		return;
+	}
+
+	entry = [self addEntryForKeyHandle: key];
+
+	if (entry == NULL) {
+		// no way to report errors
+		return;
+	}
+
+	entry->object = xpc_retain_for_collection(object);
 }
 
 - (void)enumerateKeysAndObjectsUsingBlock: (void (^)(const char* key, XPC_CLASS(object)* obj, BOOL* stop))block
 {
 	XPC_THIS_DECL(dictionary);
-	xpc_dictionary_entry_t entry = NULL;
 
-	LIST_FOREACH(entry, &this->head, link) {
+	// entries are looked up by index on every iteration since the block is allowed to add to the dictionary
+	for (NSUInteger i = 0; i < this->entries_used; ++i) {
+		xpc_dictionary_entry_t entry = &this->entries[i];
 		BOOL stop = NO;
-		block(entry->name, entry->object, &stop);
+		if (entry->name == NULL) {
+			continue;
+		}
+		block(entry->name, [self objectForEntry: entry], &stop);
 		if (stop) {
 			return;
 		}
@@ -274,29 +923,162 @@ XPC_CLASS_HEADER(dictionary);
 - (NSUInteger)hash
 {
 	XPC_THIS_DECL(dictionary);
+	unsigned char state = atomic_load_explicit(&this->leaf_hash_state, memory_order_acquire);
+	// read before anything is hashed, so that modifications made while we're hashing also invalidate what we cache
+	size_t generation = xpc_leaf_generation();
 	NSUInteger result = 0;
-	xpc_dictionary_entry_t entry = NULL;
 
-	LIST_FOREACH(entry, &this->head, link) {
-		result += [entry->object hash];
+	if (state != XPC_CONTAINER_HASH_INVALID && this->leaf_hash_generation != generation) {
+		state = XPC_CONTAINER_HASH_INVALID;
+	}
+
+	if (state == XPC_CONTAINER_HASH_INVALID) {
+		state = XPC_CONTAINER_HASH_COMPLETE;
+		for (NSUInteger i = 0; i < this->entries_used; ++i) {
+			xpc_dictionary_entry_t entry = &this->entries[i];
+			XPC_CLASS(object)* object = nil;
+			if (entry->name == NULL) {
+				continue;
+			}
+			object = dictionary_entry_object(this, entry);
+			if (xpc_object_is_mutable(object)) {
+				state = XPC_CONTAINER_HASH_PARTIAL;
+				continue;
+			}
+			// entries are summed up, so the order doesn't matter
+			result += dictionary_entry_hash(this, entry, object);
+		}
+		// global objects (like the `XPC_ERROR_*` dictionaries) may be in read-only memory, so they just recompute it every time
+		if (!XPC_OBJECT_IS_GLOBAL(this)) {
+			this->leaf_hash = result;
+			this->leaf_hash_generation = generation;
+			atomic_store_explicit(&this->leaf_hash_state, state, memory_order_release);
+		}
+	} else {
+		result = this->leaf_hash;
+	}
+
+	if (state == XPC_CONTAINER_HASH_PARTIAL) {
+		// nested containers cache their own hashes, so this only has to visit each of them rather than everything they contain
+		for (NSUInteger i = 0; i < this->entries_used; ++i) {
+			xpc_dictionary_entry_t entry = &this->entries[i];
+			XPC_CLASS(object)* object = nil;
+			if (entry->name == NULL) {
+				continue;
+			}
+			object = dictionary_entry_object(this, entry);
+			if (xpc_object_is_mutable(object)) {
+				result += dictionary_entry_hash(this, entry, object);
+			}
+		}
 	}
 
 	return result;
 }
 
+- (BOOL)isEqualToObject: (XPC_CLASS(object)*)object
+{
+	XPC_THIS_DECL(dictionary);
+	XPC_CLASS(dictionary)* other = XPC_CAST(dictionary, object);
+
+	if (this->size != other.count) {
+		return NO;
+	}
+
+	for (NSUInteger i = 0; i < this->entries_used; ++i) {
+		xpc_dictionary_entry_t entry = &this->entries[i];
+		xpc_dictionary_entry_t otherEntry = NULL;
+		if (entry->name == NULL) {
+			continue;
+		}
+		otherEntry = [other entryForKey: entry->name];
+		if (otherEntry == NULL || ![dictionary_entry_object(this, entry) isEqual: dictionary_entry_object((struct xpc_dictionary_s*)other, otherEntry)]) {
+			return NO;
+		}
+	}
+
+	return YES;
+}
+
 - (instancetype)copy
 {
 	XPC_THIS_DECL(dictionary);
+	XPC_CLASS(dictionary)* result = nil;
+	struct xpc_dictionary_s* copy = NULL;
+	bool sharesMutableObjects = false;
+	// taken before looking at our entries: once we've dropped it, every entry we have has been created
+	XPC_CLASS(deserializer)* deserializer = dictionary_copy_deserializer(this);
+	NSUInteger lazyEntries = 0;
+
+	if (dictionary_has_shareable_storage(this) && dictionary_borrowed_copies(this) == NULL) {
+		// nothing is actually copied until one of us is modified, not even our mutable objects (see `dictionary_borrow`)
+		result = [xpc_dictionary_alloc_with_capacity(this->entries_capacity) init];
+		copy = (struct xpc_dictionary_s*)result;
+		copy->size = this->size;
+		copy->entries = xpc_shared_retain(this->entries);
+		copy->entries_used = this->entries_used;
+		copy->entries_capacity = this->entries_capacity;
+		copy->index = this->index;
+		copy->index_capacity = this->index_capacity;
+		sharesMutableObjects = true;
+		if (deserializer != nil) {
+			for (NSUInteger i = 0; i < this->entries_used; ++i) {
+				if (this->entries[i].name != NULL && xpc_object_slot_load(&this->entries[i].object) == nil) {
+					++lazyEntries;
+				}
+			}
+		}
+	} else {
+		// our entries have to be copied right away (they're either inline or include our own copies of shared objects),
+		// but their objects can still be shared. entries that haven't been created yet get their own slots, so each of us creates its own object for them.
+		result = [xpc_dictionary_alloc_with_capacity(this->size) initWithCapacity: this->size];
+		copy = (struct xpc_dictionary_s*)result;
+		for (NSUInteger i = 0; i < this->entries_used; ++i) {
+			xpc_dictionary_entry_t entry = &this->entries[i];
+			xpc_dictionary_entry_t copiedEntry = NULL;
+			if (entry->name == NULL) {
+				continue;
+			}
+			copiedEntry = [result addEntryForKey: entry->name];
+			if (copiedEntry == NULL) {
+				continue;
+			}
+			XPC_CLASS(object)* object = dictionary_borrowed_object(this, entry);
+			if (object == nil) {
+				object = xpc_object_slot_load(&entry->object);
+			}
+			if (object == nil) {
+				++lazyEntries;
+			} else if (xpc_object_is_mutable(object)) {
+				sharesMutableObjects = true;
+			}
+			copiedEntry->object = xpc_retain_for_collection(object);
+			copiedEntry->serial_offset = entry->serial_offset;
+			copiedEntry->serial_length = entry->serial_length;
+		}
+	}
 
-	XPC_CLASS(dictionary)* result = [XPC_CLASS(dictionary) new];
-	xpc_dictionary_entry_t entry = NULL;
+	// entries that haven't been created yet are created from the same message; if there aren't any, the copy doesn't need it
+	if (lazyEntries > 0) {
+		copy->deserializer = deserializer;
+		copy->lazy_entries = lazyEntries;
+	} else {
+		[deserializer release];
+	}
 
-	LIST_FOREACH(entry, &this->head, link) {
-		XPC_CLASS(object)* copied = [entry->object copy];
-		[result setObject: copied forKey: entry->name];
-		[copied release];
+	if (sharesMutableObjects) {
+		atomic_store_explicit(&copy->borrows_children, true, memory_order_relaxed);
+		// global objects (like the `XPC_ERROR_*` dictionaries) may be in read-only memory, but they never have mutable objects anyway
+		if (!XPC_OBJECT_IS_GLOBAL(this)) {
+			atomic_store_explicit(&this->borrows_children, true, memory_order_release);
+		}
 	}
 
+	// we have the same contents, so we have the same hash
+	atomic_store_explicit(&copy->leaf_hash_state, atomic_load_explicit(&this->leaf_hash_state, memory_order_acquire), memory_order_relaxed);
+	copy->leaf_hash = this->leaf_hash;
+	copy->leaf_hash_generation = this->leaf_hash_generation;
+
 	return result;
 }
 
@@ -332,6 +1114,11 @@ XPC_CLASS_HEADER(dictionary);
 }
 
 - (NSUInteger)serializationLength
+{
+	return [self serializationLengthWithSerializer: nil];
+}
+
+- (NSUInteger)serializationLengthWithSerializer: (XPC_CLASS(serializer)*)serializer
 {
 	XPC_THIS_DECL(dictionary);
 	NSUInteger total = 0;
@@ -341,70 +1128,50 @@ XPC_CLASS_HEADER(dictionary);
 	total += xpc_serial_padded_length(sizeof(uint32_t));
 	total += xpc_serial_padded_length(sizeof(uint32_t));
 
-	LIST_FOREACH(entry, &this->head, link) {
-		XPC_CLASS(object)* object = entry->object;
-		if (!object.serializable) {
-			object = [XPC_CLASS(null) null];
+	for (NSUInteger i = 0; i < this->entries_used; ++i) {
+		entry = &this->entries[i];
+		if (entry->name == NULL) {
+			continue;
+		}
+		XPC_CLASS(object)* object = dictionary_borrowed_object(this, entry);
+		if (object == nil) {
+			object = xpc_object_slot_load(&entry->object);
 		}
 		total += xpc_serial_padded_length(strlen(entry->name) + 1);
-		total += object.serializationLength;
+		if (object == nil) {
+			// not created yet; it'll just be copied as-is
+			total += entry->serial_length;
+			continue;
+		}
+		if (!xpc_serial_object_is_serializable(object)) {
+			object = [XPC_CLASS(null) null];
+		}
+		total += serializer ? [serializer lengthOfObject: object] : object.serializationLength;
 	}
 
+	[serializer cacheLength: total forObject: self];
+
 	return total;
 }
 
 + (instancetype)deserialize: (XPC_CLASS(deserializer)*)deserializer
 {
-	XPC_CLASS(dictionary)* result = nil;
+	XPC_CLASS(object)* result = nil;
 	xpc_serial_type_t type = XPC_SERIAL_TYPE_INVALID;
-	uint32_t contentLength = 0;
-	uint32_t entryCount = 0;
-	NSUInteger contentStartOffset = 0;
 
-	if (![deserializer readU32: &type]) {
-		goto error_out;
+	if (![deserializer peekU32: &type]) {
+		return nil;
 	}
 	if (type != XPC_SERIAL_TYPE_DICT) {
-		goto error_out;
-	}
-
-	if (![deserializer readU32: &contentLength]) {
-		goto error_out;
-	}
-
-	// the element/entry count is included in the content length
-	contentStartOffset = deserializer.offset;
-
-	if (![deserializer readU32: &entryCount]) {
-		goto error_out;
-	}
-
-	result = [[[self class] alloc] initWithObjects: NULL forKeys: NULL count: 0];
-
-	for (uint32_t i = 0; i < entryCount; ++i) {
-		const char* key = NULL;
-		XPC_CLASS(object)* object = nil;
-		if (![deserializer readString: &key]) {
-			goto error_out;
-		}
-		if (![deserializer readObject: &object]) {
-			goto error_out;
-		}
-		[result setObject: object forKey: key];
-		[object release];
+		return nil;
 	}
 
-	if (deserializer.offset - contentStartOffset != contentLength) {
-		goto error_out;
+	// containers are decoded iteratively by the deserializer itself, so that nesting doesn't recurse
+	if (![deserializer readObject: &result]) {
+		return nil;
 	}
 
-	return result;
-
-error_out:
-	if (result != nil) {
-		[result release];
-	}
-	return nil;
+	return (XPC_CLASS(dictionary)*)result;
 }
 
 - (BOOL)serialize: (XPC_CLASS(serializer)*)serializer
@@ -413,6 +1180,8 @@ error_out:
 	void* reservedForContentLength = NULL;
 	NSUInteger contentStartOffset = 0;
 	xpc_dictionary_entry_t entry = NULL;
+	// taken before looking at our entries, so it's there for any entry we find that hasn't been created yet
+	XPC_CLASS(deserializer)* deserializer = dictionary_copy_deserializer(this);
 
 	if (![serializer writeU32: XPC_SERIAL_TYPE_DICT]) {
 		goto error_out;
@@ -429,12 +1198,26 @@ error_out:
 		goto error_out;
 	}
 
-	LIST_FOREACH(entry, &this->head, link) {
+	for (NSUInteger i = 0; i < this->entries_used; ++i) {
+		entry = &this->entries[i];
+		if (entry->name == NULL) {
+			continue;
+		}
 		if (![serializer writeString: entry->name]) {
 			goto error_out;
 		}
-		XPC_CLASS(object)* object = entry->object;
-		if (!object.serializable) {
+		XPC_CLASS(object)* object = dictionary_borrowed_object(this, entry);
+		if (object == nil) {
+			object = xpc_object_slot_load(&entry->object);
+		}
+		if (object == nil) {
+			// never created, so its serialized form is still exactly what we received; just copy it over
+			if (![serializer write: [deserializer contentAtOffset: entry->serial_offset] length: entry->serial_length]) {
+				goto error_out;
+			}
+			continue;
+		}
+		if (!xpc_serial_object_is_serializable(object)) {
 			object = [XPC_CLASS(null) null];
 		}
 		if (![serializer writeObject: object]) {
@@ -444,21 +1227,37 @@ error_out:
 
 	OSWriteLittleInt32(reservedForContentLength, 0, serializer.offset - contentStartOffset);
 
+	[deserializer release];
 	return YES;
 
 error_out:
+	[deserializer release];
 	return NO;
 }
 
 @end
 
+XPC_CLASS(dictionary)* xpc_dictionary_alloc_with_capacity(NSUInteger capacity) {
+	XPC_CLASS(dictionary)* result = nil;
+
+	if (capacity <= XPC_DICTIONARY_INLINE_CAPACITY) {
+		return XPC_OBJECT_ALLOC(dictionary);
+	}
+
+	result = (XPC_CLASS(dictionary)*)_os_object_alloc_realized(XPC_OBJC_CLASS(dictionary), offsetof(struct xpc_dictionary_s, fingerprints));
+	if (result != nil) {
+		((struct xpc_dictionary_s*)result)->omits_inline_storage = true;
+	}
+	return result;
+};
+
 //
 // C API
 //
 
 XPC_EXPORT
 xpc_object_t xpc_dictionary_create(const char* const* keys, const xpc_object_t* values, size_t count) {
-	return [[XPC_CLASS(dictionary) alloc] initWithObjects: (XPC_CLASS(object)* const*)values forKeys: keys count: count];
+	return [xpc_dictionary_alloc_with_capacity(count) initWithObjects: (XPC_CLASS(object)* const*)values forKeys: keys count: count];
 };
 
 XPC_EXPORT
@@ -490,7 +1289,17 @@ void xpc_dictionary_set_value(xpc_object_t xdict, const char* key, xpc_object_t
 XPC_EXPORT
 xpc_object_t xpc_dictionary_get_value(xpc_object_t xdict, const char* key) {
 	TO_OBJC_CHECKED(dictionary, xdict, dict) {
-		return [dict objectForKey: key];
+		struct xpc_dictionary_s* this = (struct xpc_dictionary_s*)dict;
+		xpc_dictionary_entry_t entry = dictionary_find(this, key);
+		if (entry == NULL) {
+			return NULL;
+		}
+		// the common case (an object that's already been created and isn't shared with a copy) doesn't need any messages
+		XPC_CLASS(object)* object = xpc_object_slot_load(&entry->object);
+		if (object != nil && !atomic_load_explicit(&this->borrows_children, memory_order_acquire)) {
+			return object;
+		}
+		return [dict objectForEntry: entry];
 	}
 	return NULL;
 };
@@ -498,7 +1307,7 @@ xpc_object_t xpc_dictionary_get_value(xpc_object_t xdict, const char* key) {
 XPC_EXPORT
 size_t xpc_dictionary_get_count(xpc_object_t xdict) {
 	TO_OBJC_CHECKED(dictionary, xdict, dict) {
-		return dict.count;
+		return ((struct xpc_dictionary_s*)dict)->size;
 	}
 	return 0;
 };
@@ -610,23 +1419,81 @@ void xpc_dictionary_send_reply(xpc_object_t xdict) {
 
 };
 
+//
+// key handles
+//
+
+XPC_EXPORT
+xpc_key_t xpc_dictionary_key_create(const char* string) {
+	struct xpc_key_s* key = malloc(sizeof(struct xpc_key_s));
+
+	if (key == NULL) {
+		return NULL;
+	}
+
+	key->hash = xpc_key_hash(string);
+	key->fingerprint = dictionary_fingerprint(string);
+	key->name = xpc_key_intern(string, key->hash);
+
+	if (key->name == NULL) {
+		// can't be interned, so it'll be compared by content; it still saves the hashing, though
+		key->name = strdup(string);
+		if (key->name == NULL) {
+			free(key);
+			return NULL;
+		}
+	}
+
+	return key;
+};
+
+XPC_EXPORT
+const char* xpc_dictionary_key_get_string(xpc_key_t key) {
+	return key->name;
+};
+
+XPC_EXPORT
+xpc_object_t xpc_dictionary_get_value_k(xpc_object_t xdict, xpc_key_t key) {
+	if (key == NULL) {
+		return NULL;
+	}
+	TO_OBJC_CHECKED(dictionary, xdict, dict) {
+		return [dict objectForKeyHandle: key];
+	}
+	return NULL;
+};
+
+XPC_EXPORT
+void xpc_dictionary_set_value_k(xpc_object_t xdict, xpc_key_t key, xpc_object_t value) {
+	if (key == NULL) {
+		return;
+	}
+	TO_OBJC_CHECKED(dictionary, xdict, dict) {
+		[dict setObject: XPC_CAST(object, value) forKeyHandle: key];
+	}
+};
+
 //
 // setters
 //
 
-#define SIMPLE_SETTER(name, type) \
+#define CREATING_SETTER(name, type, create) \
 	XPC_EXPORT \
 	void xpc_dictionary_set_ ## name(xpc_object_t xdict, const char* key, type value) { \
 		TO_OBJC_CHECKED(dictionary, xdict, dict) { \
-			xpc_object_t object = xpc_ ## name ## _create(value); \
+			xpc_object_t object = create(value); \
 			xpc_dictionary_set_value(xdict, key, object); \
 			xpc_release(object); \
 		} \
 	};
 
+#define SIMPLE_SETTER(name, type) CREATING_SETTER(name, type, xpc_ ## name ## _create)
+
+// callers don't create these objects themselves, so small integers can use the global ones (see `xpc_int64_create_shared`)
+CREATING_SETTER(int64, int64_t, xpc_int64_create_shared);
+CREATING_SETTER(uint64, uint64_t, xpc_uint64_create_shared);
+
 SIMPLE_SETTER(bool, bool);
-SIMPLE_SETTER(int64, int64_t);
-SIMPLE_SETTER(uint64, uint64_t);
 SIMPLE_SETTER(double, double);
 SIMPLE_SETTER(date, int64_t);
 SIMPLE_SETTER(string, const char*);
@@ -634,6 +1501,26 @@ SIMPLE_SETTER(uuid, const uuid_t);
 SIMPLE_SETTER(fd, int);
 SIMPLE_SETTER(pointer, void*);
 
+#define CREATING_SETTER_K(name, type, create) \
+	XPC_EXPORT \
+	void xpc_dictionary_set_ ## name ## _k(xpc_object_t xdict, xpc_key_t key, type value) { \
+		TO_OBJC_CHECKED(dictionary, xdict, dict) { \
+			xpc_object_t object = create(value); \
+			xpc_dictionary_set_value_k(xdict, key, object); \
+			xpc_release(object); \
+		} \
+	};
+
+#define SIMPLE_SETTER_K(name, type) CREATING_SETTER_K(name, type, xpc_ ## name ## _create)
+
+CREATING_SETTER_K(int64, int64_t, xpc_int64_create_shared);
+CREATING_SETTER_K(uint64, uint64_t, xpc_uint64_create_shared);
+
+SIMPLE_SETTER_K(bool, bool);
+SIMPLE_SETTER_K(double, double);
+SIMPLE_SETTER_K(date, int64_t);
+SIMPLE_SETTER_K(string, const char*);
+
 XPC_EXPORT
 void xpc_dictionary_set_data(xpc_object_t xdict, const char* key, const void* bytes, size_t length) {
 	TO_OBJC_CHECKED(dictionary, xdict, dict) {
@@ -680,6 +1567,25 @@ SIMPLE_GETTER(double, double);
 SIMPLE_GETTER(date, int64_t);
 SIMPLE_GETTER(pointer, void*);
 
+#define SIMPLE_GETTER_K(name, type) \
+	XPC_EXPORT \
+	type xpc_dictionary_get_ ## name ## _k(xpc_object_t xdict, xpc_key_t key) { \
+		xpc_object_t object = xpc_dictionary_get_value_k(xdict, key); \
+		return xpc_ ## name ## _get_value(object); \
+	};
+
+SIMPLE_GETTER_K(bool, bool);
+SIMPLE_GETTER_K(int64, int64_t);
+SIMPLE_GETTER_K(uint64, uint64_t);
+SIMPLE_GETTER_K(double, double);
+SIMPLE_GETTER_K(date, int64_t);
+
+XPC_EXPORT
+const char* xpc_dictionary_get_string_k(xpc_object_t xdict, xpc_key_t key) {
+	xpc_object_t object = xpc_dictionary_get_value_k(xdict, key);
+	return xpc_string_get_string_ptr(object);
+};
+
 XPC_EXPORT
 const void* xpc_dictionary_get_data(xpc_object_t xdict, const char* key, size_t* length) {
 	xpc_object_t object = xpc_dictionary_get_value(xdict, key);
@@ -70,6 +70,20 @@ error_out:
 	return nil;
 }
 
++ (BOOL)skip: (XPC_CLASS(deserializer)*)deserializer
+{
+	xpc_serial_type_t type = XPC_SERIAL_TYPE_INVALID;
+
+	if (![deserializer readU32: &type]) {
+		return NO;
+	}
+	if (type != XPC_SERIAL_TYPE_DOUBLE) {
+		return NO;
+	}
+
+	return [deserializer consume: sizeof(double) region: NULL];
+}
+
 - (BOOL)serialize: (XPC_CLASS(serializer)*)serializer
 {
 	XPC_THIS_DECL(double);
@@ -99,13 +113,13 @@ error_out:
 
 XPC_EXPORT
 xpc_object_t xpc_double_create(double value) {
-	return [[XPC_CLASS(double) alloc] initWithValue: value];
+	return xpc_double_alloc_with_value(value);
 };
 
 XPC_EXPORT
 double xpc_double_get_value(xpc_object_t xdouble) {
 	TO_OBJC_CHECKED(double, xdouble, doubleObj) {
-		return doubleObj.value;
+		return ((struct xpc_double_s*)doubleObj)->value;
 	}
 	return NAN;
 };
@@ -38,16 +38,11 @@ struct _xpc_dictionary_s {
 		.base = { \
 			XPC_GLOBAL_OBJECT_HEADER(string), \
 		}, \
-		.byteLength = NSUIntegerMax, \
+		.byteLength = sizeof(_description) - 1, \
 		.string = _description, \
 		.freeWhenDone = false \
 	}; \
-	extern const struct _xpc_dictionary_s _xpc_error_ ## _name; \
 	struct xpc_dictionary_entry_s _xpc_error_ ## _name ## _entry = { \
-		.link = { \
-			.le_next = NULL, \
-			.le_prev = (struct xpc_dictionary_entry_s**)&LIST_FIRST(&_xpc_error_ ## _name.the_real_thing.base.head), \
-		}, \
 		.object = XPC_CAST(string, &_xpc_error_ ## _name ## _entry_string), \
 		.name = XPCErrorDescriptionKey, \
 	}; \
@@ -58,9 +53,8 @@ struct _xpc_dictionary_s {
 					XPC_GLOBAL_OBJECT_HEADER(error), \
 				}, \
 				.size = 1, \
-				.head = { \
-					.lh_first = &_xpc_error_ ## _name ## _entry, \
-				}, \
+				.entries = &_xpc_error_ ## _name ## _entry, \
+				.entries_used = 1, \
 			}, \
 		}, \
 	};
@@ -76,9 +70,13 @@ XPC_CLASS_HEADER(error);
 
 - (char*)xpcDescription
 {
-	char* output = NULL;
-	asprintf(&output, "<%s: %s>", xpc_class_name(self), [self stringForKey: XPCErrorDescriptionKey].CString);
-	return output;
+	return xpc_description_copy(self, NULL);
+}
+
+// errors are dictionaries, but they're described by their description rather than by their entries
+- (void)describeTo: (xpc_description_writer_t*)writer
+{
+	xpc_description_printf(writer, "<%s: %s>", xpc_class_name(self), [self stringForKey: XPCErrorDescriptionKey].CString);
 }
 
 @end
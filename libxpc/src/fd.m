@@ -91,6 +91,12 @@ XPC_CLASS_HEADER(fd);
 	return (NSUInteger)this->port;
 }
 
+- (BOOL)isEqualToObject: (XPC_CLASS(object)*)object
+{
+	XPC_THIS_DECL(fd);
+	return this->port == XPC_CAST(fd, object).port;
+}
+
 - (instancetype)copy
 {
 	XPC_THIS_DECL(fd);
@@ -23,7 +23,37 @@
 #import <xpc/serialization.h>
 
 XPC_WRAPPER_CLASS_IMPL(int64, int64_t, "%lld");
-XPC_WRAPPER_CLASS_SERIAL_IMPL(int64, int64_t, INT64, U64, uint64_t);
+XPC_WRAPPER_CLASS_SERIAL_IMPL(int64, int64_t, INT64, U64, uint64_t, xpc_int64_create_shared);
+
+// small integers are by far the most common ones (message types, routines, error codes, etc.),
+// so there's a global object for each of them and creating one for a message (or deserializing one) never allocates.
+// whoever asks for an object with `xpc_int64_create` can modify it, though, so they always get their own.
+#define IMMORTAL_INT64_MIN (-128)
+#define IMMORTAL_INT64_MAX 1023
+#define IMMORTAL_INT64_COUNT (IMMORTAL_INT64_MAX - IMMORTAL_INT64_MIN + 1)
+
+static struct xpc_int64_s immortal_int64s[IMMORTAL_INT64_COUNT] = {
+	[0 ... IMMORTAL_INT64_COUNT - 1] = {
+		.base = {
+			XPC_GLOBAL_OBJECT_HEADER(int64),
+		},
+	},
+};
+static dispatch_once_t immortal_int64s_once;
+
+static void immortal_int64s_init(void* context) {
+	for (int64_t i = 0; i < IMMORTAL_INT64_COUNT; ++i) {
+		immortal_int64s[i].value = IMMORTAL_INT64_MIN + i;
+	}
+};
+
+xpc_object_t xpc_int64_create_shared(int64_t value) {
+	if (value >= IMMORTAL_INT64_MIN && value <= IMMORTAL_INT64_MAX) {
+		dispatch_once_f(&immortal_int64s_once, NULL, immortal_int64s_init);
+		return XPC_CAST(int64, &immortal_int64s[value - IMMORTAL_INT64_MIN]);
+	}
+	return xpc_int64_alloc_with_value(value);
+};
 
 //
 // C API
@@ -31,13 +61,13 @@ XPC_WRAPPER_CLASS_SERIAL_IMPL(int64, int64_t, INT64, U64, uint64_t);
 
 XPC_EXPORT
 xpc_object_t xpc_int64_create(int64_t value) {
-	return [[XPC_CLASS(int64) alloc] initWithValue: value];
+	return xpc_int64_alloc_with_value(value);
 };
 
 XPC_EXPORT
 int64_t xpc_int64_get_value(xpc_object_t xint) {
 	TO_OBJC_CHECKED(int64, xint, integer) {
-		return integer.value;
+		return ((struct xpc_int64_s*)integer)->value;
 	}
 	return 0;
 };
@@ -46,6 +76,7 @@ int64_t xpc_int64_get_value(xpc_object_t xint) {
 // private C API
 //
 
+// NOTE: this does nothing for the global objects for small values (see `xpc_int64_create_shared`), since everyone else with that value is using them too
 XPC_EXPORT
 void _xpc_int64_set_value(xpc_object_t xint, int64_t value) {
 	TO_OBJC_CHECKED(int64, xint, integer) {
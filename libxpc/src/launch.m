@@ -582,7 +582,8 @@ launch_data_new_integer(long long n)
 launch_data_t
 launch_data_new_bool(bool b)
 {
-    return xpc_bool_create(b);
+    // `launch_data_set_bool` has to be able to modify it, so it can't be one of the shared global bools
+    return _xpc_bool_create_distinct(b);
 }
 
 launch_data_t
@@ -57,6 +57,12 @@ XPC_CLASS_HEADER(mach_recv);
 	return (NSUInteger)this->port;
 }
 
+- (BOOL)isEqualToObject: (XPC_CLASS(object)*)object
+{
+	XPC_THIS_DECL(mach_recv);
+	return this->port == XPC_CAST(mach_recv, object).port;
+}
+
 - (instancetype)copy
 {
 	XPC_THIS_DECL(mach_recv);
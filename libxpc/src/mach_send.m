@@ -85,6 +85,12 @@ XPC_CLASS_HEADER(mach_send);
 	return (NSUInteger)this->port;
 }
 
+- (BOOL)isEqualToObject: (XPC_CLASS(object)*)object
+{
+	XPC_THIS_DECL(mach_send);
+	return this->port == XPC_CAST(mach_send, object).port;
+}
+
 - (instancetype)copy
 {
 	XPC_THIS_DECL(mach_send);
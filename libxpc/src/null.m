@@ -56,6 +56,11 @@ XPC_CLASS_HEADER(null);
 #endif
 }
 
+- (BOOL)isEqualToObject: (XPC_CLASS(object)*)object
+{
+	return YES;
+}
+
 @end
 
 @implementation XPC_CLASS(null) (XPCSerialization)
@@ -87,6 +92,20 @@ error_out:
 	return nil;
 }
 
++ (BOOL)skip: (XPC_CLASS(deserializer)*)deserializer
+{
+	xpc_serial_type_t type = XPC_SERIAL_TYPE_INVALID;
+
+	if (![deserializer readU32: &type]) {
+		return NO;
+	}
+	if (type != XPC_SERIAL_TYPE_NULL) {
+		return NO;
+	}
+
+	return YES;
+}
+
 - (BOOL)serialize: (XPC_CLASS(serializer)*)serializer
 {
 	return [serializer writeU32: XPC_SERIAL_TYPE_NULL];
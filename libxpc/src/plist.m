@@ -358,7 +358,7 @@ XPC_CLASS_HEADER(plist_xml_element);
 			XPC_CLASS(string)* string = XPC_CAST(string, this->object);
 			int64_t value = atoll(string.CString);
 			[this->object release];
-			this->object = [[XPC_CLASS(int64) alloc] initWithValue: value];
+			this->object = XPC_CAST(int64, xpc_int64_create(value));
 		} break;
 
 		// no need to do any processing for strings
@@ -783,7 +783,7 @@ XPC_CLASS_HEADER(plist_binary_v0_deserializer);
 		// invalid length
 		return nil;
 	}
-	return [[XPC_CLASS(int64) alloc] initWithValue: value];
+	return XPC_CAST(int64, xpc_int64_create(value));
 }
 
 - (XPC_CLASS(double)*)readReal: (const uint8_t*)object
@@ -923,15 +923,24 @@ XPC_CLASS_HEADER(plist_binary_v0_deserializer);
 
 - (XPC_CLASS(array)*)readArray: (const uint8_t*)object
 {
+	XPC_THIS_DECL(plist_binary_v0_deserializer);
 	const uint8_t* bytes = NULL;
 	NSUInteger count = [self readLength: object dataStart: &bytes];
+	NSUInteger capacity = count;
 	XPC_CLASS(array)* result = nil;
 
 	if (count == NSUIntegerMax) {
 		return nil;
 	}
 
-	result = [XPC_CLASS(array) new];
+	// the count comes straight from the file, so don't reserve room for more references than could actually fit in it
+	if (bytes >= this->data + this->length) {
+		capacity = 0;
+	} else if (capacity > (NSUInteger)(this->data + this->length - bytes) / this->reference_size) {
+		capacity = (NSUInteger)(this->data + this->length - bytes) / this->reference_size;
+	}
+
+	result = [[XPC_CLASS(array) alloc] initWithCapacity: capacity];
 
 	for (NSUInteger i = 0; i < count; ++i) {
 		NSUInteger referenceNumber = [self readReferenceNumber: bytes next: &bytes];
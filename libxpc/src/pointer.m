@@ -23,7 +23,7 @@
 #import <xpc/serialization.h>
 
 XPC_WRAPPER_CLASS_IMPL(pointer, void*, "%p");
-XPC_WRAPPER_CLASS_SERIAL_IMPL(pointer, void*, POINTER, U64, uint64_t);
+XPC_WRAPPER_CLASS_SERIAL_IMPL(pointer, void*, POINTER, U64, uint64_t, xpc_pointer_create);
 
 //
 // C API
@@ -31,13 +31,13 @@ XPC_WRAPPER_CLASS_SERIAL_IMPL(pointer, void*, POINTER, U64, uint64_t);
 
 XPC_EXPORT
 xpc_object_t xpc_pointer_create(void* value) {
-	return [[XPC_CLASS(pointer) alloc] initWithValue: value];
+	return xpc_pointer_alloc_with_value(value);
 };
 
 XPC_EXPORT
 void* xpc_pointer_get_value(xpc_object_t xptr) {
 	TO_OBJC_CHECKED(pointer, xptr, ptr) {
-		return ptr.value;
+		return ((struct xpc_pointer_s*)ptr)->value;
 	}
 	return NULL;
 };
@@ -21,6 +21,8 @@
 #include <xpc/internal.h>
 #include <xpc/activity.h>
 #include <mach/mach_vm.h>
+#include <stdatomic.h>
+#import <objc/runtime.h>
 
 // maximum number of ports of the same type to embed in an inline descriptor.
 // if the number of ports of the same type exceeds this number, they are all stuffed into an OOL descriptor.
@@ -55,22 +57,88 @@ static Class xpc_classes[] = {
 	XPC_TYPE_FILE_TRANSFER,
 };
 
+//
+// serialization vtables
+//
+// vtables are stored in the same order as `xpc_classes` (so looking one up by serial type is just an array access)
+// and are also hashed by class pointer (so that looking one up for an object is O(1) as well).
+// they're populated on first use, by which point all the classes have been realized.
+//
+
+#define SERIAL_VTABLE_COUNT (sizeof(xpc_classes) / sizeof(*xpc_classes))
+
+// number of slots in the class-to-vtable hash table; must be a power of two and comfortably larger than the number of classes
+#define SERIAL_VTABLE_CLASS_SLOTS 64
+
+static xpc_serial_vtable_t serial_vtables[SERIAL_VTABLE_COUNT];
+static const xpc_serial_vtable_t* serial_vtables_by_class[SERIAL_VTABLE_CLASS_SLOTS];
+static dispatch_once_t serial_vtables_once;
+
 XPC_INLINE
-Class type_to_class(uint32_t type) {
-	if ((type & 0xfff) != 0 || type < XPC_SERIAL_TYPE_MIN || type > XPC_SERIAL_TYPE_MAX) {
-		return nil;
+size_t serial_vtable_class_slot(Class class) {
+	// classes are at least 16-byte aligned, so the low bits carry no information
+	uintptr_t value = (uintptr_t)class >> 4;
+	return (size_t)((value * 0x9e3779b97f4a7c15ULL) >> 17) & (SERIAL_VTABLE_CLASS_SLOTS - 1);
+};
+
+static void serial_vtables_init(void* context) {
+	for (size_t i = 0; i < SERIAL_VTABLE_COUNT; ++i) {
+		xpc_serial_vtable_t* vtable = &serial_vtables[i];
+		Class class = xpc_classes[i];
+		Method skipMethod = NULL;
+		size_t slot = 0;
+
+		if (class == nil) {
+			continue;
+		}
+
+		skipMethod = class_getClassMethod(class, @selector(skip:));
+
+		vtable->class = class;
+		vtable->type = (i + 1) * 0x1000;
+		vtable->serializable = (void*)class_getMethodImplementation(class, @selector(serializable));
+		vtable->length = (void*)class_getMethodImplementation(class, @selector(serializationLengthWithSerializer:));
+		vtable->serialize = (void*)class_getMethodImplementation(class, @selector(serialize:));
+		vtable->deserialize = (void*)method_getImplementation(class_getClassMethod(class, @selector(deserialize:)));
+		vtable->skip = skipMethod ? (void*)method_getImplementation(skipMethod) : NULL;
+
+		for (slot = serial_vtable_class_slot(class); serial_vtables_by_class[slot] != NULL; slot = (slot + 1) & (SERIAL_VTABLE_CLASS_SLOTS - 1));
+		serial_vtables_by_class[slot] = vtable;
 	}
-	return xpc_classes[(type / 0x1000) - 1];
 };
 
-XPC_INLINE
-uint32_t class_to_type(Class class) {
-	for (size_t i = 0; i < (sizeof(xpc_classes) / sizeof(Class)); ++i) {
-		if (xpc_classes[i] == class) {
-			return (i + 1) * 0x1000;
+const xpc_serial_vtable_t* xpc_serial_vtable_for_class(Class class) {
+	dispatch_once_f(&serial_vtables_once, NULL, serial_vtables_init);
+	for (size_t slot = serial_vtable_class_slot(class); serial_vtables_by_class[slot] != NULL; slot = (slot + 1) & (SERIAL_VTABLE_CLASS_SLOTS - 1)) {
+		if (serial_vtables_by_class[slot]->class == class) {
+			return serial_vtables_by_class[slot];
 		}
 	}
-	return XPC_SERIAL_TYPE_INVALID;
+	return NULL;
+};
+
+const xpc_serial_vtable_t* xpc_serial_vtable_for_type(xpc_serial_type_t type) {
+	// the only flag we know about is the OOL flag; it's up to each class to decide whether it accepts it
+	if ((type & XPC_SERIAL_TYPE_FLAGS_MASK & ~XPC_SERIAL_TYPE_FLAG_OOL) != 0) {
+		return NULL;
+	}
+	type &= ~XPC_SERIAL_TYPE_FLAGS_MASK;
+	if (type < XPC_SERIAL_TYPE_MIN || type > XPC_SERIAL_TYPE_MAX) {
+		return NULL;
+	}
+	dispatch_once_f(&serial_vtables_once, NULL, serial_vtables_init);
+	if (serial_vtables[(type / 0x1000) - 1].class == nil) {
+		return NULL;
+	}
+	return &serial_vtables[(type / 0x1000) - 1];
+};
+
+BOOL xpc_serial_object_is_serializable(XPC_CLASS(object)* object) {
+	const xpc_serial_vtable_t* vtable = xpc_serial_vtable_for_class(object_getClass(object));
+	if (vtable == NULL) {
+		return object.serializable;
+	}
+	return vtable->serializable(object, @selector(serializable));
 };
 
 static size_t descriptor_sizes[] = {
@@ -89,6 +157,379 @@ size_t descriptor_size(mach_msg_descriptor_type_t type) {
 	return descriptor_sizes[type];
 };
 
+// initial number of slots in a serializer's length cache. must be a power of two.
+#define LENGTH_CACHE_INITIAL_CAPACITY 16
+
+// smallest buffer a serializer will allocate; most messages fit in this without ever growing.
+#define SERIAL_BUFFER_MIN_CAPACITY 512
+
+// largest buffer (in bytes) and length cache (in entries) that a thread will hold on to for reuse.
+// anything larger is freed immediately so that one huge message doesn't pin its memory forever.
+#define SERIAL_BUFFER_CACHE_MAX (128 * 1024)
+#define LENGTH_CACHE_RECYCLE_MAX 1024
+
+// messages with at least this much content are written directly into a VM region that can become the Mach message itself.
+#define SERIAL_IN_PLACE_THRESHOLD (256 * 1024)
+
+// number of OOL memory descriptors we leave room for in front of in-place content.
+// messages with more than this just fall back to copying the content when they're finalized.
+#define SERIAL_IN_PLACE_OOL_SLOTS 8
+
+// worst-case space needed in front of the content for the Mach header and descriptors.
+// every send disposition ends up as at most one descriptor (either a single inline port or a single OOL port array; see `OOL_PORT_THRESHOLD`).
+#define SERIAL_IN_PLACE_HEADROOM (sizeof(mach_msg_base_t) + MACH_MSG_SEND_DISPOSITION_COUNT * MAX(sizeof(mach_msg_port_descriptor_t), sizeof(mach_msg_ool_ports_descriptor_t)) + SERIAL_IN_PLACE_OOL_SLOTS * sizeof(mach_msg_ool_descriptor_t))
+
+XPC_INLINE
+size_t serial_round_page(size_t size) {
+	return (size + vm_page_size - 1) & ~((size_t)vm_page_size - 1);
+};
+
+//
+// per-thread serializer buffer cache
+//
+// each thread keeps (at most) one payload buffer and one length cache table from the last serializer it finished with.
+// the next serializer on that thread picks them up instead of allocating new ones.
+//
+// under memory pressure, we bump a global generation counter; threads notice the change the next time they touch their cache
+// and free whatever they're holding. idle threads keep their buffers until they exit or serialize again.
+//
+
+typedef struct xpc_serial_thread_cache {
+	void* buffer;
+	size_t buffer_capacity;
+	xpc_serial_length_cache_entry_t* length_entries;
+	size_t length_capacity;
+	unsigned long generation;
+} xpc_serial_thread_cache_t;
+
+static pthread_key_t thread_cache_key;
+static _Atomic unsigned long thread_cache_generation = 0;
+
+static _Atomic uint64_t serial_buffer_reuses = 0;
+static _Atomic uint64_t serial_buffer_allocations = 0;
+
+static void thread_cache_purge(xpc_serial_thread_cache_t* cache) {
+	free(cache->buffer);
+	cache->buffer = NULL;
+	cache->buffer_capacity = 0;
+	free(cache->length_entries);
+	cache->length_entries = NULL;
+	cache->length_capacity = 0;
+};
+
+static void thread_cache_destroy(void* context) {
+	xpc_serial_thread_cache_t* cache = context;
+	thread_cache_purge(cache);
+	free(cache);
+};
+
+static xpc_serial_thread_cache_t* thread_cache_get(void) {
+	static dispatch_once_t onceToken;
+	xpc_serial_thread_cache_t* cache = NULL;
+	unsigned long generation = 0;
+
+	dispatch_once(&onceToken, ^{
+		pthread_key_create(&thread_cache_key, thread_cache_destroy);
+
+		dispatch_source_t source = dispatch_source_create(DISPATCH_SOURCE_TYPE_MEMORYPRESSURE, 0, DISPATCH_MEMORYPRESSURE_WARN | DISPATCH_MEMORYPRESSURE_CRITICAL, dispatch_get_global_queue(QOS_CLASS_UTILITY, 0));
+		if (source != NULL) {
+			dispatch_source_set_event_handler(source, ^{
+				atomic_fetch_add_explicit(&thread_cache_generation, 1, memory_order_relaxed);
+			});
+			dispatch_resume(source);
+			// intentionally leaked; it lives for as long as the process does
+		}
+	});
+
+	cache = pthread_getspecific(thread_cache_key);
+	if (cache == NULL) {
+		cache = calloc(1, sizeof(*cache));
+		if (cache == NULL) {
+			return NULL;
+		}
+		if (pthread_setspecific(thread_cache_key, cache) != 0) {
+			free(cache);
+			return NULL;
+		}
+	}
+
+	generation = atomic_load_explicit(&thread_cache_generation, memory_order_relaxed);
+	if (cache->generation != generation) {
+		thread_cache_purge(cache);
+		cache->generation = generation;
+	}
+
+	return cache;
+};
+
+/**
+ * Takes this thread's cached payload buffer (if any). The caller owns the returned buffer.
+ */
+static void* serial_buffer_take(size_t* capacity) {
+	xpc_serial_thread_cache_t* cache = thread_cache_get();
+	void* buffer = NULL;
+	if (cache == NULL || cache->buffer == NULL) {
+		*capacity = 0;
+		return NULL;
+	}
+	buffer = cache->buffer;
+	*capacity = cache->buffer_capacity;
+	cache->buffer = NULL;
+	cache->buffer_capacity = 0;
+	atomic_fetch_add_explicit(&serial_buffer_reuses, 1, memory_order_relaxed);
+	return buffer;
+};
+
+/**
+ * Gives a payload buffer back to this thread's cache, or frees it if it's too large or the cache is already full.
+ */
+static void serial_buffer_recycle(void* buffer, size_t capacity) {
+	xpc_serial_thread_cache_t* cache = NULL;
+	if (buffer == NULL) {
+		return;
+	}
+	if (capacity <= SERIAL_BUFFER_CACHE_MAX && (cache = thread_cache_get()) != NULL) {
+		// keep whichever buffer is larger
+		if (cache->buffer_capacity < capacity) {
+			free(cache->buffer);
+			cache->buffer = buffer;
+			cache->buffer_capacity = capacity;
+			return;
+		}
+	}
+	free(buffer);
+};
+
+void xpc_serial_get_buffer_statistics(xpc_serial_buffer_statistics_t* statistics) {
+	statistics->reuses = atomic_load_explicit(&serial_buffer_reuses, memory_order_relaxed);
+	statistics->allocations = atomic_load_explicit(&serial_buffer_allocations, memory_order_relaxed);
+};
+
+XPC_INLINE
+size_t length_cache_slot(const void* object, size_t capacity) {
+	// objects are at least 16-byte aligned, so the low bits carry no information
+	uintptr_t value = (uintptr_t)object >> 4;
+	return (size_t)((value * 0x9e3779b97f4a7c15ULL) >> 17) & (capacity - 1);
+};
+
+static void length_cache_destroy(xpc_serial_length_cache_t* cache) {
+	xpc_serial_thread_cache_t* thread_cache = NULL;
+	if (cache->entries != NULL && cache->capacity <= LENGTH_CACHE_RECYCLE_MAX && (thread_cache = thread_cache_get()) != NULL && thread_cache->length_capacity < cache->capacity) {
+		free(thread_cache->length_entries);
+		thread_cache->length_entries = cache->entries;
+		thread_cache->length_capacity = cache->capacity;
+	} else {
+		free(cache->entries);
+	}
+	cache->entries = NULL;
+	cache->capacity = 0;
+	cache->count = 0;
+};
+
+/**
+ * Allocates a zeroed table with at least the given number of slots, preferring this thread's recycled table if it's large enough.
+ * On return, `capacity` contains the actual number of slots.
+ */
+static xpc_serial_length_cache_entry_t* length_cache_allocate_entries(size_t* capacity) {
+	xpc_serial_thread_cache_t* thread_cache = thread_cache_get();
+	if (thread_cache != NULL && thread_cache->length_entries != NULL && thread_cache->length_capacity >= *capacity) {
+		xpc_serial_length_cache_entry_t* entries = thread_cache->length_entries;
+		*capacity = thread_cache->length_capacity;
+		thread_cache->length_entries = NULL;
+		thread_cache->length_capacity = 0;
+		memset(entries, 0, *capacity * sizeof(*entries));
+		return entries;
+	}
+	return calloc(*capacity, sizeof(xpc_serial_length_cache_entry_t));
+};
+
+static bool length_cache_lookup(const xpc_serial_length_cache_t* cache, const void* object, NSUInteger* length) {
+	if (cache->count == 0) {
+		return false;
+	}
+	for (size_t i = length_cache_slot(object, cache->capacity); cache->entries[i].object != NULL; i = (i + 1) & (cache->capacity - 1)) {
+		if (cache->entries[i].object == object) {
+			*length = cache->entries[i].length;
+			return true;
+		}
+	}
+	return false;
+};
+
+static bool length_cache_insert(xpc_serial_length_cache_t* cache, const void* object, NSUInteger length) {
+	// keep the load factor at or below 1/2
+	if ((cache->count + 1) * 2 > cache->capacity) {
+		size_t new_capacity = (cache->capacity == 0) ? LENGTH_CACHE_INITIAL_CAPACITY : cache->capacity * 2;
+		xpc_serial_length_cache_entry_t* new_entries = length_cache_allocate_entries(&new_capacity);
+		if (new_entries == NULL) {
+			return false;
+		}
+		for (size_t i = 0; i < cache->capacity; ++i) {
+			const void* current = cache->entries[i].object;
+			if (current == NULL) {
+				continue;
+			}
+			size_t slot = length_cache_slot(current, new_capacity);
+			while (new_entries[slot].object != NULL) {
+				slot = (slot + 1) & (new_capacity - 1);
+			}
+			new_entries[slot] = cache->entries[i];
+		}
+		free(cache->entries);
+		cache->entries = new_entries;
+		cache->capacity = new_capacity;
+	}
+
+	size_t slot = length_cache_slot(object, cache->capacity);
+	while (cache->entries[slot].object != NULL) {
+		if (cache->entries[slot].object == object) {
+			cache->entries[slot].length = length;
+			return true;
+		}
+		slot = (slot + 1) & (cache->capacity - 1);
+	}
+	cache->entries[slot].object = object;
+	cache->entries[slot].length = length;
+	++cache->count;
+	return true;
+};
+
+/**
+ * Moves the serializer's content into a new VM region with room for at least `capacity` bytes of content
+ * and `SERIAL_IN_PLACE_HEADROOM` bytes in front of it.
+ */
+static bool serial_buffer_move_to_region(struct xpc_serializer_s* this, size_t capacity) {
+	size_t headroom = SERIAL_IN_PLACE_HEADROOM;
+	mach_vm_size_t region_size = serial_round_page(headroom + capacity);
+	mach_vm_address_t region = 0;
+
+	// the region has to start within the headroom so that deallocating the finished message releases the whole region
+	xpc_assert(headroom < vm_page_size);
+
+	if (mach_vm_allocate(mach_task_self(), &region, region_size, VM_FLAGS_ANYWHERE) != KERN_SUCCESS) {
+		return false;
+	}
+
+	if (this->buffer != NULL) {
+		memcpy((char*)region + headroom, this->buffer, this->offset);
+		if (this->headroom > 0) {
+			mach_vm_deallocate(mach_task_self(), (mach_vm_address_t)((char*)this->buffer - this->headroom), this->headroom + this->capacity);
+		} else {
+			serial_buffer_recycle(this->buffer, this->capacity);
+		}
+	}
+
+	this->buffer = (char*)region + headroom;
+	this->capacity = region_size - headroom;
+	this->headroom = headroom;
+	return true;
+};
+
+/**
+ * Releases the serializer's buffer, wherever it came from.
+ */
+static void serial_buffer_release(struct xpc_serializer_s* this) {
+	if (this->headroom > 0) {
+		mach_vm_deallocate(mach_task_self(), (mach_vm_address_t)((char*)this->buffer - this->headroom), this->headroom + this->capacity);
+	} else {
+		serial_buffer_recycle(this->buffer, this->capacity);
+	}
+	this->buffer = NULL;
+	this->capacity = 0;
+	this->headroom = 0;
+};
+
+/**
+ * Copies content into (part of) an out-of-line region.
+ * If both the source and the destination are page-aligned, whole pages are shared copy-on-write instead of copied.
+ */
+static void ool_copy(void* destination, const void* source, size_t length) {
+	size_t pageLength = 0;
+
+	if ((((uintptr_t)source | (uintptr_t)destination) & vm_page_mask) == 0) {
+		pageLength = length & ~(size_t)vm_page_mask;
+		if (pageLength > 0 && mach_vm_copy(mach_task_self(), (mach_vm_address_t)source, pageLength, (mach_vm_address_t)destination) != KERN_SUCCESS) {
+			pageLength = 0;
+		}
+	}
+
+	memcpy((char*)destination + pageLength, (const char*)source + pageLength, length - pageLength);
+};
+
+// number of nested containers the validator can track before it has to allocate
+#define SERIAL_VALIDATION_INLINE_DEPTH 16
+
+// a container that the validator is currently inside of
+typedef struct xpc_serial_validation_frame {
+	size_t end;
+	uint32_t remaining;
+	bool keyed;
+} xpc_serial_validation_frame_t;
+
+// number of nested containers the decoder can track before it has to allocate
+#define SERIAL_DECODE_INLINE_DEPTH 16
+
+// a container that the decoder is currently filling in
+typedef struct xpc_serial_decode_frame {
+	XPC_CLASS(object)* container;
+	size_t end;
+	uint32_t remaining;
+	bool keyed;
+} xpc_serial_decode_frame_t;
+
+// grows a frame stack that starts out in `inline_frames`; returns `false` if we run out of memory
+static bool serial_frames_grow(void** frames, void* inline_frames, size_t* capacity, size_t count, size_t frame_size) {
+	void* expanded = NULL;
+	size_t new_capacity = *capacity * 2;
+	if (*frames == inline_frames) {
+		expanded = malloc(new_capacity * frame_size);
+		if (expanded != NULL) {
+			memcpy(expanded, inline_frames, count * frame_size);
+		}
+	} else {
+		expanded = realloc(*frames, new_capacity * frame_size);
+	}
+	if (expanded == NULL) {
+		return false;
+	}
+	*frames = expanded;
+	*capacity = new_capacity;
+	return true;
+};
+
+// checks whether the message content (plus any out-of-line memory) fits within `limits.max_bytes`
+static bool deserial_within_size_limit(struct xpc_deserializer_s* this) {
+	size_t total = this->length;
+	if (this->limits.max_bytes == 0) {
+		return true;
+	}
+	for (size_t i = 0; i < this->ool_region_count; ++i) {
+		if (this->ool_regions[i].size > SIZE_MAX - total) {
+			return false;
+		}
+		total += this->ool_regions[i].size;
+	}
+	return total <= this->limits.max_bytes;
+};
+
+// counts more objects towards `limits.max_objects`; returns `false` once the limit is exceeded
+XPC_INLINE
+bool deserial_count_objects(struct xpc_deserializer_s* this, size_t count) {
+	this->object_count += count;
+	return this->limits.max_objects == 0 || this->object_count <= this->limits.max_objects;
+};
+
+XPC_INLINE
+bool deserial_count_object(struct xpc_deserializer_s* this) {
+	return deserial_count_objects(this, 1);
+};
+
+// checks whether another container can be nested within `depth` containers
+XPC_INLINE
+bool deserial_can_nest(struct xpc_deserializer_s* this, size_t depth) {
+	return this->limits.max_depth == 0 || depth < this->limits.max_depth;
+};
+
 XPC_CLASS_SYMBOL_DECL(serializer);
 XPC_CLASS_SYMBOL_DECL(deserializer);
 
@@ -109,6 +550,18 @@ XPC_CLASS_HEADER(serializer);
 	return this->finalized_message != NULL;
 }
 
+- (NSUInteger)oolThreshold
+{
+	XPC_THIS_DECL(serializer);
+	return this->ool_threshold;
+}
+
+- (void)setOolThreshold: (NSUInteger)oolThreshold
+{
+	XPC_THIS_DECL(serializer);
+	this->ool_threshold = oolThreshold;
+}
+
 - (void)dealloc
 {
 	XPC_THIS_DECL(serializer);
@@ -118,9 +571,19 @@ XPC_CLASS_HEADER(serializer);
 	}
 
 	if (this->buffer != NULL) {
-		free(this->buffer);
+		serial_buffer_release(this);
 	}
 
+	length_cache_destroy(&this->length_cache);
+
+	// if we never got to hand these off to a message, we still own them
+	for (size_t i = 0; i < this->ool_region_count; ++i) {
+		mach_vm_deallocate(mach_task_self(), (mach_vm_address_t)this->ool_regions[i].address, this->ool_regions[i].size);
+	}
+	free(this->ool_regions);
+	this->ool_regions = NULL;
+	this->ool_region_count = 0;
+
 	for (size_t i = 0; i < sizeof(this->port_arrays) / sizeof(*this->port_arrays); ++i) {
 		mach_port_right_t port_right = xpc_mach_msg_type_name_to_port_right(i + MACH_MSG_SEND_DISPOSITION_FIRST);
 		xpc_serial_port_array_t* port_array = &this->port_arrays[i];
@@ -163,7 +626,8 @@ XPC_CLASS_HEADER(serializer);
 - (instancetype)initWithoutHeader
 {
 	if (self = [super init]) {
-		// nothing
+		XPC_THIS_DECL(serializer);
+		this->ool_threshold = XPC_SERIAL_OOL_DEFAULT_THRESHOLD;
 	}
 	return self;
 }
@@ -176,6 +640,8 @@ XPC_CLASS_HEADER(serializer);
 	mach_msg_descriptor_t* descriptors = NULL;
 	void* body = NULL;
 	size_t descriptorCount = 0;
+	size_t headerSize = 0;
+	BOOL inPlace = NO;
 
 	if (this->finalized_message) {
 		return this->finalized_message;
@@ -197,18 +663,42 @@ XPC_CLASS_HEADER(serializer);
 		}
 	}
 
-	// if we have ports, the message must be complex so we need the complex body
+	// add in OOL memory descriptor sizes
+	messageSize += this->ool_region_count * sizeof(mach_msg_ool_descriptor_t);
+	descriptorCount += this->ool_region_count;
+
+	// if we have descriptors, the message must be complex so we need the complex body
 	if (descriptorCount > 0) {
 		messageSize += sizeof(mach_msg_body_t);
 	}
 
 	// add in the length of the actual serialized XPC data
-	messageSize += this->length;
+	headerSize = messageSize;
+	messageSize += this->offset;
+
+	if (this->headroom >= headerSize) {
+		// the content already sits in a VM region with enough room in front of it,
+		// so we just build the message around it. the region begins on the page that contains the header,
+		// so the VM destructor releases the entire region when the message dies.
+		base = (mach_msg_base_t*)((char*)this->buffer - headerSize);
+		this->finalized_message = dispatch_mach_msg_create((mach_msg_header_t*)base, messageSize, DISPATCH_MACH_MSG_DESTRUCTOR_VM_DEALLOCATE, NULL);
+		if (!this->finalized_message) {
+			return NULL;
+		}
+		inPlace = YES;
 
-	// now we allocate the message
-	this->finalized_message = dispatch_mach_msg_create(NULL, messageSize, DISPATCH_MACH_MSG_DESTRUCTOR_DEFAULT, (mach_msg_header_t**)&base);
-	if (!this->finalized_message) {
-		return NULL;
+		// give back any whole pages past the end of the content; the destructor won't know about them
+		uintptr_t regionEnd = (uintptr_t)this->buffer + this->capacity;
+		uintptr_t usedEnd = serial_round_page((uintptr_t)this->buffer + this->offset);
+		if (usedEnd < regionEnd) {
+			mach_vm_deallocate(mach_task_self(), usedEnd, regionEnd - usedEnd);
+		}
+	} else {
+		// otherwise, we allocate the message and copy the content in later
+		this->finalized_message = dispatch_mach_msg_create(NULL, messageSize, DISPATCH_MACH_MSG_DESTRUCTOR_DEFAULT, (mach_msg_header_t**)&base);
+		if (!this->finalized_message) {
+			return NULL;
+		}
 	}
 	descriptors = (mach_msg_descriptor_t*)((char*)base + sizeof(*base));
 
@@ -269,12 +759,39 @@ XPC_CLASS_HEADER(serializer);
 		}
 	}
 
-	// finally, copy in the serialized XPC data...
-	memcpy(body, this->buffer, this->length);
+	// transfer the OOL memory descriptors, in the same order their indices were handed out
+	for (size_t i = 0; i < this->ool_region_count; ++i) {
+		mach_msg_ool_descriptor_t* ool_desc = body;
+		body = (char*)body + sizeof(*ool_desc);
 
-	// ...and free our buffer
-	free(this->buffer);
-	this->buffer = NULL;
+		ool_desc->type = MACH_MSG_OOL_DESCRIPTOR;
+		ool_desc->copy = MACH_MSG_VIRTUAL_COPY;
+		ool_desc->deallocate = 1;
+		ool_desc->address = this->ool_regions[i].address;
+		ool_desc->size = this->ool_regions[i].size;
+	}
+
+	// the regions belong to the message now
+	free(this->ool_regions);
+	this->ool_regions = NULL;
+	this->ool_region_count = 0;
+
+	if (inPlace) {
+		// the content is already where it needs to be, and the message owns the region now
+		xpc_assert(body == this->buffer);
+		this->buffer = NULL;
+		this->capacity = 0;
+		this->headroom = 0;
+	} else {
+		// finally, copy in the serialized XPC data...
+		memcpy(body, this->buffer, this->offset);
+
+		// ...and release our buffer (small ones go back to this thread's cache for the next serializer)
+		serial_buffer_release(this);
+	}
+
+	// no more content can be written, so the cached lengths are useless now
+	length_cache_destroy(&this->length_cache);
 
 	return this->finalized_message;
 }
@@ -287,21 +804,144 @@ XPC_CLASS_HEADER(serializer);
 - (BOOL)needsToResizeToWrite: (NSUInteger)extraSize
 {
 	XPC_THIS_DECL(serializer);
-	return extraSize > this->length - this->offset;
+	return extraSize > this->capacity - this->offset;
 }
 
 - (BOOL)ensure: (NSUInteger)extraSize
 {
 	XPC_THIS_DECL(serializer);
 	if ([self needsToResizeToWrite: extraSize]) {
-		size_t extra = extraSize - (this->length - this->offset);
-		void* newBuffer = realloc(this->buffer, this->length + extra);
-		if (this->length + extra > 0 && newBuffer == NULL) {
+		size_t required = this->offset + extraSize;
+		size_t newCapacity = MAX(this->capacity * 2, SERIAL_BUFFER_MIN_CAPACITY);
+		void* newBuffer = NULL;
+
+		if (this->finalized_message) {
+			return NO;
+		}
+
+		if (newCapacity < required) {
+			newCapacity = required;
+		}
+
+		if (this->headroom > 0 || required >= SERIAL_IN_PLACE_THRESHOLD) {
+			// large content goes into a VM region so that finalizing can avoid copying it.
+			// when we switch to a region for the first time, we only need the requested size;
+			// since the root object is measured up front, that's usually all we'll ever need.
+			return serial_buffer_move_to_region(this, (this->headroom > 0) ? newCapacity : required) ? YES : NO;
+		}
+
+		if (this->buffer == NULL) {
+			// try to pick up a buffer left behind by a previous serializer on this thread
+			size_t cachedCapacity = 0;
+			this->buffer = serial_buffer_take(&cachedCapacity);
+			this->capacity = cachedCapacity;
+			if (this->capacity >= required) {
+				return YES;
+			}
+		}
+
+		newBuffer = realloc(this->buffer, newCapacity);
+		if (newBuffer == NULL) {
 			return NO;
 		}
+		atomic_fetch_add_explicit(&serial_buffer_allocations, 1, memory_order_relaxed);
 		this->buffer = newBuffer;
-		this->length += extra;
+		this->capacity = newCapacity;
+	}
+	return YES;
+}
+
+- (NSUInteger)lengthOfObject: (XPC_CLASS(object)*)object
+{
+	XPC_THIS_DECL(serializer);
+	NSUInteger length = 0;
+	const xpc_serial_vtable_t* vtable = NULL;
+	if (length_cache_lookup(&this->length_cache, object, &length)) {
+		return length;
+	}
+	vtable = xpc_serial_vtable_for_class(object_getClass(object));
+	if (vtable == NULL) {
+		return [object serializationLengthWithSerializer: self];
+	}
+	return vtable->length(object, @selector(serializationLengthWithSerializer:), self);
+}
+
+- (void)cacheLength: (NSUInteger)length forObject: (XPC_CLASS(object)*)object
+{
+	XPC_THIS_DECL(serializer);
+	// if this fails, we just end up measuring the object again later; no big deal
+	length_cache_insert(&this->length_cache, object, length);
+}
+
+- (BOOL)shouldWriteOOL: (NSUInteger)length
+{
+	XPC_THIS_DECL(serializer);
+	return this->ool_threshold > 0 && length >= this->ool_threshold;
+}
+
+- (BOOL)reserveOOL: (NSUInteger)length region: (void**)region
+{
+	XPC_THIS_DECL(serializer);
+	xpc_serial_ool_region_t* expanded_regions = NULL;
+	mach_vm_address_t address = 0;
+
+	if (this->finalized_message || length == 0 || length > UINT32_MAX) {
+		return NO;
+	}
+
+	expanded_regions = realloc(this->ool_regions, (this->ool_region_count + 1) * sizeof(*this->ool_regions));
+	if (!expanded_regions) {
+		return NO;
+	}
+	this->ool_regions = expanded_regions;
+
+	if (mach_vm_allocate(mach_task_self(), &address, length, VM_FLAGS_ANYWHERE) != KERN_SUCCESS) {
+		return NO;
+	}
+
+	if (![self writeU32: this->ool_region_count]) {
+		mach_vm_deallocate(mach_task_self(), address, length);
+		return NO;
 	}
+
+	this->ool_regions[this->ool_region_count].address = (void*)address;
+	this->ool_regions[this->ool_region_count].size = length;
+	++this->ool_region_count;
+
+	if (region != NULL) {
+		*region = (void*)address;
+	}
+
+	return YES;
+}
+
+- (BOOL)writeOOL: (const void*)data length: (NSUInteger)length
+{
+	void* region = NULL;
+
+	if (![self reserveOOL: length region: &region]) {
+		return NO;
+	}
+
+	ool_copy(region, data, length);
+
+	return YES;
+}
+
+- (BOOL)writeOOLDispatchData: (dispatch_data_t)data
+{
+	void* region = NULL;
+	size_t length = dispatch_data_get_size(data);
+
+	if (![self reserveOOL: length region: &region]) {
+		return NO;
+	}
+
+	dispatch_data_apply(data, ^bool (dispatch_data_t subrange, size_t offset, const void* buffer, size_t size) {
+		ool_copy((char*)region + offset, buffer, size);
+		return true;
+	});
+
 	return YES;
 }
 
@@ -380,14 +1020,16 @@ XPC_CLASS_HEADER(serializer);
 {
 	XPC_THIS_DECL(serializer);
 	size_t savedOffset = this->offset;
-	uint32_t type = class_to_type([object class]);
-	if (type == XPC_SERIAL_TYPE_INVALID) {
+	const xpc_serial_vtable_t* vtable = xpc_serial_vtable_for_class(object_getClass(object));
+	if (vtable == NULL) {
 		goto error_out;
 	}
-	if (![self ensure: object.serializationLength]) {
+	// for the root object, this measures the entire tree and grows the buffer once.
+	// for nested objects, the lengths are already cached and the buffer already has enough space, so this is cheap.
+	if (![self ensure: [self lengthOfObject: object]]) {
 		goto error_out;
 	}
-	if (![object serialize: self]) {
+	if (!vtable->serialize(object, @selector(serialize:), self)) {
 		goto error_out;
 	}
 
@@ -423,6 +1065,30 @@ XPC_CLASS_HEADER(deserializer);
 	return header->msgh_remote_port;
 }
 
+- (NSUInteger)borrowThreshold
+{
+	XPC_THIS_DECL(deserializer);
+	return this->borrow_threshold;
+}
+
+- (void)setBorrowThreshold: (NSUInteger)borrowThreshold
+{
+	XPC_THIS_DECL(deserializer);
+	this->borrow_threshold = borrowThreshold;
+}
+
+- (xpc_deserial_limits_t)limits
+{
+	XPC_THIS_DECL(deserializer);
+	return this->limits;
+}
+
+- (void)setLimits: (xpc_deserial_limits_t)limits
+{
+	XPC_THIS_DECL(deserializer);
+	this->limits = limits;
+}
+
 - (void)dealloc
 {
 	XPC_THIS_DECL(deserializer);
@@ -444,6 +1110,15 @@ XPC_CLASS_HEADER(deserializer);
 		}
 	}
 
+	// same for OOL memory that no object took ownership of
+	for (size_t i = 0; i < this->ool_region_count; ++i) {
+		if (this->ool_regions[i].address != NULL) {
+			vm_deallocate(mach_task_self(), (vm_address_t)this->ool_regions[i].address, this->ool_regions[i].size);
+		}
+	}
+	free(this->ool_regions);
+	this->ool_regions = NULL;
+
 	[super dealloc];
 }
 
@@ -489,6 +1164,8 @@ XPC_CLASS_HEADER(deserializer);
 		// don't retain it; we own it now
 		this->mach_msg = message;
 
+		this->borrow_threshold = XPC_SERIAL_BORROW_DEFAULT_THRESHOLD;
+
 		if (MACH_MSGH_BITS_IS_COMPLEX(base->header.msgh_bits)) {
 			// first, count how many ports we have of each
 			for (size_t i = 0; i < base->body.msgh_descriptor_count; ++i) {
@@ -518,6 +1195,10 @@ XPC_CLASS_HEADER(deserializer);
 						}
 						++this->port_arrays[guarded_desc->disposition - MACH_MSG_RECV_DISPOSITION_FIRST].length;
 					} break;
+					case MACH_MSG_OOL_DESCRIPTOR:
+					case MACH_MSG_OOL_VOLATILE_DESCRIPTOR: {
+						++this->ool_region_count;
+					} break;
 				}
 			}
 
@@ -529,7 +1210,14 @@ XPC_CLASS_HEADER(deserializer);
 				}
 			}
 
-			// now we actually save the ports and deallocate memory passed in for OOL descriptors
+			// and one to keep track of OOL memory
+			this->ool_regions = calloc(this->ool_region_count, sizeof(*this->ool_regions));
+			if (this->ool_region_count > 0 && this->ool_regions == NULL) {
+				xpc_abort("failed to allocate memory for OOL region array");
+			}
+			this->ool_region_count = 0;
+
+			// now we actually save the ports and OOL memory regions
 			body = descriptors;
 			for (size_t i = 0; i < base->body.msgh_descriptor_count; ++i) {
 				const mach_msg_descriptor_t* descriptor = body;
@@ -567,14 +1255,13 @@ XPC_CLASS_HEADER(deserializer);
 						port_array->array[port_array->offset++] = guarded_desc->name;
 					} break;
 
-					// we don't use these, but we have to deallocate them if we ever encountered them.
-					// we should probably log a warning or something if we find these
+					// objects with OOL content refer to these by index; whatever they don't claim is deallocated with us
 					case MACH_MSG_OOL_DESCRIPTOR:
 					case MACH_MSG_OOL_VOLATILE_DESCRIPTOR: {
 						const mach_msg_ool_descriptor_t* ool_desc = (const mach_msg_ool_descriptor_t*)descriptor;
-						if (ool_desc->deallocate) {
-							vm_deallocate(mach_task_self(), (vm_address_t)ool_desc->address, ool_desc->size);
-						}
+						xpc_deserial_ool_region_t* ool_region = &this->ool_regions[this->ool_region_count++];
+						ool_region->address = ool_desc->address;
+						ool_region->size = ool_desc->size;
 					} break;
 				}
 			}
@@ -626,7 +1313,19 @@ XPC_CLASS_HEADER(deserializer);
 - (BOOL)readString: (const char**)string
 {
 	XPC_THIS_DECL(deserializer);
-	return [self consume: strlen(&this->buffer[this->offset]) + 1 region: (const void**)string];
+	const char* start = &this->buffer[this->offset];
+	const char* terminator = NULL;
+
+	// never look past the end of the content; a string without a terminator is invalid
+	if (this->offset >= this->length) {
+		return NO;
+	}
+	terminator = memchr(start, '\0', this->length - this->offset);
+	if (terminator == NULL) {
+		return NO;
+	}
+
+	return [self consume: (terminator - start) + 1 region: (const void**)string];
 }
 
 - (BOOL)readU32: (uint32_t*)value
@@ -685,35 +1384,414 @@ XPC_CLASS_HEADER(deserializer);
 {
 	XPC_THIS_DECL(deserializer);
 	size_t savedOffset = this->offset;
-	uint32_t type = XPC_SERIAL_TYPE_INVALID;
-	Class class = nil;
-	XPC_CLASS(object)* result = nil;
-
-	if (![self peekU32: &type]) {
-		goto error_out;
+	size_t savedObjectCount = this->object_count;
+	xpc_serial_decode_frame_t inlineFrames[SERIAL_DECODE_INLINE_DEPTH];
+	xpc_serial_decode_frame_t* frames = inlineFrames;
+	size_t frameCapacity = SERIAL_DECODE_INLINE_DEPTH;
+	size_t depth = 0;
+	XPC_CLASS(object)* root = nil;
+	BOOL sawRoot = NO;
+
+	if (!deserial_within_size_limit(this)) {
+		return NO;
 	}
 
-	class = type_to_class(type);
-	if (class == nil) {
-		goto error_out;
+	while (true) {
+		xpc_serial_decode_frame_t* frame = (depth > 0) ? &frames[depth - 1] : NULL;
+		uint32_t type = XPC_SERIAL_TYPE_INVALID;
+		const xpc_serial_vtable_t* vtable = NULL;
+		const char* key = NULL;
+		XPC_CLASS(object)* result = nil;
+		size_t objectOffset = 0;
+		bool isContainer = false;
+
+		if (frame != NULL) {
+			if (frame->remaining == 0) {
+				// containers must contain exactly what they say they do
+				if (this->offset != frame->end) {
+					goto error_out;
+				}
+				--depth;
+				continue;
+			}
+			--frame->remaining;
+			if (frame->keyed && ![self readString: &key]) {
+				goto error_out;
+			}
+		} else if (sawRoot) {
+			break;
+		} else {
+			sawRoot = YES;
+		}
+
+		if (!deserial_count_object(this)) {
+			goto error_out;
+		}
+
+		if (![self peekU32: &type]) {
+			goto error_out;
+		}
+
+		isContainer = type == XPC_SERIAL_TYPE_ARRAY || type == XPC_SERIAL_TYPE_DICT;
+
+		if (isContainer) {
+			uint32_t contentLength = 0;
+			uint32_t entryCount = 0;
+			size_t contentStartOffset = 0;
+			bool keyed = type == XPC_SERIAL_TYPE_DICT;
+
+			if (!deserial_can_nest(this, depth)) {
+				goto error_out;
+			}
+
+			if (![self readU32: NULL] || ![self readU32: &contentLength]) {
+				goto error_out;
+			}
+
+			// the entry count is included in the content length
+			contentStartOffset = this->offset;
+			if (contentLength < sizeof(uint32_t) || contentLength > this->length - contentStartOffset) {
+				goto error_out;
+			}
+
+			if (![self readU32: &entryCount]) {
+				goto error_out;
+			}
+
+			// every entry needs at least a type (and, for dictionaries, a padded key), so a bogus count can be rejected right away.
+			// this also means the count can be trusted as a capacity hint.
+			if (entryCount > (contentLength - sizeof(uint32_t)) / (keyed ? 2 * sizeof(uint32_t) : sizeof(uint32_t))) {
+				goto error_out;
+			}
+
+			// arrays that only contain one kind of primitive are read in one go, without creating an object for each of their values
+			if (!keyed && (result = [XPC_CLASS(array) newPackedWithSerializedContent: [self contentAtOffset: this->offset] length: contentLength - sizeof(uint32_t) count: entryCount]) != nil) {
+				if (!deserial_count_objects(this, entryCount)) {
+					[result release];
+					goto error_out;
+				}
+				this->offset = contentStartOffset + contentLength;
+			} else {
+				if (depth == frameCapacity && !serial_frames_grow((void**)&frames, inlineFrames, &frameCapacity, depth, sizeof(*frames))) {
+					goto error_out;
+				}
+
+				if (keyed) {
+					result = [xpc_dictionary_alloc_with_capacity(entryCount) initWithCapacity: entryCount];
+				} else {
+					result = [[XPC_CLASS(array) alloc] initWithCapacity: entryCount];
+				}
+
+				// the parent frame might have moved if the stack was just grown
+				frame = (depth > 0) ? &frames[depth - 1] : NULL;
+
+				frames[depth].container = result;
+				frames[depth].end = contentStartOffset + contentLength;
+				frames[depth].remaining = entryCount;
+				frames[depth].keyed = keyed;
+				++depth;
+			}
+		} else {
+			vtable = xpc_serial_vtable_for_type(type);
+			if (vtable == NULL) {
+				goto error_out;
+			}
+
+			// dictionary entries that can be skipped are only validated now and created once someone actually asks for them
+			if (frame != NULL && frame->keyed && (type & XPC_SERIAL_TYPE_FLAG_OOL) == 0 && vtable->skip != NULL) {
+				objectOffset = this->offset;
+				if (!vtable->skip(vtable->class, @selector(skip:), self)) {
+					goto error_out;
+				}
+				[(XPC_CLASS(dictionary)*)frame->container setSkippedObjectAtOffset: objectOffset length: this->offset - objectOffset forKey: key deserializer: self];
+				continue;
+			}
+
+			result = vtable->deserialize(vtable->class, @selector(deserialize:), self);
+			if (result == nil) {
+				goto error_out;
+			}
+		}
+
+		// attach the new object to its parent right away (containers are filled in afterwards)
+		if (frame == NULL) {
+			root = result;
+		} else {
+			if (frame->keyed) {
+				[(XPC_CLASS(dictionary)*)frame->container setObject: result forKey: key];
+			} else {
+				[(XPC_CLASS(array)*)frame->container addObject: result];
+			}
+			[result release];
+		}
 	}
 
-	result = [class deserialize: self];
-	if (result == nil) {
-		goto error_out;
+	if (frames != inlineFrames) {
+		free(frames);
 	}
 
 	if (object != NULL) {
-		*object = result;
+		*object = root;
+	} else {
+		[root release];
 	}
 
 	return YES;
 
 error_out:
+	if (frames != inlineFrames) {
+		free(frames);
+	}
+	[root release];
 	this->offset = savedOffset;
+	this->object_count = savedObjectCount;
 	return NO;
 }
 
+- (BOOL)validateOOL: (xpc_serial_type_t)type
+{
+	XPC_THIS_DECL(deserializer);
+	uint32_t length = 0;
+	uint32_t index = 0;
+	size_t required = 0;
+
+	if (![self readU32: NULL] || ![self readU32: &length] || ![self readU32: &index]) {
+		return NO;
+	}
+
+	// strings include their terminator in the region, but not in the length
+	required = (size_t)length + (((type & ~XPC_SERIAL_TYPE_FLAGS_MASK) == XPC_SERIAL_TYPE_STRING) ? 1 : 0);
+
+	return index < this->ool_region_count && this->ool_regions[index].address != NULL && length > 0 && required <= this->ool_regions[index].size;
+}
+
+- (BOOL)validate
+{
+	XPC_THIS_DECL(deserializer);
+	size_t savedOffset = this->offset;
+	xpc_serial_validation_frame_t inlineFrames[SERIAL_VALIDATION_INLINE_DEPTH];
+	xpc_serial_validation_frame_t* frames = inlineFrames;
+	size_t frameCapacity = SERIAL_VALIDATION_INLINE_DEPTH;
+	size_t depth = 0;
+	size_t objectCount = 0;
+	BOOL sawRoot = NO;
+	BOOL valid = NO;
+
+	if (!deserial_within_size_limit(this)) {
+		return NO;
+	}
+
+	while (true) {
+		xpc_serial_validation_frame_t* frame = (depth > 0) ? &frames[depth - 1] : NULL;
+		uint32_t type = XPC_SERIAL_TYPE_INVALID;
+		const xpc_serial_vtable_t* vtable = NULL;
+
+		if (frame != NULL) {
+			if (frame->remaining == 0) {
+				// containers must contain exactly what they say they do
+				if (this->offset != frame->end) {
+					goto out;
+				}
+				--depth;
+				continue;
+			}
+			--frame->remaining;
+			if (frame->keyed && ![self readString: NULL]) {
+				goto out;
+			}
+		} else if (sawRoot) {
+			break;
+		} else {
+			sawRoot = YES;
+		}
+
+		if (this->limits.max_objects != 0 && ++objectCount > this->limits.max_objects) {
+			goto out;
+		}
+
+		if (![self peekU32: &type]) {
+			goto out;
+		}
+
+		switch (type) {
+			case XPC_SERIAL_TYPE_ARRAY:
+			case XPC_SERIAL_TYPE_DICT: {
+				uint32_t contentLength = 0;
+				uint32_t entryCount = 0;
+				size_t contentStartOffset = 0;
+				bool keyed = type == XPC_SERIAL_TYPE_DICT;
+
+				if (!deserial_can_nest(this, depth)) {
+					goto out;
+				}
+
+				if (![self readU32: NULL] || ![self readU32: &contentLength]) {
+					goto out;
+				}
+
+				// the entry count is included in the content length
+				contentStartOffset = this->offset;
+				if (contentLength < sizeof(uint32_t) || contentLength > this->length - contentStartOffset) {
+					goto out;
+				}
+
+				if (![self readU32: &entryCount]) {
+					goto out;
+				}
+
+				// every entry needs at least a type (and, for dictionaries, a padded key), so a bogus count can be rejected right away
+				if (entryCount > (contentLength - sizeof(uint32_t)) / (keyed ? 2 * sizeof(uint32_t) : sizeof(uint32_t))) {
+					goto out;
+				}
+
+				if (depth == frameCapacity && !serial_frames_grow((void**)&frames, inlineFrames, &frameCapacity, depth, sizeof(*frames))) {
+					goto out;
+				}
+
+				frames[depth].end = contentStartOffset + contentLength;
+				frames[depth].remaining = entryCount;
+				frames[depth].keyed = keyed;
+				++depth;
+			} break;
+
+			// these only carry a port, which lives in the descriptors rather than in the content
+			case XPC_SERIAL_TYPE_FD:
+			case XPC_SERIAL_TYPE_MACH_SEND:
+			case XPC_SERIAL_TYPE_MACH_RECV:
+			case XPC_SERIAL_TYPE_ENDPOINT: {
+				if (![self readU32: NULL]) {
+					goto out;
+				}
+			} break;
+
+			default: {
+				vtable = xpc_serial_vtable_for_type(type);
+				if (vtable == NULL) {
+					goto out;
+				}
+				if ((type & XPC_SERIAL_TYPE_FLAG_OOL) != 0) {
+					if (![self validateOOL: type]) {
+						goto out;
+					}
+				} else if (vtable->skip == NULL || !vtable->skip(vtable->class, @selector(skip:), self)) {
+					goto out;
+				}
+			} break;
+		}
+	}
+
+	valid = YES;
+
+out:
+	if (frames != inlineFrames) {
+		free(frames);
+	}
+	this->offset = savedOffset;
+	return valid;
+}
+
+- (BOOL)readObjectAtOffset: (NSUInteger)offset into: (XPC_CLASS(object)**)slot
+{
+	XPC_THIS_DECL(deserializer);
+	XPC_CLASS(object)* result = nil;
+	size_t savedOffset = 0;
+	size_t savedObjectCount = 0;
+
+	os_unfair_lock_lock(&this->lazy_lock);
+
+	if (xpc_object_slot_load(slot) == nil) {
+		// skipped objects were already counted towards the object limit when they were skipped
+		savedOffset = this->offset;
+		savedObjectCount = this->object_count;
+		this->offset = offset;
+		this->object_count = 0;
+		if ([self readObject: &result]) {
+			// readers check the slot without taking our lock, so the object has to be fully created before they can see it
+			xpc_object_slot_publish(slot, result);
+		}
+		this->offset = savedOffset;
+		this->object_count = savedObjectCount;
+	}
+
+	result = xpc_object_slot_load(slot);
+
+	os_unfair_lock_unlock(&this->lazy_lock);
+
+	return result != nil;
+}
+
+- (const void*)contentAtOffset: (NSUInteger)offset
+{
+	XPC_THIS_DECL(deserializer);
+	return &this->buffer[offset];
+}
+
+- (BOOL)readOOL: (NSUInteger)length data: (dispatch_data_t*)data region: (const void**)region
+{
+	XPC_THIS_DECL(deserializer);
+	uint32_t index = 0;
+	xpc_deserial_ool_region_t* ool_region = NULL;
+	void* address = NULL;
+	size_t size = 0;
+	dispatch_data_t result = NULL;
+
+	if (![self readU32: &index]) {
+		return NO;
+	}
+
+	if (index >= this->ool_region_count) {
+		return NO;
+	}
+
+	ool_region = &this->ool_regions[index];
+
+	// a sender never sends empty content out-of-line, and each region can only back a single object
+	if (ool_region->address == NULL || length == 0 || length > ool_region->size) {
+		return NO;
+	}
+
+	address = ool_region->address;
+	size = ool_region->size;
+
+	result = dispatch_data_create(address, length, NULL, ^{
+		vm_deallocate(mach_task_self(), (vm_address_t)address, size);
+	});
+	if (result == NULL) {
+		return NO;
+	}
+
+	// the data object owns the region now
+	ool_region->address = NULL;
+
+	if (region != NULL) {
+		*region = address;
+	}
+
+	if (data != NULL) {
+		*data = result;
+	} else {
+		dispatch_release(result);
+	}
+
+	return YES;
+}
+
+- (dispatch_data_t)borrowRegion: (const void*)region length: (NSUInteger)length
+{
+	XPC_THIS_DECL(deserializer);
+	dispatch_mach_msg_t message = this->mach_msg;
+
+	if (this->borrow_threshold == 0 || length < this->borrow_threshold) {
+		return NULL;
+	}
+
+	// the data object keeps the message (and therefore the region) alive
+	dispatch_retain(message);
+	return dispatch_data_create(region, length, NULL, ^{
+		dispatch_release(message);
+	});
+}
+
 - (BOOL)peek: (void*)data length: (NSUInteger)length
 {
 	XPC_THIS_DECL(deserializer);
@@ -771,6 +1849,20 @@ error_out:
 
 + (XPC_CLASS(dictionary)*)process: (dispatch_mach_msg_t)message
 {
+	return [self process: message validate: NO];
+}
+
++ (XPC_CLASS(dictionary)*)process: (dispatch_mach_msg_t)message validate: (BOOL)validate
+{
+	return [self process: message validate: validate limits: NULL];
+}
+
++ (XPC_CLASS(dictionary)*)process: (dispatch_mach_msg_t)message validate: (BOOL)validate limits: (const xpc_deserial_limits_t*)limits
+{
+	// the deserializer consumes the message, so we have to remember the reply right before it does
+	mach_msg_header_t* header = dispatch_mach_msg_get_msg(message, NULL);
+	mach_port_t replyPort = header->msgh_remote_port;
+	mach_msg_type_name_t replyType = MACH_MSGH_BITS_REMOTE(header->msgh_bits);
 	XPC_CLASS(deserializer)* deserializer = [[[self class] alloc] initWithMessage: message];
 	XPC_CLASS(dictionary)* dict = nil;
 
@@ -778,6 +1870,14 @@ error_out:
 		goto error_out;
 	}
 
+	if (limits != NULL) {
+		deserializer.limits = *limits;
+	}
+
+	if (validate && ![deserializer validate]) {
+		goto error_out;
+	}
+
 	if (![deserializer readObject: &dict]) {
 		goto error_out;
 	}
@@ -792,6 +1892,11 @@ error_out:
 	return [dict autorelease];
 
 error_out:
+	// nobody's going to reply, and destroying the reply right lets the sender know that
+	// (otherwise, it would wait for a reply forever and the right would leak)
+	if (MACH_PORT_VALID(replyPort)) {
+		xpc_mach_port_release_right(replyPort, xpc_mach_msg_type_name_to_port_right(replyType));
+	}
 	[dict release];
 	[deserializer release];
 	return nil;
@@ -21,9 +21,61 @@
 #import <xpc/util.h>
 #import <xpc/xpc.h>
 #import <xpc/serialization.h>
+#import <xpc/private.h>
 
 XPC_CLASS_SYMBOL_DECL(string);
 
+// returns a buffer that can hold a string of (at least) the given length plus its terminator, and stores its actual capacity into `capacity`:
+// our inline buffer if it fits in there, otherwise a new allocation that we have to free once we're done with it
+static char* string_buffer_for_length(struct xpc_string_s* this, NSUInteger byteLength, NSUInteger* capacity, BOOL* freeWhenDone) {
+	if (byteLength < XPC_STRING_INLINE_CAPACITY) {
+		*freeWhenDone = NO;
+		*capacity = XPC_STRING_INLINE_CAPACITY - 1;
+		return this->inline_string;
+	}
+	*freeWhenDone = YES;
+	*capacity = byteLength;
+	return malloc(byteLength + 1);
+};
+
+// whether we own our current buffer, so it can be written to (up to `capacity`)
+static BOOL string_is_writable(struct xpc_string_s* this) {
+	return this->string == this->inline_string || (this->freeWhenDone && this->string && !this->backing);
+};
+
+// replaces our current storage with the given buffer (as returned by `string_buffer_for_length`), which already contains the new string
+static void string_set_buffer(struct xpc_string_s* this, char* buffer, NSUInteger byteLength, NSUInteger capacity, BOOL freeWhenDone) {
+	if (this->freeWhenDone && this->string && this->string != buffer) {
+		free((void*)this->string);
+	}
+	if (this->backing) {
+		dispatch_release(this->backing);
+		this->backing = NULL;
+	}
+	buffer[byteLength] = '\0';
+	this->string = buffer;
+	this->byteLength = byteLength;
+	this->capacity = capacity;
+	this->freeWhenDone = freeWhenDone;
+	// if nobody has hashed us yet, no container can have cached our hash either (see `xpc_leaf_generation`)
+	if (atomic_exchange_explicit(&this->cached_hash, 0, memory_order_relaxed) != 0) {
+		xpc_leaf_generation_advance();
+	}
+};
+
+// copies the given string into a new buffer for a string that doesn't have one yet
+static BOOL string_init_with_bytes(struct xpc_string_s* this, const char* string, NSUInteger byteLength) {
+	NSUInteger capacity = 0;
+	BOOL freeWhenDone = NO;
+	char* buf = string_buffer_for_length(this, byteLength, &capacity, &freeWhenDone);
+	if (!buf) {
+		return NO;
+	}
+	strncpy(buf, string, byteLength);
+	string_set_buffer(this, buf, byteLength, capacity, freeWhenDone);
+	return YES;
+};
+
 OS_OBJECT_NONLAZY_CLASS
 @implementation XPC_CLASS(string)
 
@@ -59,6 +111,9 @@ XPC_CLASS_HEADER(string);
 	if (this->freeWhenDone && this->string) {
 		free((void*)this->string);
 	}
+	if (this->backing) {
+		dispatch_release(this->backing);
+	}
 	[super dealloc];
 }
 
@@ -73,12 +128,22 @@ XPC_CLASS_HEADER(string);
 	return output;
 }
 
-- (NSUInteger)byteLength
+- (void)describeTo: (xpc_description_writer_t*)writer
 {
 	XPC_THIS_DECL(string);
-	if (this->byteLength == NSUIntegerMax) {
-		return strlen(this->string);
+	// written directly so that long strings don't need to be copied (and can be cut off by the writer's limits)
+	xpc_description_printf(writer, "<%s: ", xpc_class_name(self));
+	if (this->string) {
+		xpc_description_write(writer, this->string, this->byteLength);
+	} else {
+		xpc_description_write(writer, "NULL", 4);
 	}
+	xpc_description_write(writer, ">", 1);
+}
+
+- (NSUInteger)byteLength
+{
+	XPC_THIS_DECL(string);
 	return this->byteLength;
 }
 
@@ -96,18 +161,10 @@ XPC_CLASS_HEADER(string);
 - (instancetype)initWithCString: (const char*)string byteLength: (NSUInteger)byteLength
 {
 	if (self = [super init]) {
-		XPC_THIS_DECL(string);
-
-		this->byteLength = byteLength;
-		char* buf = malloc(this->byteLength + 1);
-		if (!buf) {
+		if (!string_init_with_bytes(XPC_THIS(string), string, byteLength)) {
 			[self release];
 			return nil;
 		}
-		strncpy(buf, string, this->byteLength);
-		buf[this->byteLength] = '\0';
-		this->string = buf;
-		this->freeWhenDone = YES;
 	}
 	return self;
 }
@@ -125,6 +182,8 @@ XPC_CLASS_HEADER(string);
 		this->byteLength = byteLength;
 		this->string = string;
 		this->freeWhenDone = freeIt;
+		// if the buffer is ours now, we can at least write over what's already there
+		this->capacity = freeIt ? byteLength : 0;
 	}
 	return self;
 }
@@ -134,6 +193,27 @@ XPC_CLASS_HEADER(string);
 	return [self initWithCStringNoCopy: string byteLength: strlen(string) freeWhenDone: freeIt];
 }
 
+- (instancetype)initWithCStringNoCopy: (const char*)string byteLength: (NSUInteger)byteLength backing: (dispatch_object_t)backing
+{
+	if (self = [self initWithCStringNoCopy: string byteLength: byteLength freeWhenDone: NO]) {
+		XPC_THIS_DECL(string);
+		this->backing = backing;
+		dispatch_retain(this->backing);
+	}
+	return self;
+}
+
+- (instancetype)initWithBuffer: (char*)buffer byteLength: (NSUInteger)byteLength capacity: (NSUInteger)capacity
+{
+	if (self = [super init]) {
+		XPC_THIS_DECL(string);
+		string_set_buffer(this, buffer, byteLength, capacity, YES);
+	} else {
+		free(buffer);
+	}
+	return self;
+}
+
 - (instancetype)initWithFormat: (const char*)format, ...
 {
 	va_list args;
@@ -147,14 +227,33 @@ XPC_CLASS_HEADER(string);
 {
 	if (self = [super init]) {
 		XPC_THIS_DECL(string);
+		va_list argsCopy;
+		int length = 0;
+
+		// try to format it straight into the inline buffer first; most formatted strings are short
+		va_copy(argsCopy, args);
+		length = vsnprintf(this->inline_string, sizeof(this->inline_string), format, argsCopy);
+		va_end(argsCopy);
 
-		vasprintf((char**)&this->string, format, args);
-		if (!this->string) {
+		if (length < 0) {
 			[self release];
 			return nil;
 		}
-		this->byteLength = strlen(this->string);
-		this->freeWhenDone = YES;
+
+		if ((size_t)length < sizeof(this->inline_string)) {
+			this->string = this->inline_string;
+			this->byteLength = length;
+			this->capacity = XPC_STRING_INLINE_CAPACITY - 1;
+		} else {
+			if (vasprintf((char**)&this->string, format, args) < 0) {
+				this->string = NULL;
+				[self release];
+				return nil;
+			}
+			this->byteLength = length;
+			this->capacity = length;
+			this->freeWhenDone = YES;
+		}
 	}
 	return self;
 }
@@ -163,24 +262,38 @@ XPC_CLASS_HEADER(string);
 {
 	XPC_THIS_DECL(string);
 	size_t newByteLength = strlen(string);
-	char* newString = malloc(newByteLength + 1);
-	if (!newString) {
-		return;
-	}
-	if (this->freeWhenDone && this->string) {
-		free((void*)this->string);
+	NSUInteger capacity = this->capacity;
+	BOOL freeWhenDone = this->freeWhenDone;
+	char* newString = (char*)this->string;
+	if (!string_is_writable(this) || newByteLength > capacity) {
+		newString = string_buffer_for_length(this, newByteLength, &capacity, &freeWhenDone);
+		if (!newString) {
+			return;
+		}
 	}
-	this->byteLength = newByteLength;
-	strncpy(newString, string, this->byteLength);
-	newString[this->byteLength] = '\0';
-	this->string = newString;
-	this->freeWhenDone = true;
+	// the new string might be (part of) the current one
+	memmove(newString, string, newByteLength);
+	string_set_buffer(this, newString, newByteLength, capacity, freeWhenDone);
 }
 
 - (NSUInteger)hash
 {
 	XPC_THIS_DECL(string);
-	return xpc_raw_data_hash(this->string, self.byteLength + 1);
+	size_t result = atomic_load_explicit(&this->cached_hash, memory_order_relaxed);
+	if (result == 0) {
+		result = xpc_raw_data_hash(this->string, this->byteLength);
+		// global objects (like the ones `XPC_ACTIVITY_CHECK_IN` points to) may be in read-only memory, so they just recompute it every time
+		if (!XPC_OBJECT_IS_GLOBAL(this)) {
+			atomic_store_explicit(&this->cached_hash, result, memory_order_relaxed);
+		}
+	}
+	return result;
+}
+
+- (BOOL)isEqualToObject: (XPC_CLASS(object)*)object
+{
+	XPC_CLASS(string)* other = XPC_CAST(string, object);
+	return self.byteLength == other.byteLength && memcmp(self.CString, other.CString, self.byteLength) == 0;
 }
 
 - (instancetype)forceCopy
@@ -188,27 +301,38 @@ XPC_CLASS_HEADER(string);
 	return [[[self class] alloc] initWithCString: self.CString];
 }
 
+- (instancetype)copy
+{
+	XPC_THIS_DECL(string);
+	if (this->backing) {
+		// a long-lived copy shouldn't keep the entire message it came from alive
+		return [[[self class] alloc] initWithCString: this->string byteLength: self.byteLength];
+	}
+	return [super copy];
+}
+
 - (void)appendString: (const char*)string length: (NSUInteger)extraByteLength
 {
 	if (extraByteLength == 0) {
 		return;
 	}
 	XPC_THIS_DECL(string);
-	size_t oldByteLength = self.byteLength;
+	size_t oldByteLength = this->byteLength;
 	size_t newByteLength = oldByteLength + extraByteLength;
-	char* newString = malloc(newByteLength + 1);
-	if (!newString) {
-		return;
-	}
-	strncpy(newString, this->string, oldByteLength);
-	if (this->freeWhenDone && this->string) {
-		free((void*)this->string);
+	NSUInteger capacity = this->capacity;
+	BOOL freeWhenDone = this->freeWhenDone;
+	char* newString = (char*)this->string;
+	if (!string_is_writable(this) || newByteLength > capacity) {
+		// grow geometrically, so that building up a string piece by piece only copies it a constant number of times on average
+		newString = string_buffer_for_length(this, MAX(newByteLength, oldByteLength * 2), &capacity, &freeWhenDone);
+		if (!newString) {
+			return;
+		}
+		memcpy(newString, this->string, oldByteLength);
 	}
-	this->byteLength = newByteLength;
-	strncpy(newString + oldByteLength, string, extraByteLength);
-	newString[newByteLength] = '\0';
-	this->string = newString;
-	this->freeWhenDone = true;
+	// the appended string might be (part of) the current one, so it has to be copied before the current one is freed
+	memmove(newString + oldByteLength, string, extraByteLength);
+	string_set_buffer(this, newString, newByteLength, capacity, freeWhenDone);
 }
 
 - (void)appendString: (const char*)string
@@ -240,17 +364,28 @@ XPC_CLASS_HEADER(string);
 	return xpc_serial_padded_length(sizeof(xpc_serial_type_t)) + xpc_serial_padded_length(sizeof(uint32_t)) + xpc_serial_padded_length(self.byteLength + 1);
 }
 
+- (NSUInteger)serializationLengthWithSerializer: (XPC_CLASS(serializer)*)serializer
+{
+	if (serializer && [serializer shouldWriteOOL: self.byteLength + 1]) {
+		// only the length and descriptor index are written inline
+		return xpc_serial_padded_length(sizeof(xpc_serial_type_t)) + xpc_serial_padded_length(sizeof(uint32_t)) + xpc_serial_padded_length(sizeof(uint32_t));
+	}
+	return self.serializationLength;
+}
+
 + (instancetype)deserialize: (XPC_CLASS(deserializer)*)deserializer
 {
 	XPC_CLASS(string)* result = nil;
 	xpc_serial_type_t type = XPC_SERIAL_TYPE_INVALID;
 	uint32_t length = 0;
 	const char* string = NULL;
+	dispatch_data_t ddata = NULL;
+	NSUInteger byteLength = 0;
 
 	if (![deserializer readU32: &type]) {
 		goto error_out;
 	}
-	if (type != XPC_SERIAL_TYPE_STRING) {
+	if ((type & ~XPC_SERIAL_TYPE_FLAG_OOL) != XPC_SERIAL_TYPE_STRING) {
 		goto error_out;
 	}
 
@@ -258,13 +393,41 @@ XPC_CLASS_HEADER(string);
 		goto error_out;
 	}
 
+	if (type & XPC_SERIAL_TYPE_FLAG_OOL) {
+		// the region includes the null terminator, but don't trust the sender to have included it
+		if (length == UINT32_MAX || ![deserializer readOOL: length + 1 data: &ddata region: (const void**)&string]) {
+			goto error_out;
+		}
+
+		// the region was mapped just for this string, so there's no harm in keeping it around
+		byteLength = strnlen(string, length);
+		if (string[byteLength] == '\0') {
+			result = [[[self class] alloc] initWithCStringNoCopy: string byteLength: byteLength backing: ddata];
+		} else {
+			result = [[[self class] alloc] initWithCString: string byteLength: byteLength];
+		}
+		dispatch_release(ddata);
+
+		return result;
+	}
+
 	if (![deserializer readString: &string]) {
 		goto error_out;
 	}
 
 	// maybe we should check if the string length matches the reported length
 
-	result = [[[self class] alloc] initWithCString: string];
+	byteLength = strlen(string);
+	// short strings are copied into the object itself, which is cheaper than keeping the message alive
+	if (byteLength >= XPC_STRING_INLINE_CAPACITY) {
+		ddata = [deserializer borrowRegion: string length: byteLength + 1];
+	}
+	if (ddata != NULL) {
+		result = [[[self class] alloc] initWithCStringNoCopy: string byteLength: byteLength backing: ddata];
+		dispatch_release(ddata);
+	} else {
+		result = [[[self class] alloc] initWithCString: string byteLength: byteLength];
+	}
 
 	return result;
 
@@ -275,8 +438,43 @@ error_out:
 	return nil;
 }
 
++ (BOOL)skip: (XPC_CLASS(deserializer)*)deserializer
+{
+	xpc_serial_type_t type = XPC_SERIAL_TYPE_INVALID;
+
+	if (![deserializer readU32: &type]) {
+		return NO;
+	}
+	if (type != XPC_SERIAL_TYPE_STRING) {
+		return NO;
+	}
+
+	// OOL strings are never skipped (see the note in `XPCSerializationSkipping`), so this only needs to handle inline strings
+	if (![deserializer readU32: NULL]) {
+		return NO;
+	}
+
+	return [deserializer readString: NULL];
+}
+
 - (BOOL)serialize: (XPC_CLASS(serializer)*)serializer
 {
+	if ([serializer shouldWriteOOL: self.byteLength + 1]) {
+		if (![serializer writeU32: XPC_SERIAL_TYPE_STRING | XPC_SERIAL_TYPE_FLAG_OOL]) {
+			goto error_out;
+		}
+
+		if (![serializer writeU32: self.byteLength]) {
+			goto error_out;
+		}
+
+		if (![serializer writeOOL: self.CString length: self.byteLength + 1]) {
+			goto error_out;
+		}
+
+		return YES;
+	}
+
 	if (![serializer writeU32: XPC_SERIAL_TYPE_STRING]) {
 		goto error_out;
 	}
@@ -359,7 +557,12 @@ error_out:
 
 XPC_EXPORT
 xpc_object_t xpc_string_create(const char* string) {
-	return [[XPC_CLASS(string) alloc] initWithCString: string];
+	XPC_CLASS(string)* result = XPC_OBJECT_ALLOC(string);
+	if (result != nil && !string_init_with_bytes((struct xpc_string_s*)result, string, strlen(string))) {
+		[result release];
+		return NULL;
+	}
+	return result;
 };
 
 XPC_EXPORT
@@ -379,7 +582,7 @@ xpc_object_t xpc_string_create_with_format_and_arguments(const char* format, va_
 XPC_EXPORT
 size_t xpc_string_get_length(xpc_object_t xstring) {
 	TO_OBJC_CHECKED(string, xstring, string) {
-		return string.byteLength;
+		return ((struct xpc_string_s*)string)->byteLength;
 	}
 	return 0;
 };
@@ -387,7 +590,7 @@ size_t xpc_string_get_length(xpc_object_t xstring) {
 XPC_EXPORT
 const char* xpc_string_get_string_ptr(xpc_object_t xstring) {
 	TO_OBJC_CHECKED(string, xstring, string) {
-		return string.CString;
+		return ((struct xpc_string_s*)string)->string;
 	}
 	return NULL;
 };
@@ -407,3 +610,132 @@ XPC_EXPORT
 xpc_object_t xpc_string_create_no_copy(const char* string) {
 	return [[XPC_CLASS(string) alloc] initWithCStringNoCopy: string freeWhenDone: NO];
 };
+
+//
+// string builder
+//
+
+// makes room for `extra` more bytes (plus the null terminator), growing the buffer geometrically
+static bool string_builder_reserve(xpc_string_builder_t* builder, size_t extra) {
+	size_t needed = 0;
+	size_t capacity = 0;
+	char* buffer = NULL;
+
+	if (builder->failed) {
+		return false;
+	}
+	if (builder->buffer != NULL && extra <= builder->capacity - builder->length) {
+		return true;
+	}
+
+	if (__builtin_add_overflow(builder->length, extra, &needed) || needed == SIZE_MAX) {
+		builder->failed = true;
+		return false;
+	}
+	capacity = MAX(MAX(needed, builder->capacity * 2), XPC_STRING_INLINE_CAPACITY);
+
+	buffer = realloc(builder->buffer, capacity + 1);
+	if (!buffer) {
+		builder->failed = true;
+		return false;
+	}
+
+	builder->buffer = buffer;
+	builder->capacity = capacity;
+	return true;
+};
+
+XPC_EXPORT
+void xpc_string_builder_init(xpc_string_builder_t* builder, size_t capacity) {
+	builder->buffer = NULL;
+	builder->length = 0;
+	builder->capacity = 0;
+	builder->failed = false;
+	if (capacity > 0) {
+		string_builder_reserve(builder, capacity);
+	}
+};
+
+XPC_EXPORT
+bool xpc_string_builder_append(xpc_string_builder_t* builder, const char* string, size_t length) {
+	// `string` might point into our own buffer, which might move when it grows
+	bool aliased = builder->buffer != NULL && string >= builder->buffer && string < builder->buffer + builder->length;
+	size_t aliasedOffset = aliased ? (size_t)(string - builder->buffer) : 0;
+
+	if (!string_builder_reserve(builder, length)) {
+		return false;
+	}
+	if (aliased) {
+		string = builder->buffer + aliasedOffset;
+	}
+
+	memmove(builder->buffer + builder->length, string, length);
+	builder->length += length;
+	return true;
+};
+
+XPC_EXPORT
+bool xpc_string_builder_append_format_v(xpc_string_builder_t* builder, const char* format, va_list args) {
+	va_list argsCopy;
+	int length = 0;
+
+	if (builder->failed) {
+		return false;
+	}
+
+	// try to format it straight into the space we have left; if that's not enough, we'll know exactly how much we need
+	va_copy(argsCopy, args);
+	length = vsnprintf(builder->buffer ? builder->buffer + builder->length : NULL, builder->buffer ? builder->capacity - builder->length + 1 : 0, format, argsCopy);
+	va_end(argsCopy);
+
+	if (length < 0) {
+		builder->failed = true;
+		return false;
+	}
+
+	if (builder->buffer == NULL || (size_t)length > builder->capacity - builder->length) {
+		if (!string_builder_reserve(builder, length)) {
+			return false;
+		}
+		vsnprintf(builder->buffer + builder->length, builder->capacity - builder->length + 1, format, args);
+	}
+
+	builder->length += length;
+	return true;
+};
+
+XPC_EXPORT
+bool xpc_string_builder_append_format(xpc_string_builder_t* builder, const char* format, ...) {
+	va_list args;
+	bool result = false;
+	va_start(args, format);
+	result = xpc_string_builder_append_format_v(builder, format, args);
+	va_end(args);
+	return result;
+};
+
+XPC_EXPORT
+xpc_object_t xpc_string_builder_finish(xpc_string_builder_t* builder) {
+	xpc_object_t result = NULL;
+
+	if (!builder->failed) {
+		if (builder->length < XPC_STRING_INLINE_CAPACITY) {
+			// short strings fit into the object itself, so there's no point in keeping the buffer around
+			result = [[XPC_CLASS(string) alloc] initWithCString: builder->buffer ? builder->buffer : "" byteLength: builder->length];
+			free(builder->buffer);
+		} else {
+			// the string takes over the buffer (and frees it if it fails)
+			result = [[XPC_CLASS(string) alloc] initWithBuffer: builder->buffer byteLength: builder->length capacity: builder->capacity];
+		}
+		builder->buffer = NULL;
+	}
+
+	xpc_string_builder_destroy(builder);
+	return result;
+};
+
+XPC_EXPORT
+void xpc_string_builder_destroy(xpc_string_builder_t* builder) {
+	free(builder->buffer);
+	xpc_string_builder_init(builder, 0);
+};
@@ -125,6 +125,20 @@ void xpc_transaction_end(void) {
 };
 
 
+// keys used for every launchd routine; these are looked up often enough that it's worth precomputing them
+static xpc_key_t interface_key_subsystem;
+static xpc_key_t interface_key_routine;
+static xpc_key_t interface_key_pre_exec;
+static xpc_key_t interface_key_error;
+static dispatch_once_t interface_keys_once;
+
+static void interface_keys_init(void* context) {
+    interface_key_subsystem = xpc_dictionary_key_create("subsystem");
+    interface_key_routine = xpc_dictionary_key_create("routine");
+    interface_key_pre_exec = xpc_dictionary_key_create("pre-exec");
+    interface_key_error = xpc_dictionary_key_create("error");
+}
+
 // FIXME: complete this
 int
 xpc_interface_routine(int subsystem, int routine, xpc_object_t msg, xpc_object_t* out, int a5, char *a6)
@@ -138,13 +152,14 @@ xpc_interface_routine(int subsystem, int routine, xpc_object_t msg, xpc_object_t
     if (globals->_is_launchd_client || globals->_null_boostrap)
       return r;
     
-    xpc_dictionary_set_uint64(msg, "subsystem", subsystem);
-    xpc_dictionary_set_uint64(msg, "routine", routine);
+    dispatch_once_f(&interface_keys_once, NULL, interface_keys_init);
+    xpc_dictionary_set_uint64_k(msg, interface_key_subsystem, subsystem);
+    xpc_dictionary_set_uint64_k(msg, interface_key_routine, routine);
     if (globals->_pre_exec_set)
-      xpc_dictionary_set_bool(msg, "pre-exec", 1);
+      xpc_dictionary_set_bool_k(msg, interface_key_pre_exec, 1);
     r = xpc_pipe_routine((xpc_pipe_t)globals->bootstrap_pipe, msg, &response);
     if (!r) {
-        r = xpc_dictionary_get_int64(msg, "error");
+        r = xpc_dictionary_get_int64_k(msg, interface_key_error);
         xpc_dictionary_get_audit_token(response, &token);
 //        if (token.pid!= 1 token.euid) { return 118; }
     }
@@ -27,7 +27,9 @@
 
 XPC_EXPORT
 xpc_type_t xpc_get_type(xpc_object_t xobject) {
-	TO_OBJC_CHECKED(object, xobject, object) {
+	// the base class has no `_xpc_type_object` symbol, so this uses a regular (messaging) check
+	XPC_CLASS(object)* object = XPC_CAST(object, xobject);
+	if ([object isKindOfClass: [XPC_CLASS(object) class]]) {
 		return (xpc_type_t)[object class];
 	}
 	return NULL;
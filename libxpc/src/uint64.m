@@ -23,7 +23,34 @@
 #import <xpc/serialization.h>
 
 XPC_WRAPPER_CLASS_IMPL(uint64, uint64_t, "%llu");
-XPC_WRAPPER_CLASS_SERIAL_IMPL(uint64, uint64_t, UINT64, U64, uint64_t);
+XPC_WRAPPER_CLASS_SERIAL_IMPL(uint64, uint64_t, UINT64, U64, uint64_t, xpc_uint64_create_shared);
+
+// like with int64s (see `int64.m`), small values have global objects so that creating them never allocates
+#define IMMORTAL_UINT64_MAX 1023
+#define IMMORTAL_UINT64_COUNT (IMMORTAL_UINT64_MAX + 1)
+
+static struct xpc_uint64_s immortal_uint64s[IMMORTAL_UINT64_COUNT] = {
+	[0 ... IMMORTAL_UINT64_COUNT - 1] = {
+		.base = {
+			XPC_GLOBAL_OBJECT_HEADER(uint64),
+		},
+	},
+};
+static dispatch_once_t immortal_uint64s_once;
+
+static void immortal_uint64s_init(void* context) {
+	for (uint64_t i = 0; i < IMMORTAL_UINT64_COUNT; ++i) {
+		immortal_uint64s[i].value = i;
+	}
+};
+
+xpc_object_t xpc_uint64_create_shared(uint64_t value) {
+	if (value <= IMMORTAL_UINT64_MAX) {
+		dispatch_once_f(&immortal_uint64s_once, NULL, immortal_uint64s_init);
+		return XPC_CAST(uint64, &immortal_uint64s[value]);
+	}
+	return xpc_uint64_alloc_with_value(value);
+};
 
 //
 // C API
@@ -31,13 +58,13 @@ XPC_WRAPPER_CLASS_SERIAL_IMPL(uint64, uint64_t, UINT64, U64, uint64_t);
 
 XPC_EXPORT
 xpc_object_t xpc_uint64_create(uint64_t value) {
-	return [[XPC_CLASS(uint64) alloc] initWithValue: value];
+	return xpc_uint64_alloc_with_value(value);
 };
 
 XPC_EXPORT
 uint64_t xpc_uint64_get_value(xpc_object_t xuint) {
 	TO_OBJC_CHECKED(uint64, xuint, uinteger) {
-		return uinteger.value;
+		return ((struct xpc_uint64_s*)uinteger)->value;
 	}
 	return 0;
 };
@@ -22,9 +22,19 @@
 #import <xpc/serialization.h>
 #include <sys/reason.h>
 #import <xpc/objects/connection.h>
+#import <xpc/objects/dictionary.h>
+#import <xpc/objects/array.h>
+#import <xpc/objects/mach_send.h>
+#import <xpc/objects/mach_recv.h>
 #include <sys/stat.h>
 #include <stdio.h>
 #include <mach-o/dyld.h>
+#include <sys/param.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
 
 static bool verbose_stub_messages = false;
 
@@ -67,46 +77,727 @@ const char* xpc_class_name(XPC_CLASS(object)* object) {
 	return class_getName([object class]);
 };
 
-char* xpc_description_indent(const char* description, bool indentFirstLine) {
-	size_t newSize = 0;
-	for (size_t i = 0; description[i] != '\0'; ++i) {
-		++newSize;
-		if (description[i] == '\n') {
-			++newSize;
+static void description_writer_init(xpc_description_writer_t* writer, FILE* file, int fd, const xpc_description_limits_t* limits) {
+	memset(writer, 0, sizeof(*writer));
+	if (limits != NULL) {
+		writer->limits = *limits;
+	}
+	writer->file = file;
+	writer->fd = fd;
+};
+
+void xpc_description_writer_init(xpc_description_writer_t* writer, const xpc_description_limits_t* limits) {
+	description_writer_init(writer, NULL, -1, limits);
+};
+
+void xpc_description_writer_init_file(xpc_description_writer_t* writer, FILE* file, const xpc_description_limits_t* limits) {
+	description_writer_init(writer, file, -1, limits);
+};
+
+void xpc_description_writer_init_fd(xpc_description_writer_t* writer, int fd, const xpc_description_limits_t* limits) {
+	description_writer_init(writer, NULL, fd, limits);
+};
+
+static void description_writer_write_fd(xpc_description_writer_t* writer, const char* data, size_t length) {
+	while (length > 0) {
+		ssize_t result = write(writer->fd, data, length);
+		if (result < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			writer->failed = true;
+			return;
 		}
+		data += result;
+		length -= result;
 	}
-	if (indentFirstLine) {
-		++newSize;
+};
+
+static void description_writer_flush(xpc_description_writer_t* writer) {
+	if (writer->fd_buffer_used > 0) {
+		description_writer_write_fd(writer, writer->fd_buffer, writer->fd_buffer_used);
+		writer->fd_buffer_used = 0;
 	}
-	char* newDescription = malloc(sizeof(char) * (newSize + 1));
-	if (indentFirstLine) {
-		newDescription[0] = '\t';
+};
+
+// sends output to wherever it's supposed to go, without any indentation or limits
+static void description_writer_output(xpc_description_writer_t* writer, const char* data, size_t length) {
+	if (writer->failed || length == 0) {
+		return;
 	}
-	for (size_t i = 0, j = indentFirstLine ? 1 : 0; description[i] != '\0'; ++i, ++j) {
-		newDescription[j] = description[i];
-		if (description[i] == '\n') {
-			newDescription[++j] = '\t';
+
+	if (writer->file != NULL) {
+		if (fwrite(data, 1, length, writer->file) != length) {
+			writer->failed = true;
 		}
+	} else if (writer->fd >= 0) {
+		// descriptions are written in lots of small pieces, so batch them up rather than making a syscall for each one
+		if (writer->fd_buffer_used + length > sizeof(writer->fd_buffer)) {
+			description_writer_flush(writer);
+		}
+		if (length >= sizeof(writer->fd_buffer)) {
+			description_writer_write_fd(writer, data, length);
+		} else {
+			memcpy(writer->fd_buffer + writer->fd_buffer_used, data, length);
+			writer->fd_buffer_used += length;
+		}
+	} else if (!xpc_string_builder_append(&writer->builder, data, length)) {
+		writer->failed = true;
 	}
-	newDescription[newSize] = '\0';
-	return newDescription;
 };
 
-size_t xpc_raw_data_hash(const void* data, size_t data_length) {
-	if (data_length == 0) {
-		return 0x1505;
-	}
-	size_t result = 0;
-	for (size_t i = 0; i < data_length; ++i) {
-		uint8_t current = ((uint8_t*)data)[i];
-		if (current == 0) {
-			break;
+// like `description_writer_output`, but stays within `limits.max_bytes`
+static void description_writer_emit(xpc_description_writer_t* writer, const char* data, size_t length) {
+	if (writer->limits.max_bytes > 0 && length > writer->limits.max_bytes - writer->written) {
+		length = writer->limits.max_bytes - writer->written;
+		writer->truncated = true;
+	}
+	description_writer_output(writer, data, length);
+	writer->written += length;
+};
+
+void xpc_description_write(xpc_description_writer_t* writer, const char* string, size_t length) {
+	static const char tabs[] = "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t";
+
+	while (length > 0 && !xpc_description_writer_is_done(writer)) {
+		const char* newline = NULL;
+		size_t lineLength = 0;
+
+		if (writer->at_line_start) {
+			for (size_t remaining = writer->depth; remaining > 0 && !writer->truncated;) {
+				size_t chunk = MIN(remaining, sizeof(tabs) - 1);
+				description_writer_emit(writer, tabs, chunk);
+				remaining -= chunk;
+			}
+			writer->at_line_start = false;
+		}
+
+		// indentation is only added lazily (once the next line actually has content), so that closing brackets can be outdented first
+		newline = memchr(string, '\n', length);
+		lineLength = newline ? (size_t)(newline - string) + 1 : length;
+		description_writer_emit(writer, string, lineLength);
+		if (newline) {
+			writer->at_line_start = true;
+		}
+
+		string += lineLength;
+		length -= lineLength;
+	}
+};
+
+void xpc_description_printf(xpc_description_writer_t* writer, const char* format, ...) {
+	char buffer[128];
+	char* output = buffer;
+	va_list args;
+	int length = 0;
+
+	if (xpc_description_writer_is_done(writer)) {
+		return;
+	}
+
+	va_start(args, format);
+	length = vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+
+	if (length < 0) {
+		writer->failed = true;
+		return;
+	}
+
+	if ((size_t)length >= sizeof(buffer)) {
+		va_start(args, format);
+		length = vasprintf(&output, format, args);
+		va_end(args);
+		if (length < 0) {
+			writer->failed = true;
+			return;
+		}
+	}
+
+	xpc_description_write(writer, output, length);
+
+	if (output != buffer) {
+		free(output);
+	}
+};
+
+void xpc_description_write_object(xpc_description_writer_t* writer, XPC_CLASS(object)* object) {
+	if (xpc_description_writer_is_done(writer)) {
+		return;
+	}
+	[object describeTo: writer];
+};
+
+bool xpc_description_writer_is_done(xpc_description_writer_t* writer) {
+	return writer->truncated || writer->failed;
+};
+
+bool xpc_description_writer_enter(xpc_description_writer_t* writer) {
+	if (writer->limits.max_depth > 0 && writer->depth >= writer->limits.max_depth) {
+		return false;
+	}
+	++writer->depth;
+	return true;
+};
+
+void xpc_description_writer_leave(xpc_description_writer_t* writer) {
+	--writer->depth;
+};
+
+size_t xpc_description_writer_element_limit(xpc_description_writer_t* writer, size_t count) {
+	if (writer->limits.max_elements > 0) {
+		return MIN(count, writer->limits.max_elements);
+	}
+	return count;
+};
+
+char* xpc_description_writer_finish(xpc_description_writer_t* writer) {
+	char* result = NULL;
+
+	if (writer->truncated) {
+		// the marker doesn't count towards the limit
+		description_writer_output(writer, "...", 3);
+	}
+
+	if (writer->file != NULL) {
+		if (fflush(writer->file) != 0) {
+			writer->failed = true;
 		}
-		result = (result * 0x21) + current;
+	} else if (writer->fd >= 0) {
+		description_writer_flush(writer);
+	} else {
+		// the builder always leaves room for a terminator, so we can take its buffer as-is
+		if (!writer->failed && xpc_string_builder_append(&writer->builder, "", 0)) {
+			result = writer->builder.buffer;
+			result[writer->builder.length] = '\0';
+			writer->builder.buffer = NULL;
+		}
+		xpc_string_builder_destroy(&writer->builder);
 	}
+
 	return result;
 };
 
+char* xpc_description_copy(XPC_CLASS(object)* object, const xpc_description_limits_t* limits) {
+	xpc_description_writer_t writer;
+	xpc_description_writer_init(&writer, limits);
+	xpc_description_write_object(&writer, object);
+	return xpc_description_writer_finish(&writer);
+};
+
+// the data hash is modeled after xxHash64: the input is consumed 8 bytes at a time (in four independent lanes for longer inputs,
+// so the multiplications can overlap) and every byte affects the result, including zeros.
+// it only has to be consistent within a single process, so words are read in host byte order.
+
+#define HASH_PRIME_1 0x9e3779b185ebca87ULL
+#define HASH_PRIME_2 0xc2b2ae3d27d4eb4fULL
+#define HASH_PRIME_3 0x165667b19e3779f9ULL
+#define HASH_PRIME_4 0x85ebca77c2b2ae63ULL
+#define HASH_PRIME_5 0x27d4eb2f165667c5ULL
+
+XPC_INLINE
+uint64_t hash_rotl(uint64_t value, unsigned int shift) {
+	return (value << shift) | (value >> (64 - shift));
+};
+
+XPC_INLINE
+uint64_t hash_read64(const uint8_t* bytes) {
+	uint64_t value;
+	memcpy(&value, bytes, sizeof(value));
+	return value;
+};
+
+XPC_INLINE
+uint64_t hash_round(uint64_t accumulator, uint64_t input) {
+	accumulator += input * HASH_PRIME_2;
+	accumulator = hash_rotl(accumulator, 31);
+	return accumulator * HASH_PRIME_1;
+};
+
+XPC_INLINE
+uint64_t hash_merge_lane(uint64_t accumulator, uint64_t lane) {
+	accumulator ^= hash_round(0, lane);
+	return accumulator * HASH_PRIME_1 + HASH_PRIME_4;
+};
+
+// consumes as many whole 32-byte stripes as there are, one per lane
+XPC_INLINE
+void hash_consume_stripes(uint64_t lanes[4], const uint8_t** bytes, size_t* remaining) {
+	const uint8_t* cursor = *bytes;
+	size_t left = *remaining;
+
+	for (; left >= 32; cursor += 32, left -= 32) {
+		lanes[0] = hash_round(lanes[0], hash_read64(cursor));
+		lanes[1] = hash_round(lanes[1], hash_read64(cursor + 8));
+		lanes[2] = hash_round(lanes[2], hash_read64(cursor + 16));
+		lanes[3] = hash_round(lanes[3], hash_read64(cursor + 24));
+	}
+
+	*bytes = cursor;
+	*remaining = left;
+};
+
+XPC_INLINE
+void hash_init_lanes(uint64_t lanes[4]) {
+	lanes[0] = HASH_PRIME_1 + HASH_PRIME_2;
+	lanes[1] = HASH_PRIME_2;
+	lanes[2] = 0;
+	lanes[3] = -HASH_PRIME_1;
+};
+
+// finishes the hash of `data_length` bytes, given the lanes that consumed the stripes (if there were any) and the remaining tail (less than 32 bytes)
+static size_t hash_finish(const uint64_t lanes[4], const uint8_t* bytes, size_t remaining, size_t data_length) {
+	uint64_t result = 0;
+
+	if (data_length >= 32) {
+		result = hash_rotl(lanes[0], 1) + hash_rotl(lanes[1], 7) + hash_rotl(lanes[2], 12) + hash_rotl(lanes[3], 18);
+		result = hash_merge_lane(result, lanes[0]);
+		result = hash_merge_lane(result, lanes[1]);
+		result = hash_merge_lane(result, lanes[2]);
+		result = hash_merge_lane(result, lanes[3]);
+	} else {
+		result = HASH_PRIME_5;
+	}
+
+	// mixing in the length means that trailing zeros (which the tail below pads with) still change the hash
+	result += (uint64_t)data_length;
+
+	for (; remaining >= 8; bytes += 8, remaining -= 8) {
+		result ^= hash_round(0, hash_read64(bytes));
+		result = hash_rotl(result, 27) * HASH_PRIME_1 + HASH_PRIME_4;
+	}
+
+	if (remaining > 0) {
+		uint64_t tail = 0;
+		memcpy(&tail, bytes, remaining);
+		result ^= tail * HASH_PRIME_5;
+		result = hash_rotl(result, 11) * HASH_PRIME_1;
+	}
+
+	// final avalanche, so that every input bit affects every output bit (the low bits in particular are used for table slots)
+	result ^= result >> 33;
+	result *= HASH_PRIME_2;
+	result ^= result >> 29;
+	result *= HASH_PRIME_3;
+	result ^= result >> 32;
+
+	// on 32-bit platforms, fold the upper half in rather than dropping it
+	return (size_t)(result ^ (result >> 32 >> (sizeof(size_t) * 8 - 32)));
+};
+
+size_t xpc_raw_data_hash(const void* data, size_t data_length) {
+	const uint8_t* bytes = data;
+	size_t remaining = data_length;
+	uint64_t lanes[4];
+
+	hash_init_lanes(lanes);
+	hash_consume_stripes(lanes, &bytes, &remaining);
+
+	return hash_finish(lanes, bytes, remaining, data_length);
+};
+
+void xpc_data_hasher_init(xpc_data_hasher_t* hasher) {
+	hash_init_lanes(hasher->lanes);
+	hasher->buffered = 0;
+	hasher->length = 0;
+};
+
+void xpc_data_hasher_append(xpc_data_hasher_t* hasher, const void* data, size_t data_length) {
+	const uint8_t* bytes = data;
+	size_t remaining = data_length;
+
+	hasher->length += data_length;
+
+	// stripes can straddle the pieces we're given, so finish the one we've got buffered first
+	if (hasher->buffered > 0) {
+		size_t needed = sizeof(hasher->buffer) - hasher->buffered;
+		const uint8_t* buffered = hasher->buffer;
+		size_t stripe = sizeof(hasher->buffer);
+
+		if (needed > remaining) {
+			needed = remaining;
+		}
+
+		memcpy(hasher->buffer + hasher->buffered, bytes, needed);
+		hasher->buffered += needed;
+		bytes += needed;
+		remaining -= needed;
+
+		if (hasher->buffered < sizeof(hasher->buffer)) {
+			return;
+		}
+
+		hash_consume_stripes(hasher->lanes, &buffered, &stripe);
+		hasher->buffered = 0;
+	}
+
+	hash_consume_stripes(hasher->lanes, &bytes, &remaining);
+
+	memcpy(hasher->buffer, bytes, remaining);
+	hasher->buffered = remaining;
+};
+
+size_t xpc_data_hasher_finish(const xpc_data_hasher_t* hasher) {
+	return hash_finish(hasher->lanes, hasher->buffer, hasher->buffered, hasher->length);
+};
+
+size_t xpc_hash_combine(size_t first, size_t second) {
+	// multiplying by an odd constant spreads each input across all the bits, so swapping values between entries changes the sum
+	size_t result = (first * (size_t)0x9e3779b97f4a7c15ULL) ^ second;
+	return result * (size_t)0xff51afd7ed558ccdULL;
+};
+
+static atomic_size_t leaf_generation = 0;
+
+size_t xpc_leaf_generation(void) {
+	return atomic_load_explicit(&leaf_generation, memory_order_acquire);
+};
+
+void xpc_leaf_generation_advance(void) {
+	atomic_fetch_add_explicit(&leaf_generation, 1, memory_order_release);
+};
+
+//
+// key interning
+//
+// dictionary keys are drawn from a small vocabulary ("subsystem", "routine", "handle", ...), so we keep a single copy of each one.
+// the table is open-addressed with a fixed number of slots and keys are never removed, so slots only ever go from empty to full;
+// that means inserting is a single compare-and-swap and looking up needs no synchronization at all.
+// keys arrive from untrusted peers, so both the number and the length of interned keys are capped. once the table is full, keys just aren't interned anymore.
+//
+
+// must be a power of two
+#define KEY_INTERN_SLOTS 4096
+// keep the table at most half full so probe sequences stay short
+#define KEY_INTERN_MAX_COUNT (KEY_INTERN_SLOTS / 2)
+#define KEY_INTERN_MAX_LENGTH 128
+
+typedef struct xpc_interned_key {
+	size_t hash;
+	char name[];
+} xpc_interned_key_t;
+
+static const xpc_interned_key_t* _Atomic key_intern_table[KEY_INTERN_SLOTS];
+static _Atomic size_t key_intern_count = 0;
+
+size_t xpc_key_hash(const char* key) {
+	// FNV-1a
+	size_t hash = 0xcbf29ce484222325ULL;
+	for (; *key != '\0'; ++key) {
+		hash = (hash ^ (uint8_t)*key) * 0x100000001b3ULL;
+	}
+	return hash;
+};
+
+static const char* key_intern_find(const char* key, size_t hash, bool insert) {
+	size_t length = strnlen(key, KEY_INTERN_MAX_LENGTH + 1);
+	xpc_interned_key_t* created = NULL;
+
+	if (length > KEY_INTERN_MAX_LENGTH) {
+		return NULL;
+	}
+
+	for (size_t slot = hash & (KEY_INTERN_SLOTS - 1);; slot = (slot + 1) & (KEY_INTERN_SLOTS - 1)) {
+		const xpc_interned_key_t* current = atomic_load_explicit(&key_intern_table[slot], memory_order_acquire);
+
+		if (current == NULL) {
+			if (!insert) {
+				return NULL;
+			}
+
+			if (created == NULL) {
+				// reserve our place in the table before allocating anything
+				if (atomic_fetch_add_explicit(&key_intern_count, 1, memory_order_relaxed) >= KEY_INTERN_MAX_COUNT) {
+					atomic_fetch_sub_explicit(&key_intern_count, 1, memory_order_relaxed);
+					return NULL;
+				}
+				created = malloc(sizeof(xpc_interned_key_t) + length + 1);
+				if (created == NULL) {
+					atomic_fetch_sub_explicit(&key_intern_count, 1, memory_order_relaxed);
+					return NULL;
+				}
+				created->hash = hash;
+				memcpy(created->name, key, length + 1);
+			}
+
+			if (atomic_compare_exchange_strong_explicit(&key_intern_table[slot], &current, created, memory_order_acq_rel, memory_order_acquire)) {
+				return created->name;
+			}
+
+			// someone else filled this slot first; `current` now holds whatever they put there
+		}
+
+		if (current->hash == hash && strcmp(current->name, key) == 0) {
+			if (created != NULL) {
+				// someone else interned the same key while we were trying to
+				free(created);
+				atomic_fetch_sub_explicit(&key_intern_count, 1, memory_order_relaxed);
+			}
+			return current->name;
+		}
+	}
+};
+
+const char* xpc_key_intern(const char* key, size_t hash) {
+	return key_intern_find(key, hash, true);
+};
+
+const char* xpc_key_lookup_interned(const char* key, size_t hash) {
+	return key_intern_find(key, hash, false);
+};
+
+//
+// slab allocator
+//
+// containers constantly allocate and free small backing buffers (e.g. a dictionary's entries or an array's object pointers),
+// so each thread keeps a small magazine of recently freed blocks for each size class and hands them out again before asking `malloc`.
+// blocks can be freed on a different thread than the one that allocated them; they just end up in the freeing thread's magazine.
+//
+// like the serializer's thread cache, magazines are emptied when the system comes under memory pressure.
+//
+
+#define SLAB_MIN_SHIFT 5
+#define SLAB_CLASS_COUNT 8
+// largest size class (4 KiB); anything larger goes straight to `malloc`
+#define SLAB_MAX_SIZE ((size_t)1 << (SLAB_MIN_SHIFT + SLAB_CLASS_COUNT - 1))
+// maximum number of blocks each magazine holds
+#define SLAB_MAGAZINE_SIZE 32
+// maximum number of bytes each thread holds on to across all of its magazines
+#define SLAB_THREAD_MAX_RETAINED (64 * 1024)
+
+typedef struct xpc_slab_magazine {
+	void* blocks[SLAB_MAGAZINE_SIZE];
+	size_t count;
+} xpc_slab_magazine_t;
+
+typedef struct xpc_slab_thread_cache {
+	xpc_slab_magazine_t magazines[SLAB_CLASS_COUNT];
+	size_t retained;
+	unsigned long generation;
+} xpc_slab_thread_cache_t;
+
+static pthread_key_t slab_cache_key;
+static _Atomic unsigned long slab_cache_generation = 0;
+static _Atomic uint64_t slab_hits = 0;
+static _Atomic uint64_t slab_misses = 0;
+static _Atomic uint64_t slab_retained = 0;
+
+XPC_INLINE
+size_t slab_class_for_size(size_t size) {
+	size_t class = 0;
+	while (((size_t)1 << (SLAB_MIN_SHIFT + class)) < size) {
+		++class;
+	}
+	return class;
+};
+
+XPC_INLINE
+size_t slab_class_size(size_t class) {
+	return (size_t)1 << (SLAB_MIN_SHIFT + class);
+};
+
+static void slab_cache_purge(xpc_slab_thread_cache_t* cache) {
+	for (size_t class = 0; class < SLAB_CLASS_COUNT; ++class) {
+		xpc_slab_magazine_t* magazine = &cache->magazines[class];
+		while (magazine->count > 0) {
+			free(magazine->blocks[--magazine->count]);
+		}
+	}
+	atomic_fetch_sub_explicit(&slab_retained, cache->retained, memory_order_relaxed);
+	cache->retained = 0;
+};
+
+static void slab_cache_destroy(void* context) {
+	xpc_slab_thread_cache_t* cache = context;
+	slab_cache_purge(cache);
+	free(cache);
+};
+
+static xpc_slab_thread_cache_t* slab_cache_get(void) {
+	static dispatch_once_t onceToken;
+	xpc_slab_thread_cache_t* cache = NULL;
+	unsigned long generation = 0;
+
+	dispatch_once(&onceToken, ^{
+		pthread_key_create(&slab_cache_key, slab_cache_destroy);
+
+		dispatch_source_t source = dispatch_source_create(DISPATCH_SOURCE_TYPE_MEMORYPRESSURE, 0, DISPATCH_MEMORYPRESSURE_WARN | DISPATCH_MEMORYPRESSURE_CRITICAL, dispatch_get_global_queue(QOS_CLASS_UTILITY, 0));
+		if (source != NULL) {
+			dispatch_source_set_event_handler(source, ^{
+				atomic_fetch_add_explicit(&slab_cache_generation, 1, memory_order_relaxed);
+			});
+			dispatch_resume(source);
+			// intentionally leaked; it lives for as long as the process does
+		}
+	});
+
+	cache = pthread_getspecific(slab_cache_key);
+	if (cache == NULL) {
+		cache = calloc(1, sizeof(*cache));
+		if (cache == NULL) {
+			return NULL;
+		}
+		if (pthread_setspecific(slab_cache_key, cache) != 0) {
+			free(cache);
+			return NULL;
+		}
+	}
+
+	generation = atomic_load_explicit(&slab_cache_generation, memory_order_relaxed);
+	if (cache->generation != generation) {
+		slab_cache_purge(cache);
+		cache->generation = generation;
+	}
+
+	return cache;
+};
+
+void* xpc_slab_alloc(size_t size) {
+	xpc_slab_thread_cache_t* cache = NULL;
+	size_t class = 0;
+
+	if (size > SLAB_MAX_SIZE) {
+		return malloc(size);
+	}
+
+	class = slab_class_for_size(size);
+
+	cache = slab_cache_get();
+	if (cache != NULL && cache->magazines[class].count > 0) {
+		xpc_slab_magazine_t* magazine = &cache->magazines[class];
+		cache->retained -= slab_class_size(class);
+		atomic_fetch_sub_explicit(&slab_retained, slab_class_size(class), memory_order_relaxed);
+		atomic_fetch_add_explicit(&slab_hits, 1, memory_order_relaxed);
+		return magazine->blocks[--magazine->count];
+	}
+
+	atomic_fetch_add_explicit(&slab_misses, 1, memory_order_relaxed);
+	return malloc(slab_class_size(class));
+};
+
+void xpc_slab_free(void* block, size_t size) {
+	xpc_slab_thread_cache_t* cache = NULL;
+	size_t class = 0;
+
+	if (block == NULL) {
+		return;
+	}
+
+	if (size > SLAB_MAX_SIZE) {
+		free(block);
+		return;
+	}
+
+	class = slab_class_for_size(size);
+
+	cache = slab_cache_get();
+	if (cache != NULL && cache->magazines[class].count < SLAB_MAGAZINE_SIZE && cache->retained + slab_class_size(class) <= SLAB_THREAD_MAX_RETAINED) {
+		xpc_slab_magazine_t* magazine = &cache->magazines[class];
+		magazine->blocks[magazine->count++] = block;
+		cache->retained += slab_class_size(class);
+		atomic_fetch_add_explicit(&slab_retained, slab_class_size(class), memory_order_relaxed);
+		return;
+	}
+
+	free(block);
+};
+
+void* xpc_slab_realloc(void* block, size_t old_size, size_t new_size) {
+	void* resized = NULL;
+
+	if (block == NULL) {
+		return xpc_slab_alloc(new_size);
+	}
+
+	if (old_size > SLAB_MAX_SIZE && new_size > SLAB_MAX_SIZE) {
+		return realloc(block, new_size);
+	}
+
+	if (old_size <= SLAB_MAX_SIZE && new_size <= SLAB_MAX_SIZE && slab_class_for_size(old_size) == slab_class_for_size(new_size)) {
+		return block;
+	}
+
+	resized = xpc_slab_alloc(new_size);
+	if (resized == NULL) {
+		return NULL;
+	}
+	memcpy(resized, block, MIN(old_size, new_size));
+	xpc_slab_free(block, old_size);
+	return resized;
+};
+
+void xpc_slab_get_statistics(xpc_slab_statistics_t* statistics) {
+	statistics->hits = atomic_load_explicit(&slab_hits, memory_order_relaxed);
+	statistics->misses = atomic_load_explicit(&slab_misses, memory_order_relaxed);
+	statistics->bytes_retained = atomic_load_explicit(&slab_retained, memory_order_relaxed);
+};
+
+// shared blocks are slab blocks with this header in front of them.
+// it's padded so that the contents stay as aligned as `malloc` would've made them.
+typedef union xpc_shared_header {
+	_Atomic size_t refcount;
+	max_align_t alignment;
+} xpc_shared_header_t;
+
+XPC_INLINE
+xpc_shared_header_t* shared_header(const void* block) {
+	return (xpc_shared_header_t*)block - 1;
+};
+
+void* xpc_shared_alloc(size_t size) {
+	xpc_shared_header_t* header = xpc_slab_alloc(sizeof(xpc_shared_header_t) + size);
+	if (header == NULL) {
+		return NULL;
+	}
+	atomic_init(&header->refcount, 1);
+	return header + 1;
+};
+
+void* xpc_shared_realloc(void* block, size_t old_size, size_t new_size) {
+	xpc_shared_header_t* header = NULL;
+
+	if (block == NULL) {
+		return xpc_shared_alloc(new_size);
+	}
+
+	header = xpc_slab_realloc(shared_header(block), sizeof(xpc_shared_header_t) + old_size, sizeof(xpc_shared_header_t) + new_size);
+	if (header == NULL) {
+		return NULL;
+	}
+	return header + 1;
+};
+
+void* xpc_shared_retain(void* block) {
+	if (block != NULL) {
+		atomic_fetch_add_explicit(&shared_header(block)->refcount, 1, memory_order_relaxed);
+	}
+	return block;
+};
+
+bool xpc_shared_release(void* block) {
+	if (block == NULL) {
+		return false;
+	}
+	return atomic_fetch_sub_explicit(&shared_header(block)->refcount, 1, memory_order_acq_rel) == 1;
+};
+
+bool xpc_shared_is_unique(const void* block) {
+	return block == NULL || atomic_load_explicit(&shared_header(block)->refcount, memory_order_acquire) == 1;
+};
+
+void xpc_shared_free(void* block, size_t size) {
+	if (block == NULL) {
+		return;
+	}
+	xpc_slab_free(shared_header(block), sizeof(xpc_shared_header_t) + size);
+};
+
+bool xpc_object_is_mutable(XPC_CLASS(object)* object) {
+	// errors are dictionaries too, but they're immutable
+	Class class = object_getClass(object);
+	return class == [XPC_CLASS(dictionary) class] || class == [XPC_CLASS(array) class] || class == [XPC_CLASS(mach_send) class] || class == [XPC_CLASS(mach_recv) class];
+};
+
 kern_return_t xpc_mach_port_release(mach_port_t port){
     if (MACH_PORT_VALID(port)) {
         return mach_port_deallocate(mach_task_self(), port);
@@ -61,6 +61,12 @@ XPC_CLASS_HEADER(uuid);
 	return xpc_raw_data_hash(this->value, sizeof(this->value));
 }
 
+- (BOOL)isEqualToObject: (XPC_CLASS(object)*)object
+{
+	XPC_THIS_DECL(uuid);
+	return memcmp(this->value, XPC_CAST(uuid, object).bytes, sizeof(this->value)) == 0;
+}
+
 @end
 
 @implementation XPC_CLASS(uuid) (XPCSerialization)
@@ -103,6 +109,20 @@ error_out:
 	return nil;
 }
 
++ (BOOL)skip: (XPC_CLASS(deserializer)*)deserializer
+{
+	xpc_serial_type_t type = XPC_SERIAL_TYPE_INVALID;
+
+	if (![deserializer readU32: &type]) {
+		return NO;
+	}
+	if (type != XPC_SERIAL_TYPE_UUID) {
+		return NO;
+	}
+
+	return [deserializer consume: sizeof(uuid_t) region: NULL];
+}
+
 - (BOOL)serialize: (XPC_CLASS(serializer)*)serializer
 {
 	XPC_THIS_DECL(uuid);
@@ -19,6 +19,8 @@
 
 #include "ctest-plus.h"
 #include <xpc/private.h>
+#import <xpc/objects/serializer.h>
+#import <xpc/objects/deserializer.h>
 #include "test-util.h"
 
 CTEST_DATA(array) {
@@ -79,7 +81,8 @@ CTEST2(array, get_value) {
 };
 
 CTEST2(array, set_value) {
-	xpc_object_t newObject = xpc_int64_create(10);
+	// large enough not to be one of the global integers
+	xpc_object_t newObject = xpc_int64_create(10000);
 	NSUInteger oldRefCount = 0;
 	size_t index = rand_index(OBJECT_COUNT);
 
@@ -112,11 +115,163 @@ CTEST2(array, append_value) {
 	xpc_release(newObject);
 };
 
+CTEST2(array, append_values) {
+	xpc_object_t array = xpc_array_create_with_capacity(2);
+	ASSERT_NOT_NULL(array);
+	ASSERT_EQUAL_U(0, xpc_array_get_count(array));
+
+	// this needs to grow past the initial capacity
+	xpc_array_append_values(array, data->objects, OBJECT_COUNT);
+	ASSERT_EQUAL_U(OBJECT_COUNT, xpc_array_get_count(array));
+	for (size_t i = 0; i < OBJECT_COUNT; ++i) {
+		ASSERT_EQUAL_PTR(data->objects[i], xpc_array_get_value(array, i));
+	}
+
+	// appending should still work normally after a bulk append
+	xpc_array_append_value(array, data->objects[0]);
+	ASSERT_EQUAL_U(OBJECT_COUNT + 1, xpc_array_get_count(array));
+	ASSERT_EQUAL_PTR(data->objects[0], xpc_array_get_value(array, OBJECT_COUNT));
+
+	xpc_release(array);
+};
+
+CTEST(array, packed) {
+	int64_t values[] = { 1, -2, 3, INT64_MAX };
+	size_t count = sizeof(values) / sizeof(*values);
+	xpc_object_t packed = xpc_array_create_int64s(values, count);
+	xpc_object_t boxed = xpc_array_create(NULL, 0);
+	xpc_object_t string = xpc_string_create("foo");
+
+	ASSERT_NOT_NULL(packed);
+	ASSERT_EQUAL_U(count, xpc_array_get_count(packed));
+	for (size_t i = 0; i < count; ++i) {
+		xpc_array_append_value(boxed, xpc_array_get_value(packed, i));
+		ASSERT_EQUAL(values[i], xpc_array_get_int64(packed, i));
+		ASSERT_EQUAL(values[i], xpc_int64_get_value(xpc_array_get_value(packed, i)));
+	}
+
+	// the same object should be returned every time
+	ASSERT_EQUAL_PTR(xpc_array_get_value(packed, 0), xpc_array_get_value(packed, 0));
+
+	// packed arrays should be indistinguishable from normal ones
+	ASSERT_TRUE(xpc_equal(packed, boxed));
+	ASSERT_EQUAL_U(xpc_hash(packed), xpc_hash(boxed));
+
+	// adding something else should keep the existing values
+	xpc_array_append_value(packed, string);
+	ASSERT_EQUAL_U(count + 1, xpc_array_get_count(packed));
+	ASSERT_EQUAL(values[count - 1], xpc_array_get_int64(packed, count - 1));
+	ASSERT_EQUAL_PTR(string, xpc_array_get_value(packed, count));
+
+	xpc_release(string);
+	xpc_release(boxed);
+	xpc_release(packed);
+};
+
+CTEST(array, packed_modified_element) {
+	double values[] = { 1.5, 2.5, 3.5 };
+	size_t count = sizeof(values) / sizeof(*values);
+	xpc_object_t packed = xpc_array_create_doubles(values, count);
+	xpc_object_t message = xpc_dictionary_create(NULL, NULL, 0);
+	xpc_object_t copy = NULL;
+
+	// whoever gets an element can modify it, and the array has to reflect that without creating any other objects
+	xpc_double_set_value(xpc_array_get_value(packed, 1), 42.5);
+	ASSERT_DBL_NEAR(42.5, xpc_array_get_double(packed, 1));
+	ASSERT_DBL_NEAR(1.5, xpc_array_get_double(packed, 0));
+
+	copy = xpc_copy(packed);
+	ASSERT_DBL_NEAR(42.5, xpc_array_get_double(copy, 1));
+	ASSERT_TRUE(xpc_equal(packed, copy));
+	ASSERT_EQUAL_U(xpc_hash(packed), xpc_hash(copy));
+
+	// ...including when it's sent
+	xpc_dictionary_set_value(message, "values", packed);
+	@autoreleasepool {
+		XPC_CLASS(serializer)* serializer = [XPC_CLASS(serializer) serializer];
+		ASSERT_TRUE([serializer writeObject: XPC_CAST(object, message)]);
+		dispatch_mach_msg_t mach = [serializer finalizeWithRemotePort: MACH_PORT_NULL localPort: MACH_PORT_NULL asReply: NO expectingReply: NO];
+		ASSERT_NOT_NULL(mach);
+		// `process:` consumes the message, but the serializer still owns it
+		dispatch_retain(mach);
+		xpc_object_t received = [XPC_CLASS(deserializer) process: mach];
+		xpc_object_t receivedValues = xpc_dictionary_get_value(received, "values");
+		ASSERT_NOT_NULL(receivedValues);
+		ASSERT_EQUAL_U(count, xpc_array_get_count(receivedValues));
+		ASSERT_DBL_NEAR(1.5, xpc_array_get_double(receivedValues, 0));
+		ASSERT_DBL_NEAR(42.5, xpc_array_get_double(receivedValues, 1));
+		ASSERT_DBL_NEAR(3.5, xpc_array_get_double(receivedValues, 2));
+		ASSERT_TRUE(xpc_equal(packed, receivedValues));
+	}
+
+	xpc_release(copy);
+	xpc_release(message);
+	xpc_release(packed);
+};
+
+CTEST(array, packed_added_element) {
+	double values[] = { 1.5, 2.5 };
+	xpc_object_t packed = xpc_array_create_doubles(values, 2);
+	xpc_object_t appended = xpc_double_create(3.5);
+	xpc_object_t replacement = xpc_double_create(4.5);
+
+	// objects that are added to a packed array are the ones it hands out, so modifying them later still affects the array
+	xpc_array_append_value(packed, appended);
+	xpc_array_set_value(packed, 0, replacement);
+	ASSERT_EQUAL((intptr_t)appended, (intptr_t)xpc_array_get_value(packed, 2));
+	ASSERT_EQUAL((intptr_t)replacement, (intptr_t)xpc_array_get_value(packed, 0));
+
+	xpc_double_set_value(appended, 5.5);
+	xpc_double_set_value(replacement, 6.5);
+	ASSERT_DBL_NEAR(5.5, xpc_array_get_double(packed, 2));
+	ASSERT_DBL_NEAR(6.5, xpc_array_get_double(packed, 0));
+
+	// values set directly don't have an object until someone asks for one
+	xpc_array_set_double(packed, 0, 7.5);
+	xpc_array_set_double(packed, XPC_ARRAY_APPEND, 8.5);
+	ASSERT_DBL_NEAR(7.5, xpc_array_get_double(packed, 0));
+	ASSERT_DBL_NEAR(8.5, xpc_array_get_double(packed, 3));
+	ASSERT_EQUAL_U(4, xpc_array_get_count(packed));
+
+	xpc_release(replacement);
+	xpc_release(appended);
+	xpc_release(packed);
+};
+
 static void visitor(size_t index, xpc_object_t value, void* context) {
 	size_t* visitedCount = context;
 	++*visitedCount;
 };
 
+CTEST(array, copy_nested) {
+	xpc_object_t original = xpc_array_create(NULL, 0);
+	xpc_object_t nested = xpc_dictionary_create(NULL, NULL, 0);
+	xpc_object_t copy = NULL;
+
+	xpc_dictionary_set_bool(nested, "flag", true);
+	xpc_array_append_value(original, nested);
+	xpc_array_set_string(original, XPC_ARRAY_APPEND, "leaf");
+
+	copy = xpc_copy(original);
+	ASSERT_TRUE(xpc_equal(original, copy));
+
+	// both sides hand out their own copies of the shared nested dictionary...
+	ASSERT_NOT_EQUAL((intptr_t)xpc_array_get_value(original, 0), (intptr_t)xpc_array_get_value(copy, 0));
+	ASSERT_EQUAL((intptr_t)xpc_array_get_value(copy, 0), (intptr_t)xpc_array_get_value(copy, 0));
+
+	// ...so modifying it on one side doesn't affect the other, even once the other side is modified too
+	xpc_dictionary_set_bool(xpc_array_get_value(copy, 0), "flag", false);
+	xpc_array_set_string(original, XPC_ARRAY_APPEND, "more");
+	ASSERT_TRUE(xpc_dictionary_get_bool(xpc_array_get_value(original, 0), "flag"));
+	ASSERT_FALSE(xpc_dictionary_get_bool(xpc_array_get_value(copy, 0), "flag"));
+	ASSERT_FALSE(xpc_equal(original, copy));
+
+	xpc_release(nested);
+	xpc_release(original);
+	ASSERT_FALSE(xpc_dictionary_get_bool(xpc_array_get_value(copy, 0), "flag"));
+	xpc_release(copy);
+};
+
 CTEST2(array, apply) {
 	__block size_t visitedCount = 0;
 
@@ -146,3 +301,36 @@ CTEST2(array, apply) {
 //
 // if the basic API works, everything should
 // (all the getters and setters use the basic API to do their stuff)
+
+CTEST(array, description_limits) {
+	xpc_object_t outer = xpc_array_create(NULL, 0);
+	xpc_object_t inner = xpc_array_create(NULL, 0);
+	const xpc_description_limits_t limits = {
+		.max_depth = 1,
+		.max_elements = 2,
+	};
+	char* description = NULL;
+
+	xpc_array_set_int64(inner, XPC_ARRAY_APPEND, 1);
+	xpc_array_set_int64(inner, XPC_ARRAY_APPEND, 2);
+	xpc_array_set_value(outer, XPC_ARRAY_APPEND, inner);
+	xpc_array_set_string(outer, XPC_ARRAY_APPEND, "foo");
+	xpc_array_set_string(outer, XPC_ARRAY_APPEND, "bar");
+	xpc_array_set_string(outer, XPC_ARRAY_APPEND, "baz");
+
+	// nested entries are indented once per level
+	description = xpc_copy_description(outer);
+	ASSERT_NOT_NULL(strstr(description, "\n\t\t<"));
+	ASSERT_NOT_NULL(strstr(description, "baz>\n]"));
+	free(description);
+
+	// the inner array is too deep to be described entry by entry, and only the first 2 entries of the outer one are described
+	description = xpc_copy_description_with_limits(outer, &limits);
+	ASSERT_NULL(strstr(description, "\n\t\t<"));
+	ASSERT_NOT_NULL(strstr(description, " 2 items ]"));
+	ASSERT_NOT_NULL(strstr(description, "foo>\n\t... 2 more\n]"));
+	free(description);
+
+	xpc_release(inner);
+	xpc_release(outer);
+};
@@ -19,14 +19,17 @@
 
 #include "ctest-plus.h"
 #import <xpc/xpc.h>
+#include <xpc/private.h>
+#include <string.h>
 
 // this basic testing is related to the basic C API for objects and the base behavior of objects.
 // for this purpose, we use int64 objects, as they're simple enough that they should never pose a problem.
 // any issues with testing them should come from the xpc_object base class.
 
 // some random non-zero value to start off the integers with
-#define INT64_INITIAL_VALUE 5
-#define INT64_INITIAL_VALUE_AS_STRING "5"
+// (large enough not to be one of the global small integers, which aren't reference counted)
+#define INT64_INITIAL_VALUE 5000
+#define INT64_INITIAL_VALUE_AS_STRING "5000"
 #define INT64_CLASS_NAME "OS_xpc_int64"
 
 CTEST(base, create) {
@@ -45,6 +48,38 @@ CTEST(base, refcount) {
 	xpc_release(obj);
 };
 
+CTEST(base, immortal_integers) {
+	xpc_object_t obj1 = xpc_int64_create(5);
+	xpc_object_t obj2 = xpc_int64_create(5);
+	xpc_object_t dict = xpc_dictionary_create(NULL, NULL, 0);
+	xpc_object_t shared = NULL;
+
+	// objects that callers create are their own, so they can modify them
+	ASSERT_NOT_EQUAL_PTR(obj1, obj2);
+	_xpc_int64_set_value(obj1, 6);
+	ASSERT_EQUAL(6, xpc_int64_get_value(obj1));
+	ASSERT_EQUAL(5, xpc_int64_get_value(obj2));
+
+	// the ones created for them (e.g. by the typed setters) are shared global objects for small integers...
+	xpc_dictionary_set_int64(dict, "a", 5);
+	xpc_dictionary_set_int64(dict, "b", 5);
+	xpc_dictionary_set_uint64(dict, "c", 1023);
+	xpc_dictionary_set_int64(dict, "d", -128);
+	shared = xpc_dictionary_get_value(dict, "a");
+	ASSERT_EQUAL_PTR(shared, xpc_dictionary_get_value(dict, "b"));
+	ASSERT_EQUAL_U(NSUIntegerMax, [shared retainCount]);
+	ASSERT_EQUAL_U(1023, xpc_dictionary_get_uint64(dict, "c"));
+	ASSERT_EQUAL(-128, xpc_dictionary_get_int64(dict, "d"));
+
+	// ...so attempts to modify them are ignored
+	_xpc_int64_set_value(shared, 7);
+	ASSERT_EQUAL(5, xpc_dictionary_get_int64(dict, "b"));
+
+	xpc_release(dict);
+	xpc_release(obj2);
+	xpc_release(obj1);
+};
+
 // skipped because some XPC objects don't copy themselves
 // (e.g. the one we're using, int64, doesn't copy itself)
 CTEST_SKIP(base, copy) {
@@ -84,3 +119,9 @@ CTEST(base, description) {
 	free(description);
 	xpc_release(obj);
 };
+
+CTEST(base, error_description) {
+	char* description = xpc_copy_description(XPC_ERROR_CONNECTION_INVALID);
+	ASSERT_NOT_NULL(strstr(description, ": Connection invalid>"));
+	free(description);
+};
@@ -51,3 +51,16 @@ CTEST(bool, distinct) {
 
 	xpc_release(obj);
 };
+
+CTEST(bool, set_global) {
+	xpc_object_t obj = _xpc_bool_create_distinct(true);
+
+	// the global bools can't be modified, and callers are told so
+	ASSERT_FALSE(xpc_bool_set_value(XPC_BOOL_TRUE, false));
+	ASSERT_TRUE(xpc_bool_get_value(XPC_BOOL_TRUE));
+
+	ASSERT_TRUE(xpc_bool_set_value(obj, false));
+	ASSERT_FALSE(xpc_bool_get_value(obj));
+
+	xpc_release(obj);
+};
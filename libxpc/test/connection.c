@@ -0,0 +1,195 @@
+/**
+ * This file is part of Darling.
+ *
+ * Copyright (C) 2021 Darling developers
+ *
+ * Darling is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Darling is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Darling.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ctest-plus.h"
+#include <xpc/private.h>
+#include <dispatch/dispatch.h>
+#include <stdio.h>
+
+static const uint8_t some_bytes[] = { 0x0a, 0x0b, 0x0c, 0x0d };
+
+// creates an anonymous listener whose peers reply to every message they receive
+static xpc_connection_t create_echo_listener(dispatch_queue_t queue) {
+	xpc_connection_t listener = xpc_connection_create(NULL, queue);
+
+	xpc_connection_set_event_handler(listener, ^(xpc_object_t peer) {
+		if (xpc_get_type(peer) != XPC_TYPE_CONNECTION) {
+			return;
+		}
+		xpc_connection_set_event_handler(peer, ^(xpc_object_t message) {
+			if (xpc_get_type(message) != XPC_TYPE_DICTIONARY) {
+				return;
+			}
+			xpc_object_t reply = xpc_dictionary_create_reply(message);
+			xpc_connection_send_message(peer, reply);
+			xpc_release(reply);
+		});
+		xpc_connection_resume(peer);
+	});
+
+	return listener;
+};
+
+static xpc_connection_t create_client(xpc_connection_t listener) {
+	xpc_endpoint_t endpoint = xpc_endpoint_create(listener);
+	xpc_connection_t client = xpc_connection_create_from_endpoint(endpoint);
+
+	xpc_release(endpoint);
+	xpc_connection_set_event_handler(client, ^(xpc_object_t event) {});
+	xpc_connection_resume(client);
+
+	return client;
+};
+
+static void destroy_connection(xpc_connection_t connection) {
+	xpc_connection_cancel(connection);
+	xpc_release(connection);
+};
+
+// sends the message and returns the type of the reply; a dropped message has to produce an error rather than waiting forever
+static xpc_type_t send_and_get_reply_type(xpc_connection_t client, xpc_object_t message) {
+	xpc_object_t reply = xpc_connection_send_message_with_reply_sync(client, message);
+	xpc_type_t type = xpc_get_type(reply);
+	xpc_release(reply);
+	return type;
+};
+
+CTEST(connection, max_message_depth) {
+	dispatch_queue_t queue = dispatch_queue_create("org.darlinghq.libxpc.test.max-message-depth", NULL);
+	xpc_connection_t listener = create_echo_listener(queue);
+	xpc_connection_t client = NULL;
+	xpc_object_t shallow = xpc_dictionary_create(NULL, NULL, 0);
+	xpc_object_t deep = xpc_dictionary_create(NULL, NULL, 0);
+
+	xpc_connection_set_max_message_depth(listener, 2);
+	xpc_connection_resume(listener);
+	client = create_client(listener);
+
+	xpc_dictionary_set_int64(shallow, "value", 1);
+	for (size_t i = 0; i < 8; ++i) {
+		xpc_object_t outer = xpc_dictionary_create(NULL, NULL, 0);
+		xpc_dictionary_set_value(outer, "inner", deep);
+		xpc_release(deep);
+		deep = outer;
+	}
+
+	ASSERT_EQUAL_PTR(XPC_TYPE_DICTIONARY, send_and_get_reply_type(client, shallow));
+	ASSERT_EQUAL_PTR(XPC_TYPE_ERROR, send_and_get_reply_type(client, deep));
+
+	// dropping a message doesn't affect the rest of the connection
+	ASSERT_EQUAL_PTR(XPC_TYPE_DICTIONARY, send_and_get_reply_type(client, shallow));
+
+	xpc_release(deep);
+	xpc_release(shallow);
+	destroy_connection(client);
+	destroy_connection(listener);
+	dispatch_release(queue);
+};
+
+CTEST(connection, max_message_objects) {
+	dispatch_queue_t queue = dispatch_queue_create("org.darlinghq.libxpc.test.max-message-objects", NULL);
+	xpc_connection_t listener = create_echo_listener(queue);
+	xpc_connection_t client = NULL;
+	xpc_object_t small = xpc_dictionary_create(NULL, NULL, 0);
+	xpc_object_t large = xpc_dictionary_create(NULL, NULL, 0);
+	char key[32];
+
+	xpc_connection_set_max_message_objects(listener, 8);
+	xpc_connection_resume(listener);
+	client = create_client(listener);
+
+	xpc_dictionary_set_int64(small, "value", 1);
+	for (size_t i = 0; i < 64; ++i) {
+		snprintf(key, sizeof(key), "key-%zu", i);
+		xpc_dictionary_set_int64(large, key, i);
+	}
+
+	ASSERT_EQUAL_PTR(XPC_TYPE_DICTIONARY, send_and_get_reply_type(client, small));
+	ASSERT_EQUAL_PTR(XPC_TYPE_ERROR, send_and_get_reply_type(client, large));
+	ASSERT_EQUAL_PTR(XPC_TYPE_DICTIONARY, send_and_get_reply_type(client, small));
+
+	xpc_release(large);
+	xpc_release(small);
+	destroy_connection(client);
+	destroy_connection(listener);
+	dispatch_release(queue);
+};
+
+CTEST(connection, max_message_size) {
+	dispatch_queue_t queue = dispatch_queue_create("org.darlinghq.libxpc.test.max-message-size", NULL);
+	xpc_connection_t listener = create_echo_listener(queue);
+	xpc_connection_t client = NULL;
+	xpc_object_t small = xpc_dictionary_create(NULL, NULL, 0);
+	xpc_object_t large = xpc_dictionary_create(NULL, NULL, 0);
+	uint8_t bytes[4096] = {0};
+
+	xpc_connection_set_max_message_size(listener, 1024);
+	xpc_connection_resume(listener);
+	client = create_client(listener);
+
+	xpc_dictionary_set_int64(small, "value", 1);
+	xpc_dictionary_set_data(large, "value", bytes, sizeof(bytes));
+
+	ASSERT_EQUAL_PTR(XPC_TYPE_DICTIONARY, send_and_get_reply_type(client, small));
+	ASSERT_EQUAL_PTR(XPC_TYPE_ERROR, send_and_get_reply_type(client, large));
+	ASSERT_EQUAL_PTR(XPC_TYPE_DICTIONARY, send_and_get_reply_type(client, small));
+
+	xpc_release(large);
+	xpc_release(small);
+	destroy_connection(client);
+	destroy_connection(listener);
+	dispatch_release(queue);
+};
+
+CTEST(connection, validate_messages) {
+	dispatch_queue_t queue = dispatch_queue_create("org.darlinghq.libxpc.test.validate-messages", NULL);
+	xpc_connection_t listener = create_echo_listener(queue);
+	xpc_connection_t client = NULL;
+	xpc_object_t message = xpc_dictionary_create(NULL, NULL, 0);
+	xpc_object_t nested = xpc_dictionary_create(NULL, NULL, 0);
+	xpc_object_t array = xpc_array_create(NULL, 0);
+	char key[32];
+
+	xpc_connection_set_validate_messages(listener, true);
+	xpc_connection_set_max_message_objects(listener, 32);
+	xpc_connection_resume(listener);
+	client = create_client(listener);
+
+	xpc_array_append_value(array, nested);
+	xpc_dictionary_set_string(nested, "name", "nested");
+	xpc_dictionary_set_value(message, "array", array);
+	xpc_dictionary_set_data(message, "data", some_bytes, sizeof(some_bytes));
+
+	// well-formed messages go through just like they would without validation...
+	ASSERT_EQUAL_PTR(XPC_TYPE_DICTIONARY, send_and_get_reply_type(client, message));
+
+	// ...and the limits are still enforced
+	for (size_t i = 0; i < 64; ++i) {
+		snprintf(key, sizeof(key), "key-%zu", i);
+		xpc_dictionary_set_int64(nested, key, i);
+	}
+	ASSERT_EQUAL_PTR(XPC_TYPE_ERROR, send_and_get_reply_type(client, message));
+
+	xpc_release(array);
+	xpc_release(nested);
+	xpc_release(message);
+	destroy_connection(client);
+	destroy_connection(listener);
+	dispatch_release(queue);
+};
@@ -20,6 +20,7 @@
 #include "ctest-plus.h"
 #include <xpc/private.h>
 #include "test-util.h"
+#include <string.h>
 
 CTEST_DATA(data) {
 	xpc_object_t data;
@@ -62,8 +63,82 @@ CTEST(data, create_with_dispatch_data) {
 	dispatch_release(ddata);
 };
 
+CTEST(data, bytes_from_regions) {
+	// data made up of several regions, like the result of a dispatch_io read
+	dispatch_data_t first = dispatch_data_create(some_data, 3, NULL, DISPATCH_DATA_DESTRUCTOR_DEFAULT);
+	dispatch_data_t second = dispatch_data_create(some_data + 3, sizeof(some_data) - 3, NULL, DISPATCH_DATA_DESTRUCTOR_DEFAULT);
+	dispatch_data_t ddata = dispatch_data_create_concat(first, second);
+	xpc_object_t object = xpc_data_create_with_dispatch_data(ddata);
+	uint8_t copy[sizeof(some_data)];
+
+	// the offset is into the data, not into the buffer
+	ASSERT_EQUAL_U(sizeof(some_data) - 2, xpc_data_get_bytes(object, copy, 2, sizeof(copy)));
+	ASSERT_DATA(some_data + 2, sizeof(some_data) - 2, copy, sizeof(some_data) - 2);
+	ASSERT_EQUAL_U(0, xpc_data_get_bytes(object, copy, sizeof(some_data), sizeof(copy)));
+
+	xpc_release(object);
+	dispatch_release(ddata);
+	dispatch_release(second);
+	dispatch_release(first);
+};
+
 CTEST2(data, set_data) {
 	const uint8_t new_data[] = { 123, 124, 125, 126, 127, 128, 129, 130 };
 	xpc_data_set_value(data->data, new_data, sizeof(new_data));
 	ASSERT_DATA(new_data, sizeof(new_data), xpc_data_get_bytes_ptr(data->data), xpc_data_get_length(data->data));
 };
+
+CTEST2(data, hash) {
+	// every byte counts, including ones after a zero byte
+	const uint8_t zero_prefixed1[] = { 0, 1, 2, 3 };
+	const uint8_t zero_prefixed2[] = { 0, 1, 2, 4 };
+	xpc_object_t first = xpc_data_create(zero_prefixed1, sizeof(zero_prefixed1));
+	xpc_object_t second = xpc_data_create(zero_prefixed2, sizeof(zero_prefixed2));
+	size_t old_hash = xpc_hash(data->data);
+
+	ASSERT_NOT_EQUAL_U(xpc_hash(first), xpc_hash(second));
+
+	// the cached hash has to be reset when the contents change
+	xpc_data_set_value(data->data, zero_prefixed1, sizeof(zero_prefixed1));
+	ASSERT_NOT_EQUAL_U(old_hash, xpc_hash(data->data));
+	ASSERT_EQUAL_U(xpc_hash(first), xpc_hash(data->data));
+
+	xpc_release(second);
+	xpc_release(first);
+};
+
+CTEST(data, hash_and_equality_from_regions) {
+	uint8_t bytes[100];
+	uint8_t other_bytes[100];
+	for (size_t i = 0; i < sizeof(bytes); ++i) {
+		bytes[i] = (uint8_t)(i * 7);
+	}
+	memcpy(other_bytes, bytes, sizeof(bytes));
+	other_bytes[50] ^= 1;
+
+	// split up so that regions end partway through the hash's stripes
+	dispatch_data_t first = dispatch_data_create(bytes, 3, NULL, DISPATCH_DATA_DESTRUCTOR_DEFAULT);
+	dispatch_data_t second = dispatch_data_create(bytes + 3, 37, NULL, DISPATCH_DATA_DESTRUCTOR_DEFAULT);
+	dispatch_data_t third = dispatch_data_create(bytes + 40, sizeof(bytes) - 40, NULL, DISPATCH_DATA_DESTRUCTOR_DEFAULT);
+	dispatch_data_t head = dispatch_data_create_concat(first, second);
+	dispatch_data_t ddata = dispatch_data_create_concat(head, third);
+	xpc_object_t split = xpc_data_create_with_dispatch_data(ddata);
+	xpc_object_t flat = xpc_data_create(bytes, sizeof(bytes));
+	xpc_object_t different = xpc_data_create(other_bytes, sizeof(other_bytes));
+
+	// how the data happens to be split up doesn't matter, only the bytes do
+	ASSERT_TRUE(xpc_equal(split, flat));
+	ASSERT_TRUE(xpc_equal(flat, split));
+	ASSERT_EQUAL_U(xpc_hash(flat), xpc_hash(split));
+	ASSERT_FALSE(xpc_equal(split, different));
+	ASSERT_FALSE(xpc_equal(different, split));
+
+	xpc_release(different);
+	xpc_release(flat);
+	xpc_release(split);
+	dispatch_release(ddata);
+	dispatch_release(head);
+	dispatch_release(third);
+	dispatch_release(second);
+	dispatch_release(first);
+};
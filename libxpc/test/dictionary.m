@@ -19,6 +19,10 @@
 
 #include "ctest-plus.h"
 #include <xpc/private.h>
+#import <xpc/objects/dictionary.h>
+#import <xpc/objects/serializer.h>
+#import <xpc/objects/deserializer.h>
+#import <xpc/serialization.h>
 #include "test-util.h"
 
 CTEST_DATA(dictionary) {
@@ -138,3 +142,295 @@ CTEST2(dictionary, apply) {
 //
 // if the basic API works, everything should work
 // (all the getters and setters use the basic API to do their stuff)
+
+CTEST(dictionary, many_keys) {
+	const size_t count = 10000;
+	xpc_object_t dict = xpc_dictionary_create(NULL, NULL, 0);
+	char key[32];
+	__block size_t expected = 0;
+
+	for (size_t i = 0; i < count; ++i) {
+		snprintf(key, sizeof(key), "key-%zu", i);
+		xpc_dictionary_set_uint64(dict, key, i);
+	}
+	ASSERT_EQUAL_U(count, xpc_dictionary_get_count(dict));
+
+	for (size_t i = 0; i < count; ++i) {
+		snprintf(key, sizeof(key), "key-%zu", i);
+		ASSERT_EQUAL_U(i, xpc_dictionary_get_uint64(dict, key));
+	}
+
+	// iteration follows insertion order
+	xpc_dictionary_apply(dict, ^bool(const char* key, xpc_object_t value) {
+		ASSERT_EQUAL_U(expected, xpc_uint64_get_value(value));
+		++expected;
+		return true;
+	});
+	ASSERT_EQUAL_U(count, expected);
+
+	// removing entries shouldn't disturb lookups of the remaining ones
+	for (size_t i = 0; i < count; i += 2) {
+		snprintf(key, sizeof(key), "key-%zu", i);
+		xpc_dictionary_set_value(dict, key, NULL);
+	}
+	ASSERT_EQUAL_U(count / 2, xpc_dictionary_get_count(dict));
+
+	for (size_t i = 0; i < count; ++i) {
+		snprintf(key, sizeof(key), "key-%zu", i);
+		if (i % 2 == 0) {
+			ASSERT_NULL(xpc_dictionary_get_value(dict, key));
+		} else {
+			ASSERT_EQUAL_U(i, xpc_dictionary_get_uint64(dict, key));
+		}
+	}
+
+	xpc_release(dict);
+};
+
+CTEST(dictionary, create_large) {
+	const char* keys[16];
+	xpc_object_t values[16];
+	char names[16][8];
+	xpc_object_t dict = NULL;
+	xpc_object_t copy = NULL;
+
+	for (size_t i = 0; i < 16; ++i) {
+		snprintf(names[i], sizeof(names[i]), "k%zu", i);
+		keys[i] = names[i];
+		values[i] = xpc_int64_create(i);
+	}
+
+	// too many entries for inline storage, so the dictionary is allocated without it
+	dict = xpc_dictionary_create(keys, values, 16);
+	ASSERT_EQUAL_U(16, xpc_dictionary_get_count(dict));
+	ASSERT_EQUAL(15, xpc_dictionary_get_int64(dict, "k15"));
+
+	xpc_dictionary_set_int64(dict, "extra", 42);
+	xpc_dictionary_set_value(dict, "k0", NULL);
+	ASSERT_EQUAL_U(16, xpc_dictionary_get_count(dict));
+	ASSERT_EQUAL(42, xpc_dictionary_get_int64(dict, "extra"));
+	ASSERT_NULL(xpc_dictionary_get_value(dict, "k0"));
+
+	copy = xpc_copy(dict);
+	ASSERT_TRUE(xpc_equal(dict, copy));
+
+	xpc_release(copy);
+	xpc_release(dict);
+	for (size_t i = 0; i < 16; ++i) {
+		xpc_release(values[i]);
+	}
+};
+
+CTEST(dictionary, key_handles) {
+	xpc_key_t key = xpc_dictionary_key_create("routine");
+	xpc_object_t dict = xpc_dictionary_create(NULL, NULL, 0);
+
+	ASSERT_NOT_NULL(key);
+	ASSERT_STR("routine", xpc_dictionary_key_get_string(key));
+
+	// entries set with a handle can be found with a plain key and vice versa
+	xpc_dictionary_set_uint64_k(dict, key, 42);
+	ASSERT_EQUAL_U(42, xpc_dictionary_get_uint64(dict, "routine"));
+
+	xpc_dictionary_set_uint64(dict, "routine", 43);
+	ASSERT_EQUAL_U(43, xpc_dictionary_get_uint64_k(dict, key));
+	ASSERT_EQUAL_U(1, xpc_dictionary_get_count(dict));
+
+	// ...including once the dictionary outgrows its inline storage
+	for (size_t i = 0; i < 32; ++i) {
+		char name[32];
+		snprintf(name, sizeof(name), "key-%zu", i);
+		xpc_dictionary_set_bool(dict, name, true);
+	}
+	ASSERT_EQUAL_U(43, xpc_dictionary_get_uint64_k(dict, key));
+
+	xpc_dictionary_set_value_k(dict, key, NULL);
+	ASSERT_NULL(xpc_dictionary_get_value(dict, "routine"));
+
+	xpc_release(dict);
+};
+
+CTEST(dictionary, copy_on_write) {
+	xpc_object_t original = xpc_dictionary_create(NULL, NULL, 0);
+	xpc_object_t nested = xpc_dictionary_create(NULL, NULL, 0);
+	xpc_object_t copy = NULL;
+	char key[32];
+
+	// enough entries that the storage is out-of-line (and therefore shared)
+	for (size_t i = 0; i < 64; ++i) {
+		snprintf(key, sizeof(key), "key-%zu", i);
+		xpc_dictionary_set_uint64(original, key, i);
+	}
+	xpc_dictionary_set_bool(nested, "flag", true);
+	xpc_dictionary_set_value(original, "nested", nested);
+
+	copy = xpc_copy(original);
+	ASSERT_EQUAL_U(65, xpc_dictionary_get_count(copy));
+
+	// nested containers are still shared, so each side hands out its own copy of them (and keeps handing out that same copy)
+	ASSERT_TRUE(xpc_equal(nested, xpc_dictionary_get_value(original, "nested")));
+	ASSERT_EQUAL((intptr_t)xpc_dictionary_get_value(original, "nested"), (intptr_t)xpc_dictionary_get_value(original, "nested"));
+
+	// modifying the copy doesn't affect the original...
+	xpc_dictionary_set_uint64(copy, "key-0", 100);
+	xpc_dictionary_set_value(copy, "key-1", NULL);
+	ASSERT_EQUAL_U(0, xpc_dictionary_get_uint64(original, "key-0"));
+	ASSERT_EQUAL_U(1, xpc_dictionary_get_uint64(original, "key-1"));
+	ASSERT_EQUAL_U(100, xpc_dictionary_get_uint64(copy, "key-0"));
+	ASSERT_NULL(xpc_dictionary_get_value(copy, "key-1"));
+
+	// ...and neither does modifying nested containers on either side
+	xpc_dictionary_set_bool(xpc_dictionary_get_value(original, "nested"), "flag", false);
+	ASSERT_TRUE(xpc_dictionary_get_bool(xpc_dictionary_get_value(copy, "nested"), "flag"));
+	ASSERT_NOT_EQUAL((intptr_t)xpc_dictionary_get_value(original, "nested"), (intptr_t)xpc_dictionary_get_value(copy, "nested"));
+
+	xpc_release(nested);
+	xpc_release(original);
+	ASSERT_EQUAL_U(64, xpc_dictionary_get_count(copy));
+	ASSERT_EQUAL_U(63, xpc_dictionary_get_uint64(copy, "key-63"));
+
+	xpc_release(copy);
+};
+
+CTEST(dictionary, deep_equality) {
+	xpc_object_t first = xpc_dictionary_create(NULL, NULL, 0);
+	xpc_object_t second = xpc_dictionary_create(NULL, NULL, 0);
+	xpc_object_t nested = xpc_dictionary_create(NULL, NULL, 0);
+
+	xpc_dictionary_set_string(nested, "name", "job");
+	xpc_dictionary_set_value(first, "nested", nested);
+	xpc_release(nested);
+	xpc_dictionary_set_int64(first, "a", 1);
+	xpc_dictionary_set_int64(first, "b", 2);
+
+	// same contents, inserted in a different order
+	nested = xpc_dictionary_create(NULL, NULL, 0);
+	xpc_dictionary_set_string(nested, "name", "job");
+	xpc_dictionary_set_int64(second, "b", 2);
+	xpc_dictionary_set_int64(second, "a", 1);
+	xpc_dictionary_set_value(second, "nested", nested);
+
+	ASSERT_TRUE(xpc_equal(first, second));
+	ASSERT_EQUAL_U(xpc_hash(first), xpc_hash(second));
+
+	// swapping values between keys makes them different
+	xpc_dictionary_set_int64(second, "a", 2);
+	xpc_dictionary_set_int64(second, "b", 1);
+	ASSERT_FALSE(xpc_equal(first, second));
+	xpc_dictionary_set_int64(second, "a", 1);
+	xpc_dictionary_set_int64(second, "b", 2);
+	ASSERT_TRUE(xpc_equal(first, second));
+
+	// so does modifying a nested dictionary, even though the outer one has already cached its hash
+	xpc_dictionary_set_string(nested, "name", "other");
+	ASSERT_FALSE(xpc_equal(first, second));
+	ASSERT_NOT_EQUAL_U(xpc_hash(first), xpc_hash(second));
+
+	xpc_release(nested);
+	xpc_release(second);
+	xpc_release(first);
+};
+
+CTEST(dictionary, hash_after_leaf_modification) {
+	xpc_object_t first = xpc_dictionary_create(NULL, NULL, 0);
+	xpc_object_t second = xpc_dictionary_create(NULL, NULL, 0);
+	xpc_object_t name = xpc_string_create("job");
+	size_t originalHash = 0;
+
+	xpc_dictionary_set_value(first, "name", name);
+	xpc_dictionary_set_string(second, "name", "job");
+	ASSERT_TRUE(xpc_equal(first, second));
+	originalHash = xpc_hash(first);
+
+	// objects can be modified while they're in a dictionary, after it has already cached its hash
+	xpc_string_set_value(name, "other");
+	ASSERT_FALSE(xpc_equal(first, second));
+	ASSERT_NOT_EQUAL_U(originalHash, xpc_hash(first));
+
+	xpc_string_set_value(name, "job");
+	ASSERT_TRUE(xpc_equal(first, second));
+	ASSERT_EQUAL_U(originalHash, xpc_hash(first));
+
+	xpc_release(name);
+	xpc_release(second);
+	xpc_release(first);
+};
+
+CTEST(dictionary, received_drops_message) {
+	xpc_object_t sent = xpc_dictionary_create(NULL, NULL, 0);
+
+	xpc_dictionary_set_string(sent, "name", "job");
+	xpc_dictionary_set_string(sent, "path", "/usr/libexec/job");
+	xpc_dictionary_set_int64(sent, "pid", 42);
+
+	@autoreleasepool {
+		XPC_CLASS(serializer)* serializer = [XPC_CLASS(serializer) serializer];
+		ASSERT_TRUE([serializer writeObject: XPC_CAST(object, sent)]);
+		dispatch_mach_msg_t mach = [serializer finalizeWithRemotePort: MACH_PORT_NULL localPort: MACH_PORT_NULL asReply: NO expectingReply: NO];
+		ASSERT_NOT_NULL(mach);
+		// `process:` consumes the message, but the serializer still owns it
+		dispatch_retain(mach);
+		xpc_object_t received = [[XPC_CLASS(deserializer) process: mach] retain];
+		struct xpc_dictionary_s* receivedDict = (struct xpc_dictionary_s*)received;
+		ASSERT_NOT_NULL(received);
+
+		// the copy still needs the message for the entries that haven't been created yet
+		xpc_object_t copy = xpc_copy(received);
+		struct xpc_dictionary_s* copyDict = (struct xpc_dictionary_s*)copy;
+		ASSERT_NOT_NULL(copyDict->deserializer);
+
+		// once every entry has been created, the message isn't needed anymore
+		ASSERT_NOT_NULL(receivedDict->deserializer);
+		ASSERT_STR("job", xpc_dictionary_get_string(received, "name"));
+		ASSERT_NOT_NULL(receivedDict->deserializer);
+		ASSERT_STR("/usr/libexec/job", xpc_dictionary_get_string(received, "path"));
+		ASSERT_NOT_NULL(receivedDict->deserializer);
+		ASSERT_EQUAL(42, xpc_dictionary_get_int64(received, "pid"));
+		ASSERT_NULL(receivedDict->deserializer);
+
+		// ...and neither is it once the entries that haven't been created yet are gone
+		xpc_dictionary_set_value(copy, "name", NULL);
+		xpc_dictionary_set_string(copy, "path", "/usr/libexec/other");
+		ASSERT_NOT_NULL(copyDict->deserializer);
+		xpc_dictionary_set_value(copy, "pid", NULL);
+		ASSERT_NULL(copyDict->deserializer);
+		ASSERT_STR("/usr/libexec/other", xpc_dictionary_get_string(copy, "path"));
+
+		xpc_release(copy);
+		xpc_release(received);
+	}
+
+	xpc_release(sent);
+};
+
+CTEST(dictionary, send_reuses_buffers) {
+	xpc_object_t message = xpc_dictionary_create(NULL, NULL, 0);
+	xpc_serial_buffer_statistics_t before;
+	xpc_serial_buffer_statistics_t after;
+	char key[32];
+	const size_t sends = 100;
+
+	// a typical request: lots of small writes
+	for (size_t i = 0; i < 32; ++i) {
+		snprintf(key, sizeof(key), "key-%zu", i);
+		xpc_dictionary_set_string(message, key, "value");
+	}
+
+	// the first send on this thread may have to allocate a buffer; every send after that should reuse it
+	for (size_t i = 0; i <= sends; ++i) {
+		if (i == 1) {
+			xpc_serial_get_buffer_statistics(&before);
+		}
+		@autoreleasepool {
+			XPC_CLASS(serializer)* serializer = [XPC_CLASS(serializer) serializer];
+			ASSERT_TRUE([serializer writeObject: XPC_CAST(object, message)]);
+			ASSERT_NOT_NULL([serializer finalizeWithRemotePort: MACH_PORT_NULL localPort: MACH_PORT_NULL asReply: NO expectingReply: NO]);
+		}
+	}
+	xpc_serial_get_buffer_statistics(&after);
+
+	ASSERT_EQUAL_U(before.allocations, after.allocations);
+	ASSERT_TRUE(after.reuses - before.reuses >= sends);
+
+	xpc_release(message);
+};
@@ -86,3 +86,48 @@ CTEST(string, set_value) {
 	ASSERT_STR("new string", xpc_string_get_string_ptr(string));
 	xpc_release(string);
 };
+
+CTEST(string, short_and_long) {
+	// short strings are stored inline and long ones aren't, so make sure switching between them works in both directions
+	const char* longString = "this string is definitely too long to be stored inline";
+	xpc_object_t string = xpc_string_create(INITIAL_STRING_LITERAL);
+	xpc_object_t formatted = xpc_string_create_with_format("%s", longString);
+
+	xpc_string_set_value(string, longString);
+	ASSERT_STR(longString, xpc_string_get_string_ptr(string));
+	ASSERT_EQUAL_U(strlen(longString), xpc_string_get_length(string));
+
+	xpc_string_set_value(string, INITIAL_STRING_LITERAL);
+	ASSERT_STR(INITIAL_STRING_LITERAL, xpc_string_get_string_ptr(string));
+	ASSERT_EQUAL_U(INITIAL_STRING_LENGTH, xpc_string_get_length(string));
+
+	ASSERT_STR(longString, xpc_string_get_string_ptr(formatted));
+	ASSERT_EQUAL_U(strlen(longString), xpc_string_get_length(formatted));
+
+	xpc_release(formatted);
+	xpc_release(string);
+};
+
+CTEST(string, builder) {
+	xpc_string_builder_t builder;
+	xpc_object_t string = NULL;
+	char expected[1024 * 4 + 1];
+
+	xpc_string_builder_init(&builder, 0);
+	for (size_t i = 0; i < 1024; ++i) {
+		ASSERT_TRUE(xpc_string_builder_append(&builder, "abc", 3));
+		ASSERT_TRUE(xpc_string_builder_append_format(&builder, "%d", (int)(i % 10)));
+		snprintf(&expected[i * 4], 5, "abc%d", (int)(i % 10));
+	}
+
+	string = xpc_string_builder_finish(&builder);
+	ASSERT_NOT_NULL(string);
+	ASSERT_EQUAL_U(sizeof(expected) - 1, xpc_string_get_length(string));
+	ASSERT_STR(expected, xpc_string_get_string_ptr(string));
+
+	// the builder is empty again afterwards
+	xpc_release(string);
+	string = xpc_string_builder_finish(&builder);
+	ASSERT_STR("", xpc_string_get_string_ptr(string));
+	xpc_release(string);
+};
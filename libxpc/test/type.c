@@ -31,3 +31,28 @@ CTEST(type, get_type_name) {
 	ASSERT_STR("OS_xpc_int64", xpc_type_get_name(xpc_get_type(obj)));
 	xpc_release(obj);
 };
+
+CTEST(type, checked_accessors) {
+	// the C API checks types without messaging, so make sure it still rejects the wrong types (and NULL)
+	xpc_object_t integer = xpc_int64_create(5000);
+	xpc_object_t string = xpc_string_create("foo");
+	xpc_object_t dict = xpc_dictionary_create(NULL, NULL, 0);
+
+	ASSERT_EQUAL_PTR(XPC_TYPE_INT64, xpc_get_type(integer));
+	ASSERT_EQUAL_PTR(XPC_TYPE_STRING, xpc_get_type(string));
+	ASSERT_EQUAL(5000, xpc_int64_get_value(integer));
+	ASSERT_EQUAL(0, xpc_int64_get_value(string));
+	ASSERT_EQUAL(0, xpc_int64_get_value(NULL));
+	ASSERT_NULL(xpc_string_get_string_ptr(integer));
+	ASSERT_EQUAL_U(0, xpc_dictionary_get_count(string));
+
+	xpc_dictionary_set_value(dict, "integer", integer);
+	ASSERT_EQUAL_PTR(integer, xpc_dictionary_get_value(dict, "integer"));
+	ASSERT_EQUAL_U(0, xpc_dictionary_get_uint64(dict, "integer"));
+	ASSERT_NULL(xpc_dictionary_get_value(dict, "missing"));
+	ASSERT_NULL(xpc_dictionary_get_value(string, "integer"));
+
+	xpc_release(dict);
+	xpc_release(string);
+	xpc_release(integer);
+};
@@ -23,12 +23,57 @@
 #import <xpc/objects/base.h>
 #import <Foundation/NSEnumerator.h>
 
+#include <stdatomic.h>
+#include <os/lock.h>
+
 XPC_CLASS_DECL(array);
 
+// the kinds of values that packed arrays can store without creating an object for each of them
+typedef enum xpc_array_packed_type {
+	XPC_ARRAY_PACKED_NONE,
+	XPC_ARRAY_PACKED_BOOL,
+	XPC_ARRAY_PACKED_INT64,
+	XPC_ARRAY_PACKED_UINT64,
+	XPC_ARRAY_PACKED_DOUBLE,
+} xpc_array_packed_type_t;
+
+// a single unboxed value. bools are stored in `uint64` as 0 or 1.
+typedef union xpc_array_packed_value {
+	int64_t int64;
+	uint64_t uint64;
+	double double_value;
+} xpc_array_packed_value_t;
+
 struct xpc_array_s {
 	struct xpc_object_s base;
 	unsigned long size; // not NSUInteger or size_t because it needs to be `unsigned long` in 32-bit builds as well
+	// allocated with `xpc_shared_alloc`; copies of the array share it until one of them is modified (see `copy`)
+	//
+	// for packed arrays, this is instead a private cache of objects for the values in `packed`.
+	// it's allocated with `calloc` the first time someone asks for an object and each object in it is only created when needed.
 	XPC_CLASS(object)** array;
+	// number of objects `array` (or values `packed`) has room for
+	NSUInteger capacity;
+	// if this isn't `XPC_ARRAY_PACKED_NONE`, our values are stored unboxed in `packed` instead.
+	// adding an object of any other type turns us back into a normal array.
+	xpc_array_packed_type_t packed_type;
+	// allocated with `xpc_shared_alloc` and shared with copies, just like `array` is for normal arrays
+	xpc_array_packed_value_t* packed;
+	// protects the lazy creation of objects in `array` for packed arrays (and of `borrowed_copies` for normal ones)
+	os_unfair_lock box_lock;
+	// set once our mutable objects may also be in a copy of us (or in whatever we were copied from); see `copy`.
+	// until we're modified, we hand out our own copies of those objects instead of the shared ones.
+	atomic_bool borrows_children;
+	// our own copies of shared mutable objects, by index (`nil` for ones that haven't been handed out yet).
+	// allocated and filled in under `box_lock` as they're handed out; they replace the shared objects once we're modified.
+	XPC_CLASS(object)** borrowed_copies;
+	NSUInteger borrowed_copies_capacity;
+	// cached hash of our immutable objects (see `hash`) and whether it's valid; reset whenever we're modified.
+	// mutable objects can change behind our back, so their hashes are always recomputed (unless we didn't have any).
+	NSUInteger leaf_hash;
+	atomic_uchar leaf_hash_state;
+	// the leaf generation `leaf_hash` was computed in; other objects can be modified in place too, so it's only valid during that generation
+	size_t leaf_hash_generation;
 };
 
 @interface XPC_CLASS_INTERFACE(array)
@@ -39,8 +84,29 @@ struct xpc_array_s {
 
 - (instancetype)initWithObjects: (XPC_CLASS(object)* const*)objects count: (NSUInteger)count;
 
+/**
+ * Initializes an empty array with room for the given number of objects.
+ */
+- (instancetype)initWithCapacity: (NSUInteger)capacity;
+
+/**
+ * Initializes a packed array with a copy of the given values, which are an array of `bool`s, `int64_t`s, `uint64_t`s, or `double`s, depending on `type`.
+ */
+- (instancetype)initWithPackedType: (xpc_array_packed_type_t)type values: (const void*)values count: (NSUInteger)count;
+
+/**
+ * Creates a new packed array from serialized array content (i.e. the entries that follow the entry count)
+ * if all of the entries are the same kind of primitive, reading all of them at once.
+ * Returns `nil` if they're not, in which case the content has to be decoded normally.
+ *
+ * The returned array is retained.
+ */
++ (instancetype)newPackedWithSerializedContent: (const void*)content length: (NSUInteger)length count: (NSUInteger)count;
+
 - (XPC_CLASS(object)*)objectAtIndex: (NSUInteger)index;
 - (void)addObject: (XPC_CLASS(object)*)object;
+// like calling `addObject:` for each object, but room for all of them is made at once
+- (void)addObjects: (XPC_CLASS(object)* const*)objects count: (NSUInteger)count;
 - (void)replaceObjectAtIndex: (NSUInteger)index withObject: (XPC_CLASS(object)*)object;
 - (void)enumerateObjectsUsingBlock: (void (^)(XPC_CLASS(object)* object, NSUInteger index, BOOL* stop))block;
 - (XPC_CLASS(object)*)objectAtIndexedSubscript: (NSUInteger)index;
@@ -24,6 +24,8 @@
 #import <objc/NSObject.h>
 #import <xpc/internal_base.h>
 
+#include <string.h>
+
 #define __XPC_INDIRECT__
 #import <xpc/base.h>
 
@@ -62,6 +64,15 @@ XPC_IGNORE_DUPLICATE_PROTOCOL_POP;
 
 #define XPC_WRAPPER_CLASS_IMPL(name, type, format) \
 	XPC_CLASS_SYMBOL_DECL(name); \
+	/* equivalent to `[[XPC_CLASS(name) alloc] initWithValue: value]`, but without any messages; used by the C API */ \
+	XPC_INLINE \
+	XPC_CLASS(name)* xpc_ ## name ## _alloc_with_value(type value) { \
+		XPC_CLASS(name)* object = XPC_OBJECT_ALLOC(name); \
+		if (object != nil) { \
+			((struct xpc_ ## name ## _s*)object)->value = value; \
+		} \
+		return object; \
+	} \
 	OS_OBJECT_NONLAZY_CLASS \
 	@implementation XPC_CLASS(name) \
 	XPC_CLASS_HEADER(name); \
@@ -71,6 +82,10 @@ XPC_IGNORE_DUPLICATE_PROTOCOL_POP;
 		asprintf(&output, "<%s: " format ">", xpc_class_name(self), self.value); \
 		return output; \
 	} \
+	- (void)describeTo: (xpc_description_writer_t*)writer \
+	{ \
+		xpc_description_printf(writer, "<%s: " format ">", xpc_class_name(self), self.value); \
+	} \
 	- (type)value \
 	{ \
 		XPC_THIS_DECL(name); \
@@ -79,7 +94,15 @@ XPC_IGNORE_DUPLICATE_PROTOCOL_POP;
 	- (void)setValue: (type)value \
 	{ \
 		XPC_THIS_DECL(name); \
+		if (XPC_OBJECT_IS_GLOBAL(this)) { \
+			/* everyone with an object for the same value shares this one, so modifying it would change their values too */ \
+			if (xpc_should_log()) { \
+				os_log_fault(xpc_get_log(), "ignoring attempt to modify a shared %s object; create a new object instead", xpc_class_name(self)); \
+			} \
+			return; \
+		} \
 		this->value = value; \
+		xpc_leaf_generation_advance(); \
 	} \
 	- (instancetype)initWithValue: (type)value \
 	{ \
@@ -94,9 +117,16 @@ XPC_IGNORE_DUPLICATE_PROTOCOL_POP;
 		XPC_THIS_DECL(name); \
 		return xpc_raw_data_hash(&this->value, sizeof(this->value)); \
 	} \
+	- (BOOL)isEqualToObject: (XPC_CLASS(object)*)object \
+	{ \
+		XPC_THIS_DECL(name); \
+		type other = XPC_CAST(name, object).value; \
+		return memcmp(&this->value, &other, sizeof(other)) == 0; \
+	} \
 	@end
 
-#define XPC_WRAPPER_CLASS_SERIAL_IMPL(name, type, serial_type, serial_U32_or_U64, serial_uint32_t_or_uint64_t) \
+// `create` creates an object for a deserialized value
+#define XPC_WRAPPER_CLASS_SERIAL_IMPL(name, type, serial_type, serial_U32_or_U64, serial_uint32_t_or_uint64_t, create) \
 	@implementation XPC_CLASS(name) (XPCSerialization) \
 	- (BOOL)serializable \
 	{ \
@@ -120,7 +150,7 @@ XPC_IGNORE_DUPLICATE_PROTOCOL_POP;
 		if (![deserializer read ## serial_U32_or_U64: &value]) { \
 			goto error_out; \
 		} \
-		result = [[[self class] alloc] initWithValue: (type)value]; \
+		result = XPC_CAST(name, create((type)value)); \
 		return result; \
 	error_out: \
 		if (result != nil) { \
@@ -128,6 +158,17 @@ XPC_IGNORE_DUPLICATE_PROTOCOL_POP;
 		} \
 		return nil; \
 	} \
+	+ (BOOL)skip: (XPC_CLASS(deserializer)*)deserializer \
+	{ \
+		xpc_serial_type_t inputType = XPC_SERIAL_TYPE_INVALID; \
+		if (![deserializer readU32: &inputType]) { \
+			return NO; \
+		} \
+		if (inputType != XPC_SERIAL_TYPE_ ## serial_type) { \
+			return NO; \
+		} \
+		return [deserializer read ## serial_U32_or_U64: NULL]; \
+	} \
 	- (BOOL)serialize: (XPC_CLASS(serializer)*)serializer \
 	{ \
 		XPC_THIS_DECL(name); \
@@ -153,6 +194,14 @@ XPC_IGNORE_DUPLICATE_PROTOCOL_POP;
 
 #define XPC_OBJC_CLASS(name) ((Class)&XPC_CLASS_SYMBOL(name))
 
+// allocates a new instance of the given class directly, without going through `alloc` (and `allocWithZone:` and `instanceSize`).
+// this is what `-[XPC_CLASS(object) allocWithZone:]` does, so it's only useful for C constructors that initialize the instance themselves
+// (or that want to skip just the allocation messages); our base `init` doesn't do anything.
+#define XPC_OBJECT_ALLOC(name) ((XPC_CLASS(name)*)_os_object_alloc_realized(XPC_OBJC_CLASS(name), sizeof(struct xpc_ ## name ## _s)))
+
+// global objects are shared by everyone (and are never deallocated), so they must never be modified either
+#define XPC_OBJECT_IS_GLOBAL(this) ((this)->base.os_obj_ref_cnt == _OS_OBJECT_GLOBAL_REFCNT)
+
 #define XPC_GLOBAL_OBJECT_HEADER(className) \
 	.os_obj_isa = (const struct xpc_object_vtable_s*)XPC_OBJC_CLASS(className), \
 	.os_obj_ref_cnt = _OS_OBJECT_GLOBAL_REFCNT, \
@@ -174,6 +223,9 @@ struct xpc_object_s {
 	);
 };
 
+// see `xpc/util.h`
+typedef struct xpc_description_writer_s xpc_description_writer_t;
+
 XPC_EXPORT
 @interface XPC_CLASS(object) : OS_OBJECT_CLASS(object) <XPC_CLASS(object)>
 
@@ -182,6 +234,15 @@ XPC_EXPORT
 // note that this method returns a string that must be freed
 - (char*)xpcDescription;
 
+// writes this object's description into the given writer.
+// the default implementation just writes `xpcDescription`; containers override this to write their children straight into the writer.
+- (void)describeTo: (xpc_description_writer_t*)writer;
+
+// compares this object's contents with those of another object of the same class and with the same hash.
+// `isEqual:` takes care of those cheap checks (and of identity) before calling this, so implementations only need to compare contents.
+// by default, objects are only equal to themselves.
+- (BOOL)isEqualToObject: (XPC_CLASS(object)*)object;
+
 @end
 
 @class XPC_CLASS(serializer);
@@ -195,10 +256,28 @@ XPC_EXPORT
 // use `xpc_serial_padded_length` for each component of the serialization.
 @property(readonly) NSUInteger serializationLength;
 
+// like `serializationLength`, but containers should measure their children using `-[XPC_CLASS(serializer) lengthOfObject:]`
+// so that the lengths can be cached for the rest of the message. `serializer` may be `nil`.
+// the default implementation just returns `serializationLength`.
+- (NSUInteger)serializationLengthWithSerializer: (XPC_CLASS(serializer)*)serializer;
+
 + (instancetype)deserialize: (XPC_CLASS(deserializer)*)deserializer;
 
 - (BOOL)serialize: (XPC_CLASS(serializer)*)serializer;
 
 @end
 
+// optional extension to `XPCSerialization` for classes whose serial representation is entirely self-contained
+// (i.e. it doesn't reference any ports or OOL memory). there's no default implementation; check with `respondsToSelector:`.
+//
+// dictionaries received in messages use this to validate such entries up front but only create them when they're first accessed.
+// objects whose type carries `XPC_SERIAL_TYPE_FLAG_OOL` are never skipped, since their content lives outside the message body.
+@interface XPC_CLASS(object) (XPCSerializationSkipping)
+
+// advances the deserializer past a serialized instance of this class, checking that it's well-formed without actually creating it.
+// returns `NO` if the serialized object is invalid.
++ (BOOL)skip: (XPC_CLASS(deserializer)*)deserializer;
+
+@end
+
 #endif // _XPC_OBJECTS_BASE_H_
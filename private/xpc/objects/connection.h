@@ -32,6 +32,7 @@
 #import <xpc/xpc.h>
 #import <xpc/connection.h>
 #import <xpc/generic_array.h>
+#import <xpc/objects/deserializer.h>
 
 #include <stdatomic.h>
 
@@ -69,6 +70,10 @@ struct xpc_connection_s {
     //
     mach_port_t recv_port;
     mach_port_t checkin_port;
+    // limits that incoming messages have to stay within (server peers inherit these from their listener)
+    xpc_deserial_limits_t message_limits;
+    // whether incoming messages are validated in full before any objects are created for them (also inherited by server peers)
+    bool validates_messages;
 
     //
     // mutable only when locked
@@ -111,6 +116,8 @@ struct xpc_connection_s {
 @property(readonly) mach_port_t receivePort;
 @property(strong) dispatch_queue_t targetQueue;
 @property(assign /* actually weak */) XPC_CLASS(connection)* parentServer;
+@property(assign) xpc_deserial_limits_t messageLimits;
+@property(assign) BOOL validatesMessages;
 
 - (instancetype)initAsClientForService: (const char*)serviceName queue: (dispatch_queue_t)queue;
 - (instancetype)initAsServerForService: (const char*)serviceName queue: (dispatch_queue_t)queue;
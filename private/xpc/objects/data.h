@@ -23,11 +23,17 @@
 #import <xpc/objects/base.h>
 #import <dispatch/dispatch.h>
 
+#include <stdatomic.h>
+
 XPC_CLASS_DECL(data);
 
 struct xpc_data_s {
 	struct xpc_object_s base;
 	dispatch_data_t data;
+	// whether `data` references memory that belongs to something larger (e.g. a received message)
+	BOOL borrowed;
+	// cached hash of the contents (0 if it hasn't been computed yet); reset whenever the contents are replaced
+	atomic_size_t cached_hash;
 };
 
 @interface XPC_CLASS_INTERFACE(data)
@@ -40,10 +46,18 @@ struct xpc_data_s {
 
 - (instancetype)initWithBytes: (const void*)bytes length: (NSUInteger)length;
 - (instancetype)initWithDispatchData: (dispatch_data_t)data;
+// like `initWithDispatchData:`, but notes that the data borrows memory from something larger (like a received message),
+// so copies of this object copy the bytes rather than keeping the original memory alive
+- (instancetype)initWithBorrowedDispatchData: (dispatch_data_t)data;
 
 // NOTE: deviates from NSData by returning the number of bytes copied
 - (NSUInteger)getBytes: (void*)buffer length: (NSUInteger)length;
 
+// non-NSData method
+// like `getBytes:length:`, but starts copying at the given offset into the data.
+// this copies each region of the underlying dispatch data directly, so it never has to flatten it.
+- (NSUInteger)getBytes: (void*)buffer offset: (NSUInteger)offset length: (NSUInteger)length;
+
 // non-NSData method
 - (void)replaceBytesWithBytes: (const void*)bytes length: (NSUInteger)length;
 
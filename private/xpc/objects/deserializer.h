@@ -27,6 +27,7 @@
 #define __DISPATCH_INDIRECT__ 1
 #endif
 #include <dispatch/mach_private.h>
+#include <os/lock.h>
 
 #define MACH_MSG_RECV_DISPOSITION_FIRST MACH_MSG_TYPE_PORT_NAME
 #define MACH_MSG_RECV_DISPOSITION_LAST  MACH_MSG_TYPE_PORT_SEND_ONCE
@@ -42,6 +43,23 @@ typedef struct xpc_deserial_port_array {
 	size_t offset;
 } xpc_deserial_port_array_t;
 
+// a VM region that was received in an out-of-line memory descriptor.
+// `address` is reset to `NULL` once ownership of the region is taken by an object.
+typedef struct xpc_deserial_ool_region {
+	void* address;
+	size_t size;
+} xpc_deserial_ool_region_t;
+
+// limits on what a single message may contain. 0 means "unlimited" for each of them.
+typedef struct xpc_deserial_limits {
+	// maximum number of containers nested within each other (the root object counts as the first level)
+	size_t max_depth;
+	// maximum number of objects (including containers, but not dictionary keys) in the entire message
+	size_t max_objects;
+	// maximum size of the message content, including any out-of-line memory
+	size_t max_bytes;
+} xpc_deserial_limits_t;
+
 struct xpc_deserializer_s {
 	struct xpc_object_s base;
 	dispatch_mach_msg_t mach_msg;
@@ -49,6 +67,14 @@ struct xpc_deserializer_s {
 	size_t offset;
 	const void* buffer;
 	xpc_deserial_port_array_t port_arrays[MACH_MSG_RECV_DISPOSITION_COUNT];
+	xpc_deserial_ool_region_t* ool_regions;
+	size_t ool_region_count;
+	size_t borrow_threshold;
+	// serializes deserialization of skipped objects (see `readObjectAtOffset:into:`)
+	os_unfair_lock lazy_lock;
+	xpc_deserial_limits_t limits;
+	// number of objects read so far (for `limits.max_objects`)
+	size_t object_count;
 };
 
 @class XPC_CLASS(dictionary);
@@ -62,6 +88,18 @@ struct xpc_deserializer_s {
  */
 @property(readonly) mach_port_t remotePort;
 
+/**
+ * Data and string content of at least this many bytes borrows the message buffer instead of being copied out of it (see `borrowRegion:length:`).
+ * Defaults to `XPC_SERIAL_BORROW_DEFAULT_THRESHOLD`; 0 disables borrowing entirely.
+ */
+@property NSUInteger borrowThreshold;
+
+/**
+ * Limits that the message has to stay within for `readObject:` and `validate` to succeed.
+ * By default, there are no limits.
+ */
+@property xpc_deserial_limits_t limits;
+
 /**
  * Creates a new, autoreleased deserializer for the given message.
  */
@@ -77,9 +115,21 @@ struct xpc_deserializer_s {
  *
  * @note This method consumes the message passed in (regardless of whether it succeeds or not),
  *       so you should not use it anymore after passing it to this method.
+ *       If it fails, the message's reply right (if it had one) is released too.
  */
 + (XPC_CLASS(dictionary)*)process: (dispatch_mach_msg_t)message;
 
+/**
+ * Like `process:`, but if `validate` is `YES`, the entire message is validated (see `validate`) before any objects are created.
+ */
++ (XPC_CLASS(dictionary)*)process: (dispatch_mach_msg_t)message validate: (BOOL)validate;
+
+/**
+ * Like `process:validate:`, but the message is also rejected if it doesn't stay within the given limits (see `limits`).
+ * `limits` may be `NULL`, in which case there are no limits.
+ */
++ (XPC_CLASS(dictionary)*)process: (dispatch_mach_msg_t)message validate: (BOOL)validate limits: (const xpc_deserial_limits_t*)limits;
+
 /**
  * Initializes this deserializer using the given Mach message.
  * Returns `nil` if the given message is not a valid XPC message.
@@ -106,8 +156,55 @@ struct xpc_deserializer_s {
 - (BOOL)readU32: (uint32_t*)value;
 - (BOOL)readU64: (uint64_t*)value;
 - (BOOL)readPort: (mach_port_t*)port type: (mach_msg_type_name_t)type;
+
+/**
+ * Reads the object at the current offset, along with everything nested within it.
+ * Nested containers are decoded iteratively with an explicit stack rather than by recursing into each one,
+ * so the amount of native stack used doesn't depend on the message and `limits` can be enforced as the message is decoded.
+ *
+ * Dictionary entries that can be skipped (see `XPCSerializationSkipping`) are only validated; they're created later with `readObjectAtOffset:into:`.
+ */
 - (BOOL)readObject: (XPC_CLASS(object)**)object;
 
+/**
+ * Checks that the object at the current offset (along with everything nested within it) is well-formed, without creating anything.
+ * Container sizes and entry counts, type tags, string terminators, padding, and OOL descriptor references are all checked.
+ * Nested containers are walked iteratively, so hostile nesting can't exhaust the stack. `limits` are also checked.
+ *
+ * This doesn't affect the current offset.
+ */
+- (BOOL)validate;
+
+/**
+ * Deserializes the object at the given offset and stores it into `slot`, unless `slot` already contains an object.
+ * This doesn't affect the current offset and is safe to call from any thread; concurrent callers with the same slot all end up with the same object.
+ *
+ * The stored object is retained; whoever owns the slot is responsible for releasing it.
+ */
+- (BOOL)readObjectAtOffset: (NSUInteger)offset into: (XPC_CLASS(object)**)slot;
+
+/**
+ * Returns a pointer to the message content at the given offset.
+ */
+- (const void*)contentAtOffset: (NSUInteger)offset;
+
+/**
+ * Reads an out-of-line memory descriptor index from the content and takes ownership of the corresponding region,
+ * returning a dispatch data object of the given length that deallocates the region once it dies.
+ * Each region can only be taken once. If `region` is not `NULL`, it receives the start of the region.
+ *
+ * The returned data object is retained; the caller must release it.
+ */
+- (BOOL)readOOL: (NSUInteger)length data: (dispatch_data_t*)data region: (const void**)region;
+
+/**
+ * Returns a dispatch data object that references the given region of the message content in place and keeps the message alive for as long as it lives.
+ * Returns `NULL` if content of the given length should not be borrowed (see `borrowThreshold`), in which case the caller should copy it instead.
+ *
+ * The returned data object is retained; the caller must release it.
+ */
+- (dispatch_data_t)borrowRegion: (const void*)region length: (NSUInteger)length;
+
 - (BOOL)peek: (void*)data length: (NSUInteger)length;
 - (BOOL)peekNoCopy: (NSUInteger)length region: (const void**)region;
 - (BOOL)peekString: (const char**)string;
@@ -22,29 +22,97 @@
 
 #import <xpc/objects/base.h>
 
-#include <sys/queue.h>
 #include <mach/mach.h>
+#include <stdatomic.h>
+#include <os/lock.h>
+#include <xpc/private.h>
 
 @class XPC_CLASS(string);
 @class XPC_CLASS(connection);
+@class XPC_CLASS(deserializer);
 
 XPC_CLASS_DECL(dictionary);
 
+// number of entries that are stored inline in the dictionary object itself.
+// most messages have fewer keys than this, so they never need a separate allocation for their entries.
+#define XPC_DICTIONARY_INLINE_CAPACITY 8
+
+// dictionaries with at most this many entries don't have a hash index; they're small enough that comparing fingerprints is faster.
+// dictionaries are promoted to out-of-line storage with an index once they outgrow their inline storage.
+#define XPC_DICTIONARY_INDEX_THRESHOLD XPC_DICTIONARY_INLINE_CAPACITY
+
+// a precomputed dictionary key (see `xpc_dictionary_key_create`)
+struct xpc_key_s {
+	// interned if possible (see `xpc_key_intern`); otherwise, a copy owned by the handle
+	const char* name;
+	size_t hash;
+	uint32_t fingerprint;
+};
+
 typedef struct xpc_dictionary_entry_s* xpc_dictionary_entry_t;
 struct xpc_dictionary_entry_s {
-	LIST_ENTRY(xpc_dictionary_entry_s) link;
+	// `nil` for entries of received dictionaries that haven't been accessed yet;
+	// in that case, `serial_offset` and `serial_length` describe where the serialized object is in the dictionary's `deserializer`.
+	// use `objectForEntry:` to make sure the object is created.
 	XPC_CLASS(object)* object;
-	char name[];
+	uint32_t serial_offset;
+	uint32_t serial_length;
+	// either the interned copy of the key (see `xpc_key_intern`) or, if `owns_name` is set, a copy owned by the entry.
+	// `NULL` for entries that have been removed (but not compacted away yet).
+	const char* name;
+	size_t hash;
+	bool owns_name;
 };
 
 struct xpc_dictionary_s {
 	struct xpc_object_s base;
+	// number of live entries
 	NSUInteger size;
-	LIST_HEAD(, xpc_dictionary_entry_s) head;
+	// entries in insertion order, including removed entries that haven't been compacted away yet.
+	// this points to `inline_entries` until the dictionary outgrows them; after that, it's allocated with `xpc_shared_alloc`
+	// and copies of the dictionary share it (along with `index`) until one of them is modified (see `copy`).
+	// `entries_capacity` is 0 if the entries aren't owned by the dictionary (i.e. for statically allocated dictionaries).
+	struct xpc_dictionary_entry_s* entries;
+	NSUInteger entries_used;
+	NSUInteger entries_capacity;
+	// open-addressing hash index into `entries`; each slot holds an entry index plus one (0 means empty).
+	// `NULL` for small dictionaries (see `XPC_DICTIONARY_INDEX_THRESHOLD`). `index_capacity` is always zero or a power of two.
+	uint32_t* index;
+	NSUInteger index_capacity;
 	XPC_CLASS(connection)* associatedConnection;
 	mach_port_t incoming_port;
 	mach_port_t outgoing_port;
 	audit_token_t associated_audit_token;
+	// for dictionaries received in messages with entries that haven't been created yet.
+	// it keeps the whole message (including its port rights and out-of-line memory) alive, so we drop it once `lazy_entries` reaches 0.
+	// readers that may need it have to go through `lazy_lock`, since it can be dropped while they're reading us.
+	XPC_CLASS(deserializer)* deserializer;
+	// number of our entries that may not have been created yet. only ever too high (for entries that a copy we share them with created for us),
+	// in which case we just keep `deserializer` around longer (or until we're modified, at which point they're counted again).
+	NSUInteger lazy_entries;
+	// set once our mutable objects may also be in a copy of us (or in whatever we were copied from); see `copy`.
+	// until we're modified, we hand out our own copies of those objects instead of the shared ones.
+	atomic_bool borrows_children;
+	// our own copies of shared mutable objects, by entry index (`nil` for ones that haven't been handed out yet).
+	// allocated and filled in under `lazy_lock` as they're handed out; they replace the shared objects once we're modified.
+	XPC_CLASS(object)** borrowed_copies;
+	NSUInteger borrowed_copies_capacity;
+	// protects whatever readers create lazily: `borrowed_copies`, entries that haven't been created yet, and `deserializer`
+	os_unfair_lock lazy_lock;
+	// cached hash of our keys and immutable objects (see `hash`) and whether it's valid; reset whenever we're modified.
+	// mutable objects can change behind our back, so their hashes are always recomputed (unless we didn't have any).
+	NSUInteger leaf_hash;
+	atomic_uchar leaf_hash_state;
+	// the leaf generation `leaf_hash` was computed in; other objects can be modified in place too, so it's only valid during that generation
+	size_t leaf_hash_generation;
+	// set for dictionaries that were allocated without `fingerprints` and `inline_entries` (see `xpc_dictionary_alloc_with_capacity`);
+	// their entries are always out-of-line.
+	bool omits_inline_storage;
+	// `fingerprints` and `inline_entries` have to stay at the very end, so that they can be left out.
+	// a fingerprint of each inline entry's key (its length and first few bytes), so that lookups can compare them all at once.
+	// only meaningful while `entries` points to `inline_entries`; removed entries have a fingerprint of 0.
+	uint32_t fingerprints[XPC_DICTIONARY_INLINE_CAPACITY];
+	struct xpc_dictionary_entry_s inline_entries[XPC_DICTIONARY_INLINE_CAPACITY];
 };
 
 @interface XPC_CLASS_INTERFACE(dictionary)
@@ -76,17 +144,36 @@ struct xpc_dictionary_s {
 
 - (instancetype)initWithObjects: (XPC_CLASS(object)* const*)objects forKeys: (const char* const*)keys count: (NSUInteger)count;
 
+/**
+ * Initializes an empty dictionary with room for the given number of entries.
+ */
+- (instancetype)initWithCapacity: (NSUInteger)capacity;
+
 - (XPC_CLASS(object)*)objectForKey: (const char*)key;
 - (void)setObject: (XPC_CLASS(object)*)object forKey: (const char*)key;
 - (void)removeObjectForKey: (const char*)key;
+
+// like the methods above, but with a precomputed key, so the key doesn't have to be hashed again
+- (XPC_CLASS(object)*)objectForKeyHandle: (xpc_key_t)key;
+- (void)setObject: (XPC_CLASS(object)*)object forKeyHandle: (xpc_key_t)key;
 - (void)enumerateKeysAndObjectsUsingBlock: (void (^)(const char* key, XPC_CLASS(object)* obj, BOOL* stop))block;
 
 // unfortunately, no keyed subscripts for this class because `const char*`s aren't valid subscripts
 
 // NOTE: consider these as private methods
+// entry pointers are only valid until the next time the dictionary is modified.
+// the methods that modify entries expect the dictionary to have its own copy of them (the public mutators take care of that).
 - (xpc_dictionary_entry_t)entryForKey: (const char*)key;
-- (void)addEntry: (xpc_dictionary_entry_t)entry;
+- (xpc_dictionary_entry_t)entryForKeyHandle: (xpc_key_t)key;
+// appends a new entry (with no object) for the given key; the caller must make sure the key isn't already present
+- (xpc_dictionary_entry_t)addEntryForKey: (const char*)key;
+// like `addEntryForKey:`, but the entry just borrows the handle's name (so it must be interned or otherwise outlive the entry)
+- (xpc_dictionary_entry_t)addEntryForKeyHandle: (xpc_key_t)key;
+// releases the entry's object and removes it
 - (void)removeEntry: (xpc_dictionary_entry_t)entry;
+- (XPC_CLASS(object)*)objectForEntry: (xpc_dictionary_entry_t)entry;
+// adds an entry whose object has been validated by the deserializer but not created yet
+- (void)setSkippedObjectAtOffset: (NSUInteger)offset length: (NSUInteger)length forKey: (const char*)key deserializer: (XPC_CLASS(deserializer)*)deserializer;
 
 // useful extensions:
 - (XPC_CLASS(string)*)stringForKey: (const char*)key;
@@ -96,4 +183,12 @@ struct xpc_dictionary_s {
 
 @end
 
+/**
+ * Allocates (but doesn't initialize) a dictionary for the given number of entries.
+ * If they wouldn't fit in its inline entries anyway, the dictionary is allocated without them, which saves a few hundred bytes.
+ *
+ * The returned dictionary should be initialized with `initWithCapacity:` (using the same capacity) or `initWithObjects:forKeys:count:`.
+ */
+XPC_CLASS(dictionary)* xpc_dictionary_alloc_with_capacity(NSUInteger capacity);
+
 #endif // _XPC_OBJECTS_DICTIONARY_H_
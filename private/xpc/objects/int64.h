@@ -24,4 +24,10 @@
 
 XPC_WRAPPER_CLASS_DECL(int64, int64_t);
 
+/**
+ * Like `xpc_int64_create`, but small values (see `int64.m`) get one of the global objects everyone shares instead of a new object.
+ * Those can't be modified, so this is only for objects we create ourselves (e.g. for received messages), never for ones a caller asked for.
+ */
+xpc_object_t xpc_int64_create_shared(int64_t value);
+
 #endif // _XPC_OBJECTS_INT64_H_
@@ -39,13 +39,39 @@ typedef struct xpc_serial_port_array {
 	size_t length;
 } xpc_serial_port_array_t;
 
+// a VM region that will be sent as an out-of-line memory descriptor.
+typedef struct xpc_serial_ool_region {
+	void* address;
+	size_t size;
+} xpc_serial_ool_region_t;
+
+typedef struct xpc_serial_length_cache_entry {
+	const void* object;
+	NSUInteger length;
+} xpc_serial_length_cache_entry_t;
+
+// maps objects to their serialized lengths so that containers only have to be measured once per message.
+// this is a simple open-addressing table keyed by object pointer; `capacity` is always zero or a power of two.
+typedef struct xpc_serial_length_cache {
+	xpc_serial_length_cache_entry_t* entries;
+	size_t capacity;
+	size_t count;
+} xpc_serial_length_cache_t;
+
 struct xpc_serializer_s {
 	struct xpc_object_s base;
 	dispatch_mach_msg_t finalized_message;
-	size_t length;
+	size_t capacity;
 	size_t offset;
 	void* buffer;
+	// non-zero when `buffer` lives inside a VM region with this many bytes reserved in front of it for the Mach header and descriptors.
+	// large messages are written this way so that finalizing doesn't have to copy the body into a new allocation.
+	size_t headroom;
 	xpc_serial_port_array_t port_arrays[MACH_MSG_SEND_DISPOSITION_COUNT];
+	xpc_serial_length_cache_t length_cache;
+	xpc_serial_ool_region_t* ool_regions;
+	size_t ool_region_count;
+	size_t ool_threshold;
 };
 
 @class XPC_CLASS(dictionary);
@@ -55,6 +81,12 @@ struct xpc_serializer_s {
 @property(readonly) NSUInteger offset;
 @property(readonly) BOOL isFinalized;
 
+/**
+ * Data and string content of at least this many bytes is sent in out-of-line memory descriptors rather than inline.
+ * Defaults to `XPC_SERIAL_OOL_DEFAULT_THRESHOLD`; 0 disables out-of-line content entirely.
+ */
+@property NSUInteger oolThreshold;
+
 /**
  * Creates a new, autoreleased serializer.
  */
@@ -75,6 +107,9 @@ struct xpc_serializer_s {
  *
  * The returned message is not automatically retained. Therefore, if you want the message to live past the serializer,
  * make sure to retain it yourself.
+ *
+ * For large messages, the content is written into a VM region that already has room for the Mach header and descriptors,
+ * so the message is built around the content in place rather than copying it.
  */
 - (dispatch_mach_msg_t)finalizeWithRemotePort: (mach_port_t)remotePort localPort: (mach_port_t)localPort asReply: (BOOL)asReply expectingReply: (BOOL)expectingReply messageID: (uint32_t)messageID;
 
@@ -87,6 +122,9 @@ struct xpc_serializer_s {
 
 /**
  * Determines whether the internal buffer would have to be expanded to append content of the given size.
+ *
+ * The buffer grows geometrically and is recycled through a small per-thread cache once the serializer is finalized or destroyed,
+ * so steady-state serialization doesn't need to allocate a new buffer for every message.
  */
 - (BOOL)needsToResizeToWrite: (NSUInteger)extraSize;
 
@@ -98,6 +136,47 @@ struct xpc_serializer_s {
  */
 - (BOOL)ensure: (NSUInteger)extraSize;
 
+/**
+ * Determines the serialized length of the given object, including any padding.
+ *
+ * Container lengths are computed once and then cached for the lifetime of the serializer,
+ * so writing nested containers doesn't re-walk their subtrees at every level.
+ */
+- (NSUInteger)lengthOfObject: (XPC_CLASS(object)*)object;
+
+/**
+ * Records the serialized length of the given object so that later calls to `lengthOfObject:` can return it immediately.
+ *
+ * Containers should call this from `serializationLengthWithSerializer:` once they've measured themselves.
+ */
+- (void)cacheLength: (NSUInteger)length forObject: (XPC_CLASS(object)*)object;
+
+/**
+ * Determines whether content of the given length should be sent out-of-line (see `oolThreshold`).
+ */
+- (BOOL)shouldWriteOOL: (NSUInteger)length;
+
+/**
+ * Allocates a new VM region of the given size that will be sent as an out-of-line memory descriptor,
+ * and writes its descriptor index into the content (as a U32).
+ *
+ * The caller fills in the region. It remains owned by the serializer until the message is finalized,
+ * after which the kernel takes care of deallocating it once the message is sent.
+ */
+- (BOOL)reserveOOL: (NSUInteger)length region: (void**)region;
+
+/**
+ * Like `reserveOOL:region:`, but also copies the given data into the new region.
+ * Whole pages are virtually copied when possible, so large page-aligned buffers are never touched.
+ */
+- (BOOL)writeOOL: (const void*)data length: (NSUInteger)length;
+
+/**
+ * Like `writeOOL:length:`, but copies each region of the given dispatch data straight into the new region,
+ * so data made up of several regions never has to be flattened first.
+ */
+- (BOOL)writeOOLDispatchData: (dispatch_data_t)data;
+
 // NOTE: all writes to the internal buffer are subject to padding,
 //       so the number of bytes passed in might not be the same as number of bytes actually written.
 
@@ -21,15 +21,30 @@
 #define _XPC_OBJECTS_STRING_H_
 
 #import <xpc/objects/base.h>
+#import <dispatch/dispatch.h>
 #include <stdarg.h>
+#include <stdatomic.h>
 
 XPC_CLASS_DECL(string);
 
+// size of the inline buffer for short strings (including the null terminator).
+// chosen so that the whole object is exactly 80 bytes on 64-bit platforms (56 bytes on 32-bit ones), which fills a malloc size class.
+#define XPC_STRING_INLINE_CAPACITY 23
+
 struct xpc_string_s {
 	struct xpc_object_s base;
-	NSUInteger byteLength; // acts as an optional cache
-	BOOL freeWhenDone;
+	NSUInteger byteLength; // always valid
 	const char* string;
+	// if non-null, `string` points into memory kept alive by this object (e.g. a received message)
+	dispatch_object_t backing;
+	// cached hash of the contents (0 if it hasn't been computed yet); reset whenever the contents change
+	atomic_size_t cached_hash;
+	// number of bytes (not including the null terminator) that `string` has room for.
+	// only meaningful when we own `string` (i.e. it's `inline_string` or `freeWhenDone` is set); appending grows it geometrically.
+	NSUInteger capacity;
+	BOOL freeWhenDone;
+	// short strings are stored here (with `string` pointing to it), so they don't need a separate allocation
+	char inline_string[XPC_STRING_INLINE_CAPACITY];
 };
 
 @interface XPC_CLASS_INTERFACE(string)
@@ -54,6 +69,14 @@ struct xpc_string_s {
 - (instancetype)initWithCStringNoCopy: (const char*)string byteLength: (NSUInteger)byteLength freeWhenDone: (BOOL)freeIt;
 // non-NSString method
 - (instancetype)initWithCStringNoCopy: (const char*)string freeWhenDone: (BOOL)freeIt;
+// non-NSString method
+// `string` must stay valid for as long as `backing` is alive; the new string retains `backing`.
+// copies of the new string copy the bytes rather than keeping `backing` alive.
+- (instancetype)initWithCStringNoCopy: (const char*)string byteLength: (NSUInteger)byteLength backing: (dispatch_object_t)backing;
+// non-NSString method
+// takes ownership of `buffer` without copying it. it must have been allocated with `malloc`, have room for `capacity + 1` bytes,
+// and already contain the string (of which `byteLength` bytes are used; the terminator is added here).
+- (instancetype)initWithBuffer: (char*)buffer byteLength: (NSUInteger)byteLength capacity: (NSUInteger)capacity;
 - (instancetype) XPC_PRINTF(1, 2) initWithFormat: (const char*)format, ...;
 - (instancetype) XPC_PRINTF(1, 0) initWithFormat: (const char*)format arguments: (va_list)args;
 
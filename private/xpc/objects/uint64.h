@@ -24,4 +24,10 @@
 
 XPC_WRAPPER_CLASS_DECL(uint64, uint64_t);
 
+/**
+ * Like `xpc_uint64_create`, but small values (see `uint64.m`) get one of the global objects everyone shares instead of a new object.
+ * Those can't be modified, so this is only for objects we create ourselves (e.g. for received messages), never for ones a caller asked for.
+ */
+xpc_object_t xpc_uint64_create_shared(uint64_t value);
+
 #endif // _XPC_OBJECTS_UINT64_H_
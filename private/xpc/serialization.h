@@ -77,6 +77,22 @@ extern "C" {
 #define XPC_SERIAL_TYPE_MIN     XPC_SERIAL_TYPE_NULL
 #define XPC_SERIAL_TYPE_MAX     XPC_SERIAL_TYPE_FILE_TRANSFER
 
+// the low bits of a serial type are reserved for flags.
+#define XPC_SERIAL_TYPE_FLAGS_MASK 0x00fff
+
+// set on data and string types when the content was sent in an out-of-line memory descriptor instead of inline.
+// the serial representation is then `xpc_serial_ool_t`.
+// NOTE: this is a Darling extension; Apple's format does this differently
+#define XPC_SERIAL_TYPE_FLAG_OOL 0x00001
+
+// data and string content of at least this many bytes is sent out-of-line by default.
+// below this, copying the content inline is cheaper than mapping it into the receiver.
+#define XPC_SERIAL_OOL_DEFAULT_THRESHOLD (16 * 1024)
+
+// inline data and string content of at least this many bytes references the received message instead of being copied out of it.
+// anything smaller is copied so that small values don't keep entire messages alive.
+#define XPC_SERIAL_BORROW_DEFAULT_THRESHOLD 256
+
 // "w00t"
 #define XPC_MSGH_ID_CHECKIN      0x77303074
 #define XPC_MSGH_ID_MESSAGE      0x10000000
@@ -108,6 +124,15 @@ typedef struct XPC_PACKED xpc_serial_vld {
 	char content[];
 } xpc_serial_vld_t;
 
+// variable-length data that was sent out-of-line.
+// `size` is the length of the content (same as it would be for `xpc_serial_vld_t`)
+// and `index` is the index of its memory descriptor among all the OOL memory descriptors in the message.
+typedef struct XPC_PACKED xpc_serial_ool {
+	xpc_serial_base_t base;
+	uint32_t size;
+	uint32_t index;
+} xpc_serial_ool_t;
+
 // integral data like integers, booleans, and UUIDs.
 typedef struct XPC_PACKED xpc_serial_integral {
 	xpc_serial_base_t base;
@@ -140,6 +165,19 @@ uint64_t xpc_serial_padded_length(uint64_t length) {
 	return (length + 3) & -4;
 };
 
+typedef struct xpc_serial_buffer_statistics {
+	// serializers that started out with a payload buffer left behind by a previous serializer on the same thread
+	uint64_t reuses;
+	// times a payload buffer had to be allocated (or grown) with `realloc`
+	uint64_t allocations;
+} xpc_serial_buffer_statistics_t;
+
+/**
+ * Retrieves statistics about serializer payload buffers (across all threads).
+ * With the per-thread buffer cache, sending messages of similar sizes over and over shouldn't increase `allocations` at all.
+ */
+void xpc_serial_get_buffer_statistics(xpc_serial_buffer_statistics_t* statistics);
+
 #ifdef __cplusplus
 };
 #endif
@@ -147,6 +185,35 @@ uint64_t xpc_serial_padded_length(uint64_t length) {
 #if __OBJC__
 	#import <xpc/objects/serializer.h>
 	#import <xpc/objects/deserializer.h>
+
+// the serialization entry points of a serializable class, looked up once so that they can be called directly
+// instead of going through `objc_msgSend` at every level of every message.
+typedef struct xpc_serial_vtable {
+	Class class;
+	xpc_serial_type_t type;
+	BOOL (*serializable)(XPC_CLASS(object)* self, SEL _cmd);
+	NSUInteger (*length)(XPC_CLASS(object)* self, SEL _cmd, XPC_CLASS(serializer)* serializer);
+	BOOL (*serialize)(XPC_CLASS(object)* self, SEL _cmd, XPC_CLASS(serializer)* serializer);
+	XPC_CLASS(object)* (*deserialize)(Class self, SEL _cmd, XPC_CLASS(deserializer)* deserializer);
+	// `NULL` if the class doesn't support skipping (see `XPCSerializationSkipping`)
+	BOOL (*skip)(Class self, SEL _cmd, XPC_CLASS(deserializer)* deserializer);
+} xpc_serial_vtable_t;
+
+/**
+ * Returns the serialization vtable for the given class (which must be an exact match, not a subclass),
+ * or `NULL` if the class has no serial representation.
+ */
+const xpc_serial_vtable_t* xpc_serial_vtable_for_class(Class class);
+
+/**
+ * Returns the serialization vtable for the given serial type (ignoring any type flags), or `NULL` if the type is invalid.
+ */
+const xpc_serial_vtable_t* xpc_serial_vtable_for_type(xpc_serial_type_t type);
+
+/**
+ * Equivalent to `object.serializable`, but uses the object's vtable when it has one.
+ */
+BOOL xpc_serial_object_is_serializable(XPC_CLASS(object)* object);
 #endif
 
 #endif // _XPC_SERIALIZATION_H_
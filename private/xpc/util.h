@@ -22,9 +22,11 @@
 
 #import <xpc/internal_base.h>
 #import <xpc/objects/base.h>
+#import <xpc/private.h>
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 #include <mach/mach.h>
 #include <os/log.h>
 #include <os/lock.h>
@@ -96,16 +98,35 @@ _xpc_globals(void) {
 //                           (void*)&_xpc_init_globals);
 };
 
+/**
+ * Checks whether the given object is an instance of the given class (or one of its subclasses), returning `false` for `NULL`.
+ *
+ * Our objects are allocated with `_os_object_alloc_realized` (or statically), so their isa is always a plain class pointer.
+ * That means the common case (an instance of exactly the expected class) can be checked by comparing it directly;
+ * only other classes need to go through `isKindOfClass:`.
+ */
+XPC_INLINE
+bool xpc_object_is_kind(XPC_CLASS(object)* object, Class cls) {
+	if (object == nil) {
+		return false;
+	}
+	if ((Class)((struct xpc_object_s*)object)->os_obj_isa == cls) {
+		return true;
+	}
+	return [object isKindOfClass: cls];
+};
+
 /**
  * Expands to an expression that evaluates to `true` if the given expression is an object of the given XPC class, or `false` otherwise.
  */
-#define XPC_CHECK(className, expression) ([(expression) isKindOfClass: [XPC_CLASS(className) class]])
+#define XPC_CHECK(className, expression) (xpc_object_is_kind(XPC_CAST(object, expression), XPC_OBJC_CLASS(className)))
 
 /**
  * Defines `objcName` by casting `origName`, but also checks to ensure it's not `nil`
  * and to ensure it is an XPC object of the given `className`.
  *
  * You should call it with a (possibly braced) statement of what to do when it passes these checks.
+ * The check itself is inline and doesn't send any messages unless the object is of some other class (see `xpc_object_is_kind`).
  * You can optionally append an `else` clause for what to do when it fails these checks.
  *
  * @code
@@ -119,7 +140,7 @@ _xpc_globals(void) {
  */
 #define TO_OBJC_CHECKED(className, origName, objcName) \
 	XPC_CLASS(className)* objcName = XPC_CAST(className, origName); \
-	if ([objcName isKindOfClass: [XPC_CLASS(className) class]])
+	if (xpc_object_is_kind(objcName, XPC_OBJC_CLASS(className)))
 
 /**
  * Like `TO_OBJC_CHECKED`, but the condition checks for failure to pass the checks.
@@ -128,7 +149,7 @@ _xpc_globals(void) {
  */
 #define TO_OBJC_CHECKED_ON_FAIL(className, origName, objcName) \
 	XPC_CLASS(className)* objcName = XPC_CAST(className, origName); \
-	if (![objcName isKindOfClass: [XPC_CLASS(className) class]])
+	if (!xpc_object_is_kind(objcName, XPC_OBJC_CLASS(className)))
 
 /**
 * Like `TO_OBJC_CHECKED`, but it doesn't declare a variable.
@@ -136,7 +157,7 @@ _xpc_globals(void) {
 * @see TO_OBJC_CHECKED
 */
 #define IS_OBJC_TYPE(className, origName) \
-    if ([XPC_CAST(className, origName) isKindOfClass: [XPC_CLASS(className) class]])
+    if (xpc_object_is_kind(XPC_CAST(className, origName), XPC_OBJC_CLASS(className)))
 
 /**
  * Special `retain` variant for collection classes like dictionaries and arrays.
@@ -165,19 +186,247 @@ void xpc_release_for_collection(XPC_CLASS(object)* object);
 const char* xpc_class_name(XPC_CLASS(object)* object);
 
 /**
- * Creates a string that is an indented copy of the given string.
+ * Streams an object graph's description into a growable buffer, a `FILE`, or a file descriptor.
+ *
+ * Nested content is indented by the writer as it's written (each line starts with `depth` tabs),
+ * so containers write their children directly instead of building and re-indenting a separate string for each of them.
+ */
+struct xpc_description_writer_s {
+	xpc_description_limits_t limits;
+	// output goes here unless `file` or `fd` is set
+	xpc_string_builder_t builder;
+	FILE* file;
+	int fd;
+	char fd_buffer[256];
+	size_t fd_buffer_used;
+	// current nesting level
+	size_t depth;
+	// number of bytes written so far (for `limits.max_bytes`)
+	size_t written;
+	bool at_line_start;
+	// set once `limits.max_bytes` has been reached; everything written afterwards is dropped
+	bool truncated;
+	bool failed;
+};
+
+/**
+ * Initializes a writer that builds the description in memory (see `xpc_description_writer_finish`).
+ * `limits` may be `NULL`, in which case there are no limits.
+ */
+void xpc_description_writer_init(xpc_description_writer_t* writer, const xpc_description_limits_t* limits);
+void xpc_description_writer_init_file(xpc_description_writer_t* writer, FILE* file, const xpc_description_limits_t* limits);
+void xpc_description_writer_init_fd(xpc_description_writer_t* writer, int fd, const xpc_description_limits_t* limits);
+
+/**
+ * Flushes any pending output and, if the output was truncated, appends "...".
+ *
+ * @returns For in-memory writers, the description (which must be freed). Otherwise `NULL`.
+ */
+char* xpc_description_writer_finish(xpc_description_writer_t* writer);
+
+void xpc_description_write(xpc_description_writer_t* writer, const char* string, size_t length);
+XPC_PRINTF(2, 3)
+void xpc_description_printf(xpc_description_writer_t* writer, const char* format, ...);
+void xpc_description_write_object(xpc_description_writer_t* writer, XPC_CLASS(object)* object);
+
+/**
+ * Whether the writer has stopped accepting output (because it was truncated or it failed), in which case there's no point in describing anything else.
+ */
+bool xpc_description_writer_is_done(xpc_description_writer_t* writer);
+
+/**
+ * Enters a container's entries, increasing the indentation. Returns `false` if the container is nested too deeply to be described entry by entry.
+ */
+bool xpc_description_writer_enter(xpc_description_writer_t* writer);
+void xpc_description_writer_leave(xpc_description_writer_t* writer);
+
+/**
+ * Returns how many of a container's `count` entries should be described.
+ */
+size_t xpc_description_writer_element_limit(xpc_description_writer_t* writer, size_t count);
+
+/**
+ * Describes the given object into a new string, within the given limits (which may be `NULL`).
  *
  * @returns A string that must be freed.
  */
-char* xpc_description_indent(const char* description, bool indentFirstLine);
+char* xpc_description_copy(XPC_CLASS(object)* object, const xpc_description_limits_t* limits);
 
 /**
  * Produces a hash from the given data.
  *
+ * Every byte of the input contributes to the hash (including any zero bytes), and the input is consumed a word at a time.
+ * Hashes are only meant to be consistent within a single process; they must not be persisted or sent to other processes.
+ *
  * @returns A hash of the input data.
  */
 size_t xpc_raw_data_hash(const void* data, size_t data_length);
 
+/**
+ * State for hashing data that's split up into several pieces (e.g. the regions of dispatch data) without flattening it first.
+ * The result is the same as `xpc_raw_data_hash` on all the pieces put together, no matter how the data is split up.
+ */
+typedef struct xpc_data_hasher_s {
+	uint64_t lanes[4];
+	// the start of a stripe that continues in the next piece
+	uint8_t buffer[32];
+	size_t buffered;
+	size_t length;
+} xpc_data_hasher_t;
+
+void xpc_data_hasher_init(xpc_data_hasher_t* hasher);
+void xpc_data_hasher_append(xpc_data_hasher_t* hasher, const void* data, size_t data_length);
+size_t xpc_data_hasher_finish(const xpc_data_hasher_t* hasher);
+
+/**
+ * Mixes two hashes together (e.g. a dictionary key's hash with its value's hash).
+ * The result depends on the order of the arguments, but containers can sum up the results for their entries in any order.
+ */
+size_t xpc_hash_combine(size_t first, size_t second);
+
+// states of the hash that containers cache (see `leaf_hash` in dictionaries and arrays)
+#define XPC_CONTAINER_HASH_INVALID 0
+// the cached hash only covers immutable objects; the hashes of mutable objects have to be added to it
+#define XPC_CONTAINER_HASH_PARTIAL 1
+// the cached hash covers everything (there weren't any mutable objects)
+#define XPC_CONTAINER_HASH_COMPLETE 2
+
+/**
+ * Returns the current leaf generation, which changes whenever an object that isn't a container is modified in place
+ * (e.g. with `xpc_string_set_value`) after its hash may have been used.
+ * Objects don't know which containers hold them, so containers only trust the hashes they cached during the same generation.
+ */
+size_t xpc_leaf_generation(void);
+
+/**
+ * Starts a new leaf generation (see `xpc_leaf_generation`). Call this after modifying an object that isn't a container.
+ */
+void xpc_leaf_generation_advance(void);
+
+/**
+ * Produces a hash of the given dictionary key.
+ * This is the hash that `xpc_key_intern` and `xpc_key_lookup_interned` expect.
+ */
+size_t xpc_key_hash(const char* key);
+
+/**
+ * Returns the interned copy of the given dictionary key (whose hash is `hash`), adding it to the process-wide key table if necessary.
+ * Interned keys are immutable and live for the rest of the process, so two interned keys are equal if and only if their pointers are equal.
+ * The table is lock-free and safe to use from any thread.
+ *
+ * @returns The interned key, or `NULL` if the key can't be interned (because it's too long or the table is full),
+ *          in which case the caller has to keep its own copy of the key.
+ */
+const char* xpc_key_intern(const char* key, size_t hash);
+
+/**
+ * Like `xpc_key_intern`, but never adds the key to the table.
+ *
+ * @returns The interned key, or `NULL` if the key hasn't been interned.
+ */
+const char* xpc_key_lookup_interned(const char* key, size_t hash);
+
+typedef struct xpc_slab_statistics {
+	// allocations that were served from a thread's cache
+	uint64_t hits;
+	// allocations (of cacheable sizes) that had to go to `malloc`
+	uint64_t misses;
+	// bytes currently held in thread caches, across all threads
+	uint64_t bytes_retained;
+} xpc_slab_statistics_t;
+
+/**
+ * Allocates a block for container backing storage (dictionary entry arrays and indices, array buffers, etc.).
+ *
+ * Small blocks are rounded up to a size class and recycled through a per-thread cache of recently freed blocks,
+ * so short-lived containers don't have to go through `malloc` and `free` every time.
+ * Larger blocks go straight to `malloc`.
+ *
+ * @returns A block of at least `size` bytes that must be freed with `xpc_slab_free` (or resized with `xpc_slab_realloc`), or `NULL` on failure.
+ */
+void* xpc_slab_alloc(size_t size);
+
+/**
+ * Resizes a block allocated with `xpc_slab_alloc`. `old_size` must be the size the block was allocated (or last resized) with.
+ * If both sizes fall within the same size class, the same block is returned without doing anything.
+ *
+ * @returns The resized block, or `NULL` on failure (in which case the original block is left untouched).
+ */
+void* xpc_slab_realloc(void* block, size_t old_size, size_t new_size);
+
+/**
+ * Frees a block allocated with `xpc_slab_alloc`. `size` must be the size the block was allocated (or last resized) with.
+ */
+void xpc_slab_free(void* block, size_t size);
+
+/**
+ * Retrieves statistics about the slab allocator.
+ */
+void xpc_slab_get_statistics(xpc_slab_statistics_t* statistics);
+
+/**
+ * Allocates a slab block (see `xpc_slab_alloc`) that carries a reference count, so that copy-on-write containers can share their backing storage.
+ * The reference count starts at 1.
+ *
+ * @returns A block of at least `size` bytes that must be freed with `xpc_shared_free` once its last reference is released, or `NULL` on failure.
+ */
+void* xpc_shared_alloc(size_t size);
+
+/**
+ * Resizes a block allocated with `xpc_shared_alloc` (or allocates a new one if `block` is `NULL`).
+ * The block must not be shared, i.e. `xpc_shared_is_unique` must be true for it.
+ *
+ * @returns The resized block, or `NULL` on failure (in which case the original block is left untouched).
+ */
+void* xpc_shared_realloc(void* block, size_t old_size, size_t new_size);
+
+/**
+ * Adds a reference to a shared block. `NULL` is ignored.
+ *
+ * @returns The block passed in.
+ */
+void* xpc_shared_retain(void* block);
+
+/**
+ * Drops a reference to a shared block. `NULL` is ignored.
+ *
+ * @returns `true` if that was the last reference, in which case the caller has to clean up the contents and free the block with `xpc_shared_free`.
+ */
+bool xpc_shared_release(void* block);
+
+/**
+ * Determines whether the caller holds the only reference to the given shared block (which is always true for `NULL`).
+ */
+bool xpc_shared_is_unique(const void* block);
+
+/**
+ * Frees a block allocated with `xpc_shared_alloc`. `size` must be the size the block was allocated (or last resized) with.
+ */
+void xpc_shared_free(void* block, size_t size);
+
+/**
+ * Determines whether the given object can be modified after it's created (i.e. it's a container or a port right that can be extracted).
+ * Copies of a container can share all of its other objects, but they each need their own copy of these.
+ */
+bool xpc_object_is_mutable(XPC_CLASS(object)* object);
+
+/**
+ * Reads an object slot that another thread may fill in at any time with `xpc_object_slot_publish` (e.g. a lazily deserialized entry).
+ * If the slot is non-`nil`, the object it points to is fully initialized.
+ */
+XPC_INLINE
+XPC_CLASS(object)* xpc_object_slot_load(XPC_CLASS(object)** slot) {
+	return (XPC_CLASS(object)*)atomic_load_explicit((_Atomic(void*)*)slot, memory_order_acquire);
+};
+
+/**
+ * Fills in an object slot that other threads may be reading with `xpc_object_slot_load`.
+ */
+XPC_INLINE
+void xpc_object_slot_publish(XPC_CLASS(object)** slot, XPC_CLASS(object)* object) {
+	atomic_store_explicit((_Atomic(void*)*)slot, (void*)object, memory_order_release);
+};
+
 /**
  * Checks if the given port is dead.
  */
@@ -22,6 +22,7 @@
 
 #include <os/lock.h>
 #include <uuid/uuid.h>
+#include <stdio.h>
 #include <xpc/xpc.h>
 
 // `notify_client.c` includes `xpc/private.h` and expects it to define `xpc_copy_entitlement_for_token`, which we have in `launchd.h`
@@ -64,6 +65,16 @@ void xpc_dictionary_get_audit_token(xpc_object_t, audit_token_t *);
 
 void xpc_connection_set_target_uid(xpc_connection_t connection, uid_t uid);
 void xpc_connection_set_instance(xpc_connection_t connection, uuid_t uid);
+
+// limits on incoming messages; 0 (the default) means unlimited.
+// these should be set before the connection is activated. listeners pass their limits on to new peer connections.
+void xpc_connection_set_max_message_depth(xpc_connection_t connection, size_t depth);
+void xpc_connection_set_max_message_objects(xpc_connection_t connection, size_t count);
+void xpc_connection_set_max_message_size(xpc_connection_t connection, size_t size);
+// if enabled, incoming messages are checked in full before any objects are created for them,
+// so malformed messages are rejected without allocating anything for their contents. off by default.
+void xpc_connection_set_validate_messages(xpc_connection_t connection, bool validate);
+
 void xpc_dictionary_set_mach_send(xpc_object_t object, const char* key, mach_port_t port);
 
 xpc_object_t xpc_connection_copy_entitlement_value(xpc_connection_t connection, const char* entitlement);
@@ -76,6 +87,68 @@ void xpc_string_set_value(xpc_object_t xstring, const char* new_string);
 
 xpc_object_t xpc_string_create_no_copy(const char* string);
 
+/**
+ * Accumulates a string piece by piece in a buffer that grows geometrically, so building a string of any length only takes linear time.
+ * Once it's complete, the buffer is handed over to a new string object without being copied.
+ *
+ * Builders are meant to be kept on the stack; the fields are private.
+ * A zero-initialized builder is valid and empty (equivalent to `xpc_string_builder_init(builder, 0)`).
+ */
+typedef struct xpc_string_builder_s {
+	char* buffer;
+	size_t length;
+	size_t capacity;
+	bool failed;
+} xpc_string_builder_t;
+
+void xpc_string_builder_init(xpc_string_builder_t* builder, size_t capacity);
+
+/**
+ * Appends the given bytes to the builder. Returns `false` if the builder ran out of memory, in which case it ignores all further appends.
+ */
+bool xpc_string_builder_append(xpc_string_builder_t* builder, const char* string, size_t length);
+
+XPC_PRINTF(2, 3)
+bool xpc_string_builder_append_format(xpc_string_builder_t* builder, const char* format, ...);
+
+XPC_PRINTF(2, 0)
+bool xpc_string_builder_append_format_v(xpc_string_builder_t* builder, const char* format, va_list args);
+
+/**
+ * Creates a string object out of everything appended to the builder and resets the builder.
+ * Returns `NULL` if any append failed.
+ */
+xpc_object_t xpc_string_builder_finish(xpc_string_builder_t* builder);
+
+/**
+ * Discards the builder's content without creating a string.
+ */
+void xpc_string_builder_destroy(xpc_string_builder_t* builder);
+
+/**
+ * Limits on how much of an object graph is described. 0 means "unlimited" for each of them.
+ */
+typedef struct xpc_description_limits {
+	// the description is cut off after this many bytes (and "..." is appended to it)
+	size_t max_bytes;
+	// containers nested more deeply than this are summarized rather than described entry by entry
+	size_t max_depth;
+	// only this many entries of each container are described; the rest are summarized
+	size_t max_elements;
+} xpc_description_limits_t;
+
+/**
+ * Like `xpc_copy_description`, but stays within the given limits (which may be `NULL`).
+ */
+char* xpc_copy_description_with_limits(xpc_object_t object, const xpc_description_limits_t* limits);
+
+/**
+ * Writes the object's description straight into the given file or file descriptor without building it up in memory first.
+ * `limits` may be `NULL`. Returns `false` if writing failed.
+ */
+bool xpc_description_write_to_file(xpc_object_t object, FILE* file, const xpc_description_limits_t* limits);
+bool xpc_description_write_to_fd(xpc_object_t object, int fd, const xpc_description_limits_t* limits);
+
 typedef void (*xpc_array_applier_f)(size_t index, xpc_object_t value, void* context);
 
 void xpc_array_apply_f(xpc_object_t xarray, void* context, xpc_array_applier_f applier);
@@ -88,6 +161,26 @@ xpc_object_t xpc_array_get_array(xpc_object_t xarray, size_t index);
 
 xpc_object_t xpc_array_get_dictionary(xpc_object_t xarray, size_t index);
 
+/**
+ * Creates an empty array with room for the given number of values, so that appending that many values won't need to reallocate.
+ */
+xpc_object_t xpc_array_create_with_capacity(size_t capacity);
+
+/**
+ * Appends all of the given values to the array at once (making room for all of them up front). `NULL` values are skipped.
+ */
+void xpc_array_append_values(xpc_object_t xarray, const xpc_object_t* values, size_t count);
+
+/**
+ * Creates an array of the given values that stores them directly rather than as an object for each of them.
+ * Objects are only created for values that are retrieved with `xpc_array_get_value` (or applied/enumerated);
+ * `xpc_array_get_int64` and the like, as well as serialization, use the values as-is.
+ */
+xpc_object_t xpc_array_create_bools(const bool* values, size_t count);
+xpc_object_t xpc_array_create_int64s(const int64_t* values, size_t count);
+xpc_object_t xpc_array_create_uint64s(const uint64_t* values, size_t count);
+xpc_object_t xpc_array_create_doubles(const double* values, size_t count);
+
 xpc_object_t _xpc_dictionary_create_reply_with_port(mach_port_t port);
 
 mach_msg_id_t _xpc_dictionary_extract_reply_msg_id(xpc_object_t xdict);
@@ -100,6 +193,34 @@ void _xpc_dictionary_set_remote_connection(xpc_object_t xdict, xpc_connection_t
 
 void _xpc_dictionary_set_reply_msg_id(xpc_object_t xdict, mach_msg_id_t msg_id);
 
+/**
+ * A precomputed dictionary key, for code that looks up the same constant keys over and over again.
+ * Handles carry the key's hash and interned string, so lookups through them skip hashing and usually only need a pointer comparison.
+ *
+ * Handles are never freed; they're meant to be created once (e.g. for a set of well-known keys) and then kept for the life of the process.
+ */
+typedef const struct xpc_key_s* xpc_key_t;
+
+xpc_key_t xpc_dictionary_key_create(const char* key);
+const char* xpc_dictionary_key_get_string(xpc_key_t key);
+
+xpc_object_t xpc_dictionary_get_value_k(xpc_object_t xdict, xpc_key_t key);
+void xpc_dictionary_set_value_k(xpc_object_t xdict, xpc_key_t key, xpc_object_t value);
+
+bool xpc_dictionary_get_bool_k(xpc_object_t xdict, xpc_key_t key);
+int64_t xpc_dictionary_get_int64_k(xpc_object_t xdict, xpc_key_t key);
+uint64_t xpc_dictionary_get_uint64_k(xpc_object_t xdict, xpc_key_t key);
+double xpc_dictionary_get_double_k(xpc_object_t xdict, xpc_key_t key);
+int64_t xpc_dictionary_get_date_k(xpc_object_t xdict, xpc_key_t key);
+const char* xpc_dictionary_get_string_k(xpc_object_t xdict, xpc_key_t key);
+
+void xpc_dictionary_set_bool_k(xpc_object_t xdict, xpc_key_t key, bool value);
+void xpc_dictionary_set_int64_k(xpc_object_t xdict, xpc_key_t key, int64_t value);
+void xpc_dictionary_set_uint64_k(xpc_object_t xdict, xpc_key_t key, uint64_t value);
+void xpc_dictionary_set_double_k(xpc_object_t xdict, xpc_key_t key, double value);
+void xpc_dictionary_set_date_k(xpc_object_t xdict, xpc_key_t key, int64_t value);
+void xpc_dictionary_set_string_k(xpc_object_t xdict, xpc_key_t key, const char* value);
+
 typedef void (*xpc_dictionary_applier_f)(const char* key, xpc_object_t value, void* context);
 
 void xpc_dictionary_apply_f(xpc_object_t xdict, void* context, xpc_dictionary_applier_f applier);
@@ -149,6 +270,10 @@ xpc_object_t _xpc_bool_create_distinct(bool value);
 */
 bool xpc_bool_set_value(xpc_object_t xbool, bool value);
 
+void xpc_double_set_value(xpc_object_t xdouble, double value);
+
+void _xpc_int64_set_value(xpc_object_t xint, int64_t value);
+
 const char* xpc_type_get_name(xpc_type_t xtype);
 
 xpc_connection_t xpc_connection_create_listener(const char* name, dispatch_queue_t queue);